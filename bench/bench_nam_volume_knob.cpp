@@ -0,0 +1,368 @@
+// Stage-by-stage timings of the processing pipeline on synthetic models, so results can be
+// tracked across releases without downloading real captures. Every model is generated from a
+// fixed seed: the same arguments always time the same bytes.
+//
+//   bench_nam_volume_knob [--arch A,B] [--sizes N,M] [--stages S,T] [--min-time <s>]
+//                         [--max-iterations <N>] [--json <file|->]
+#include "nam_binary.h"
+#include "nam_model.h"
+#include "nam_parser.h"
+#include "nam_writer.h"
+#include "output_writer.h"
+#include "validator.h"
+#include "weight_kernels.h"
+#include "weight_scaler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifndef NAM_VOLUME_KNOB_VERSION
+#define NAM_VOLUME_KNOB_VERSION "dev"
+#endif
+
+using json = nlohmann::json;
+
+namespace {
+
+const std::vector<std::string> kArchitectures = {"Linear", "LSTM", "WaveNet", "ConvNet", "SlimmableContainer"};
+const std::vector<std::string> kStages = {"parse", "validate", "head_index", "scale", "metadata", "dump",
+                                          "dump_compact", "dump_binary", "parse_binary", "write"};
+// A standard WaveNet capture is ~14k weights; the largest ones in the wild are a few million.
+const std::vector<size_t> kDefaultSizes = {10000, 1000000, 5000000};
+
+struct Options {
+    std::vector<std::string> architectures = kArchitectures;
+    std::vector<size_t> sizes = kDefaultSizes;
+    std::vector<std::string> stages = kStages;
+    double minSeconds = 0.5;
+    size_t maxIterations = 50;
+    std::string jsonPath;
+};
+
+struct StageResult {
+    std::string arch;
+    size_t weights = 0;
+    size_t inputBytes = 0;
+    std::string stage;
+    size_t iterations = 0;
+    double minNs = 0.0;
+    double medianNs = 0.0;
+};
+
+// Keeps results alive so the optimizer cannot drop the timed work.
+volatile size_t gSink = 0;
+// The table; stderr when the JSON goes to stdout.
+FILE* gTable = stdout;
+
+std::vector<std::string> splitList(const std::string& text) {
+    std::vector<std::string> parts;
+    size_t begin = 0;
+    while (begin <= text.size()) {
+        const size_t comma = std::min(text.find(',', begin), text.size());
+        if (comma > begin) parts.push_back(text.substr(begin, comma - begin));
+        begin = comma + 1;
+    }
+    return parts;
+}
+
+bool contains(const std::vector<std::string>& list, const std::string& value) {
+    return std::find(list.begin(), list.end(), value) != list.end();
+}
+
+json metadata(std::mt19937& rng) {
+    std::uniform_real_distribution<double> loudness(-30.0, -10.0);
+    json out;
+    out["name"] = "Synthetic benchmark model";
+    out["modeled_by"] = "bench_nam_volume_knob";
+    out["gear_type"] = "amp";
+    out["loudness"] = loudness(rng);
+    out["gain"] = 0.5;
+    out["training"] = {{"validation_esr", 0.0123}, {"settings", {{"ignore_checks", false}}}};
+    return out;
+}
+
+// One flat (A1) model with weightCount weights; its config matches what WeightScaler expects.
+json flatDocument(const std::string& arch, size_t weightCount) {
+    json config = json::object();
+    if (arch == "Linear") {
+        config["receptive_field"] = weightCount - 1;
+        config["bias"] = true;
+    } else if (arch == "LSTM") {
+        config["input_size"] = 1;
+        config["hidden_size"] = 24;
+        config["num_layers"] = std::max<size_t>(weightCount / 2500, 1);
+    } else if (arch == "WaveNet") {
+        json layer = {{"input_size", 1}, {"condition_size", 1}, {"channels", 16}, {"head_size", 8},
+                      {"kernel_size", 3}, {"activation", "Tanh"}, {"gated", false}, {"head_bias", false},
+                      {"dilations", {1, 2, 4, 8, 16, 32, 64, 128, 256, 512}}};
+        config["layers"] = {layer, layer};
+        config["head_scale"] = 0.02;
+    } else {
+        config["channels"] = 32;
+        config["out_channels"] = 1;
+        config["dilations"] = {1, 2, 4, 8, 16, 32, 64, 128, 256, 512};
+        config["batchnorm"] = true;
+        config["activation"] = "Tanh";
+    }
+    json document;
+    document["version"] = "0.5.4";
+    document["architecture"] = arch;
+    document["config"] = std::move(config);
+    document["weights"] = nullptr;  // lifted into NamModel::weightArrays
+    return document;
+}
+
+NamWeightArray randomWeights(const std::string& ownerPointer, size_t count, std::mt19937& rng) {
+    std::normal_distribution<float> weight(0.0f, 0.1f);
+    NamWeightArray weights;
+    weights.ownerPointer = ownerPointer;
+    weights.values.resize(count);
+    for (float& value : weights.values) value = weight(rng);
+    return weights;
+}
+
+NamModel makeModel(const std::string& arch, size_t weightCount) {
+    std::mt19937 rng(static_cast<uint32_t>(weightCount * 31 + arch.size()));
+    NamModel model;
+    if (arch != "SlimmableContainer") {
+        model.document = flatDocument(arch, weightCount);
+        model.document["metadata"] = metadata(rng);
+        model.weightArrays.push_back(randomWeights("", weightCount, rng));
+        return model;
+    }
+    // Three WaveNet submodels of 1/6, 2/6 and 3/6 of the weights, as in a slimmable capture.
+    model.document["version"] = "0.7.0";
+    model.document["architecture"] = arch;
+    model.document["config"]["submodels"] = json::array();
+    size_t remaining = weightCount;
+    for (size_t i = 0; i < 3; ++i) {
+        const size_t count = i == 2 ? remaining : std::max<size_t>(weightCount * (i + 1) / 6, 1);
+        remaining -= std::min(count, remaining);
+        json submodel;
+        submodel["max_value"] = (static_cast<double>(i) + 1.0) / 3.0;
+        submodel["model"] = flatDocument("WaveNet", count);
+        model.document["config"]["submodels"].push_back(std::move(submodel));
+        model.weightArrays.push_back(randomWeights("/config/submodels/" + std::to_string(i) + "/model",
+                                                   std::max<size_t>(count, 1), rng));
+    }
+    model.document["metadata"] = metadata(rng);
+    return model;
+}
+
+// Head range of every (sub)model, as renderOutput looks it up.
+size_t lookupHeads(const NamModel& model) {
+    size_t total = 0;
+    for (const auto& weights : model.weightArrays) {
+        const json& owner = model.document.at(json::json_pointer(weights.ownerPointer));
+        size_t start = 0;
+        size_t end = 0;
+        std::string err;
+        if (WeightScaler::tryGetHeadWeightIndices(owner["architecture"].get<std::string>(), owner["config"],
+                                                  weights.values.size(), start, end, err)) {
+            total += end - start;
+        }
+    }
+    return total;
+}
+
+NamModelVariant scaled(const std::shared_ptr<const NamModel>& model, float factor) {
+    NamModelVariant variant(model);
+    std::string err;
+    if (variant.document["architecture"] == "SlimmableContainer") {
+        WeightScaler::tryScaleA2Model(variant, factor, err);
+    } else {
+        size_t count = 0;
+        variant.tryGetWeightCount("", count);
+        const auto [start, end] = WeightScaler::getHeadWeightIndices(variant.document["architecture"].get<std::string>(),
+                                                                     variant.document["config"], count);
+        WeightScaler::tryScaleWeights(variant, "", start, end, factor, err);
+    }
+    return variant;
+}
+
+StageResult timeStage(const Options& options, const std::string& stage, const std::function<size_t()>& work) {
+    using Clock = std::chrono::steady_clock;
+    std::vector<double> samples;
+    const auto begin = Clock::now();
+    do {
+        const auto start = Clock::now();
+        gSink = gSink + work();
+        samples.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count());
+    } while (samples.size() < options.maxIterations
+             && std::chrono::duration<double>(Clock::now() - begin).count() < options.minSeconds);
+    std::sort(samples.begin(), samples.end());
+    StageResult result;
+    result.stage = stage;
+    result.iterations = samples.size();
+    result.minNs = samples.front();
+    result.medianNs = samples[samples.size() / 2];
+    return result;
+}
+
+void benchModel(const Options& options, const std::string& arch, size_t weightCount,
+                const std::filesystem::path& scratch, std::vector<StageResult>& results) {
+    auto model = std::make_shared<const NamModel>(makeModel(arch, weightCount));
+    std::string error;
+    if (!Validator::validateNam(*model, error) || lookupHeads(*model) == 0) {
+        std::fprintf(stderr, "Synthetic %s model with %zu weights is invalid: %s\n", arch.c_str(), weightCount,
+                     error.c_str());
+        std::exit(1);
+    }
+    const std::string text = NamWriter::dump(*model);
+    const std::string binary = NamWriter::dumpBinary(*model);
+    const NamModelVariant variant = scaled(model, 1.4125376f);
+    const std::string output = NamWriter::dump(variant);
+    const std::string outputPath = (scratch / (arch + ".nam")).string();
+
+    const std::vector<std::pair<std::string, std::function<size_t()>>> stages = {
+        {"parse", [&] {
+            NamModel parsed;
+            std::string err;
+            NamParser::tryParseNamModel(text, parsed, err);
+            return parsed.weightArrays.size();
+        }},
+        {"validate", [&] {
+            std::string err;
+            return static_cast<size_t>(Validator::validateNam(*model, err));
+        }},
+        {"head_index", [&] { return lookupHeads(*model); }},
+        {"scale", [&] { return scaled(model, 1.4125376f).overlays.size(); }},
+        {"metadata", [&] {
+            json document = variant.document;
+            WeightScaler::updateMetadata(document, 3.0f);
+            return document.size();
+        }},
+        {"dump", [&] { return NamWriter::dump(variant).size(); }},
+        {"dump_compact", [&] { return NamWriter::dump(variant, NamOutputFormat::Compact).size(); }},
+        {"dump_binary", [&] { return NamWriter::dumpBinary(variant).size(); }},
+        {"parse_binary", [&] {
+            NamModel parsed;
+            std::string err;
+            NamParser::tryParseNamBinary(binary, parsed, err);
+            return parsed.weightArrays.size();
+        }},
+        {"write", [&] {
+            OutputWriter writer(SyncMode::None);
+            OutputWrite write;
+            write.finalPath = outputPath;
+            write.pieces.push_back(output);
+            writer.submit(std::move(write));
+            std::string err;
+            return static_cast<size_t>(writer.finish(err));
+        }},
+    };
+
+    for (const auto& [name, work] : stages) {
+        if (!contains(options.stages, name)) continue;
+        StageResult result = timeStage(options, name, work);
+        result.arch = arch;
+        result.weights = weightCount;
+        result.inputBytes = text.size();
+        std::fprintf(gTable, "%-20s %9zu %-13s %6zu %14.3f %14.3f\n", arch.c_str(), weightCount, name.c_str(),
+                    result.iterations, result.minNs / 1e6, result.medianNs / 1e6);
+        std::fflush(gTable);
+        results.push_back(std::move(result));
+    }
+}
+
+json toJson(const std::vector<StageResult>& results) {
+    json out;
+    out["tool"] = "nam-volume-knob";
+    out["version"] = NAM_VOLUME_KNOB_VERSION;
+    out["isa"] = WeightKernels::activeIsa();
+    out["results"] = json::array();
+    for (const auto& r : results) {
+        out["results"].push_back({{"arch", r.arch}, {"weights", r.weights}, {"input_bytes", r.inputBytes},
+                                  {"stage", r.stage}, {"iterations", r.iterations}, {"min_ns", r.minNs},
+                                  {"median_ns", r.medianNs}});
+    }
+    return out;
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::fprintf(stderr, "Missing value for %s\n", arg.c_str());
+            return false;
+        }
+        const std::string value = argv[++i];
+        if (arg == "--arch") {
+            options.architectures = splitList(value);
+            for (const auto& arch : options.architectures) {
+                if (!contains(kArchitectures, arch)) {
+                    std::fprintf(stderr, "Unknown architecture: %s\n", arch.c_str());
+                    return false;
+                }
+            }
+        } else if (arg == "--stages") {
+            options.stages = splitList(value);
+            for (const auto& stage : options.stages) {
+                if (!contains(kStages, stage)) {
+                    std::fprintf(stderr, "Unknown stage: %s\n", stage.c_str());
+                    return false;
+                }
+            }
+        } else if (arg == "--sizes") {
+            options.sizes.clear();
+            for (const auto& size : splitList(value)) {
+                const size_t count = std::strtoull(size.c_str(), nullptr, 10);
+                if (count < 16) {
+                    std::fprintf(stderr, "Invalid size: %s (at least 16 weights)\n", size.c_str());
+                    return false;
+                }
+                options.sizes.push_back(count);
+            }
+        } else if (arg == "--min-time") {
+            options.minSeconds = std::strtod(value.c_str(), nullptr);
+        } else if (arg == "--max-iterations") {
+            options.maxIterations = std::max<size_t>(std::strtoull(value.c_str(), nullptr, 10), 1);
+        } else if (arg == "--json") {
+            options.jsonPath = value;
+        } else {
+            std::fprintf(stderr, "Unknown option: %s\n", arg.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::fprintf(stderr, "Usage: bench_nam_volume_knob [--arch A,B] [--sizes N,M] [--stages S,T] "
+                             "[--min-time <s>] [--max-iterations <N>] [--json <file|->]\n");
+        return 2;
+    }
+
+    const auto scratch = std::filesystem::temp_directory_path() / "bench_nam_volume_knob";
+    std::filesystem::create_directories(scratch);
+
+    if (options.jsonPath == "-") gTable = stderr;
+    std::fprintf(gTable, "%-20s %9s %-13s %6s %14s %14s\n", "arch", "weights", "stage", "iters", "min ms", "median ms");
+    std::vector<StageResult> results;
+    for (size_t size : options.sizes) {
+        for (const auto& arch : options.architectures) benchModel(options, arch, size, scratch, results);
+    }
+    std::filesystem::remove_all(scratch);
+
+    if (options.jsonPath.empty()) return 0;
+    const std::string document = toJson(results).dump(2) + "\n";
+    if (options.jsonPath == "-") {
+        std::fwrite(document.data(), 1, document.size(), stdout);
+        return 0;
+    }
+    std::ofstream out(options.jsonPath, std::ios::binary);
+    out << document;
+    return out ? 0 : 1;
+}
@@ -0,0 +1,69 @@
+// Per-call cost of the .nam version check: the std::regex + substr/stoi code that
+// Validator::validateNam used to run on every call, against Validator::tryParseVersion.
+#include "validator.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <regex>
+#include <stdexcept>
+#include <string>
+
+static std::atomic<size_t> gAllocations{0};
+
+// Kept out of line: once these are inlined, GCC sees memory from operator new reach
+// free() and reports -Wmismatched-new-delete at every delete.
+#if defined(__GNUC__)
+#define BENCH_NOINLINE __attribute__((noinline))
+#else
+#define BENCH_NOINLINE
+#endif
+
+BENCH_NOINLINE void* operator new(std::size_t size) {
+    ++gAllocations;
+    if (void* p = std::malloc(size == 0 ? 1 : size)) return p;
+    throw std::bad_alloc();
+}
+BENCH_NOINLINE void operator delete(void* p) noexcept { std::free(p); }
+BENCH_NOINLINE void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+static bool legacyVersionCheck(const std::string& version) {
+    std::regex versionPattern(R"(^0\.\d+\.\d+$)");
+    if (!std::regex_match(version, versionPattern)) return false;
+    std::string minorPart = version.substr(2, version.find('.', 2) - 2);
+    int minor;
+    try {
+        minor = std::stoi(minorPart);
+    } catch (const std::out_of_range&) {
+        return false;
+    }
+    return minor >= 5;
+}
+
+static bool versionCheck(const std::string& version) {
+    NamVersion parsed;
+    return Validator::tryParseVersion(version, parsed) && Validator::isSupportedVersion(parsed);
+}
+
+template <typename Check>
+static void run(const char* name, const Check& check, size_t iterations) {
+    const std::string inputs[] = {"0.5.0", "0.5.4", "0.12.345", "0.4.9", "0.5.0a"};
+    size_t accepted = 0;
+    const size_t allocationsBefore = gAllocations;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        accepted += check(inputs[i % 5]) ? 1 : 0;
+    }
+    const auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    const double allocations = static_cast<double>(gAllocations - allocationsBefore) / static_cast<double>(iterations);
+    std::printf("%-16s %10.1f ns/call %8.1f allocs/call (accepted %zu)\n", name,
+                elapsed / static_cast<double>(iterations), allocations, accepted);
+}
+
+int main(int argc, char** argv) {
+    const size_t iterations = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+    run("regex (legacy)", legacyVersionCheck, iterations);
+    run("tryParseVersion", versionCheck, iterations);
+    return 0;
+}
@@ -1,8 +1,21 @@
 #ifndef CLI_H
 #define CLI_H
 
+#include <memory>
 #include <string>
 #include <vector>
+#include "nam_writer.h"
+#include "output_writer.h"
+#include "result_cache.h"
+#include "run_stats.h"
+
+// Container of the written outputs.
+enum class NamContainer {
+    // Same as each input: JSON .nam stays JSON, binary .namb stays binary.
+    Auto,
+    Json,
+    Binary
+};
 
 struct CliArgs {
     std::vector<std::string> inputPaths;
@@ -16,6 +29,85 @@ struct CliArgs {
     std::vector<float> gainLinears;
     bool useDb = true;
     bool showHelp = false;
+
+    // Worker threads used by run(). 1 keeps everything on the calling thread;
+    // 0 means one per hardware thread.
+    size_t jobs = 1;
+
+    // Patch the original bytes in place (head weights and loudness/gain/output_level
+    // numbers only) instead of re-serializing; every other byte is copied unchanged.
+    bool surgical = false;
+
+    // gainDbs came from --gain-sweep: each input is serialized once and every gain is written
+    // as that text with only the differing bytes patched.
+    bool gainSweep = false;
+
+    // Layout of re-serialized outputs. Surgical outputs keep the input's layout.
+    NamOutputFormat format = NamOutputFormat::Pretty;
+
+    // --to-binary / --from-binary; either one also gives outputs the .namb / .nam extension.
+    NamContainer container = NamContainer::Auto;
+    // Either flag without a gain: every input is written as it is in the other container,
+    // named <stem>.namb / <stem>.nam.
+    bool convertOnly = false;
+
+    // Existing files at output paths are replaced instead of getting a _vN name. Not a
+    // command-line option: watch sets it, since its output directory is its own.
+    bool replaceOutputs = false;
+
+    // Inputs are read into memory instead of memory-mapped. Not a command-line option: watch
+    // sets it, since a mapped file truncated on a network filesystem raises SIGBUS.
+    bool readInputs = false;
+
+    // When written outputs are flushed to stable storage (see SyncMode).
+    SyncMode sync = SyncMode::None;
+
+    // If set, finished outputs are cached here, keyed by input bytes, gain and options;
+    // outputs found in the cache are reflinked or copied into place without being rendered.
+    std::string cacheDir;
+    uint64_t cacheMaxBytes = ResultCache::kDefaultMaxBytes;
+
+    // If set (--server), the run is handed to the `serve` daemon listening on this Unix
+    // socket instead of being done in this process.
+    std::string server;
+
+    // --stats prints per-stage times and counters when the run ends; --stats-json writes
+    // them as JSON lines to a file ("-" for stdout). Either one turns collection on.
+    bool stats = false;
+    std::string statsJsonPath;
+
+    // --target-lufs / --match-to, instead of gains: every input gets the one dB gain that
+    // brings its output for the standard test signal (TestSignal) to targetLufs, or to the
+    // loudness of matchToPath. Needs a build that can run models (ModelAudio).
+    bool hasTargetLufs = false;
+    float targetLufs = 0.0f;
+    std::string matchToPath;
+
+    bool matchesLoudness() const { return hasTargetLufs || !matchToPath.empty(); }
+};
+
+// The gain --target-lufs / --match-to picked for one input.
+struct LoudnessGain {
+    std::string inputPath;
+    double measuredLufs = 0.0;
+    float gainDb = 0.0f;
+};
+
+// A dB gain sweep: startDb, startDb + stepDb, ... up to and including stopDb.
+struct GainSweep {
+    // Doubles, so start + i * step rounds to the same float as the decimal gain would.
+    double startDb = 0.0;
+    double stopDb = 0.0;
+    double stepDb = 0.0;
+
+    // Parses "start:stop:step".
+    static bool tryParse(const std::string& text, GainSweep& sweep, std::string& error);
+
+    // Fails if the step is zero or points away from stopDb, or if the sweep has more than
+    // kMaxGains gains.
+    bool tryExpand(std::vector<float>& gainsDb, std::string& error) const;
+
+    static constexpr size_t kMaxGains = 1000;
 };
 
 struct CliParseResult {
@@ -28,12 +120,41 @@ struct CliRunResult {
     int exitCode = 0;
     std::string error;
     std::vector<std::string> outputPaths;
+    // Only counted with CliArgs::cacheDir.
+    CacheStats cache;
+    // Only collected with CliArgs::stats or statsJsonPath.
+    RunStats stats;
+    // With --target-lufs / --match-to, one per input in input order.
+    std::vector<LoudnessGain> loudness;
+};
+
+// Outputs rendered in memory instead of written to files.
+struct CliRenderResult {
+    int exitCode = 0;
+    std::string error;
+    std::vector<std::string> outputs;  // one per gain
 };
 
+struct NamModel;
+class ModelCache;
+class ThreadPool;
+
 class CliHandler {
 public:
-    static CliParseResult parseArgs(int argc, char* argv[]);
-    static CliRunResult run(const CliArgs& args);
+    // Without requireInputs, --input may be omitted (for callers that supply inputs later).
+    static CliParseResult parseArgs(int argc, char* argv[], bool requireInputs = true);
+    // The checks parseArgs applies once every option is read (outputs, inputs, gain
+    // limits), for arguments that were built some other way.
+    static bool validateArgs(const CliArgs& args, std::string& error, bool requireInputs = true);
+    // models, if given, supplies already parsed inputs and keeps the ones parsed here.
+    // pool, if given, runs the work instead of a pool of args.jobs threads; args.jobs then
+    // only bounds how many inputs are in flight.
+    static CliRunResult run(const CliArgs& args, ModelCache* models = nullptr, ThreadPool* pool = nullptr);
+    // Every gain of args applied to an in-memory model, serialized as run() would write it
+    // (inputs, outputs and --surgical are ignored; outputs are .namb only for NamContainer::Binary).
+    static CliRenderResult renderModel(const std::shared_ptr<const NamModel>& model, const CliArgs& args);
+    // run() for every gain of sweep (replacing any gains in args), with --gain-sweep output.
+    static CliRunResult runGainSweep(const CliArgs& args, const GainSweep& sweep);
     static std::string usage();
 };
 
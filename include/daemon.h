@@ -0,0 +1,129 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "cli.h"
+#include "model_cache.h"
+
+class ThreadPool;
+
+// Wire protocol of `nam-volume-knob serve` (a stream Unix domain socket). Every message is
+// a frame: a 4-byte little-endian length followed by that many bytes. A request is one
+// JSON header frame, optionally followed by one payload frame; the reply is one JSON
+// header frame followed by header["outputs"] payload frames (0 if absent). A connection
+// may carry any number of requests, one after the other; they are answered in order.
+//
+//   {"op": "run", "args": {...}}
+//       Runs CliHandler::run in the daemon. Paths in args must be absolute.
+//       Reply: {"exitCode", "error", "outputPaths": [...], "cache": {"hits", "misses", "evicted"}},
+//       plus "stats" (RunStats::toJson) if args asked for them.
+//   {"op": "render", "args": {...}} + the .nam or .namb bytes
+//       Renders every gain of args from the payload (CliHandler::renderModel).
+//       Reply: {"exitCode", "error", "outputs": N} + N output frames in gain order.
+//   {"op": "status"}
+//       Reply: {"exitCode": 0, "models", "hits", "misses", "evicted", "requests"}
+//   {"op": "shutdown"}
+//       Reply: {"exitCode": 0}; the daemon then stops as if it got SIGTERM.
+//
+// args holds the CliArgs fields: "inputs", "output", "outputDir", "gainsDb" or
+// "gainsLinear", "gainSweep", "jobs", "surgical", "format", "container" ("auto", "json" or
+// "binary"), "convertOnly", "sync", "cacheDir", "cacheMaxBytes", "stats" (collect them),
+// "targetLufs" (omitted if unset) and "matchTo" (the --match-to model; absolute in run
+// requests like the other paths).
+// Errors use the CLI's messages and exit codes.
+namespace DaemonProtocol {
+nlohmann::json argsToJson(const CliArgs& args);
+// Throws nlohmann::json::exception on missing or mistyped fields and std::invalid_argument
+// on bad option values.
+CliArgs argsFromJson(const nlohmann::json& json);
+
+constexpr size_t kMaxHeaderBytes = size_t(16) << 20;
+constexpr size_t kMaxPayloadBytes = size_t(1) << 30;
+} // namespace DaemonProtocol
+
+struct DaemonOptions {
+    std::string socketPath;
+    // Threads that answer requests and run their work (a run request's "jobs" only bounds
+    // its inputs in flight); 0 means one per hardware thread.
+    size_t jobs = 0;
+    // Parsed models kept in memory.
+    size_t maxModels = 16;
+};
+
+// `nam-volume-knob serve --socket <path>`: answers requests from a pool of threads, keeping
+// recently used models parsed in memory so repeated runs skip startup and parsing. The
+// thread calling run() reads from every connection; only complete requests go to the pool,
+// so idle or slow clients do not hold a worker.
+class DaemonServer {
+public:
+    explicit DaemonServer(DaemonOptions options);
+    // Closes the socket and removes it.
+    ~DaemonServer();
+
+    DaemonServer(const DaemonServer&) = delete;
+    DaemonServer& operator=(const DaemonServer&) = delete;
+
+    // Parses `serve` arguments (argv[1] is "serve").
+    static bool tryParseArgs(int argc, char* argv[], DaemonOptions& options, std::string& error);
+    static std::string usage();
+
+    // Binds and listens on the socket (readable by this user only). A stale socket left by a
+    // daemon that died is replaced; a live one is an error.
+    bool tryStart(std::string& error);
+
+    // Answers connections until stop() is called or a shutdown request arrives, then waits
+    // for the requests in progress.
+    void run();
+
+    // Async-signal-safe.
+    void stop();
+
+    const ModelCache& models() const { return models_; }
+
+private:
+    struct Connection;
+
+    bool dispatchNext(Connection& connection, ThreadPool& pool);
+    void finishRequest(int fd, bool keepOpen);
+    bool handleRequest(int fd, const nlohmann::json& request, std::string_view payload, ThreadPool& pool,
+                       bool& keepOpen);
+
+    DaemonOptions options_;
+    ModelCache models_;
+    int listenFd_ = -1;
+    int wakeFds_[2] = {-1, -1};
+    bool bound_ = false;
+    std::atomic<bool> stopRequested_{false};
+    std::atomic<size_t> requests_{0};
+
+    // Connections whose request was answered, and whether to keep reading from them.
+    std::mutex finishedMutex_;
+    std::vector<std::pair<int, bool>> finished_;
+};
+
+// Client side of the protocol.
+class DaemonClient {
+public:
+    // Sends one request (with payload as its payload frame unless it is null) and reads the
+    // reply. connected, if given, is set once the daemon accepted the connection.
+    static bool tryCall(const std::string& socketPath, const nlohmann::json& request, const std::string_view* payload,
+                        nlohmann::json& reply, std::vector<std::string>& outputs, std::string& error,
+                        bool* connected = nullptr);
+
+    // --server: run(args) in the daemon. Relative paths are resolved against the current
+    // directory and reported back the way a local run would print them.
+    static bool tryRun(const std::string& socketPath, const CliArgs& args, CliRunResult& result, std::string& error,
+                       bool* connected = nullptr);
+
+    static bool tryRender(const std::string& socketPath, std::string_view namBytes, const CliArgs& args,
+                          CliRenderResult& result, std::string& error);
+};
+
+#endif // DAEMON_H
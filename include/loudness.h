@@ -0,0 +1,79 @@
+#ifndef LOUDNESS_H
+#define LOUDNESS_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Levels of one mono signal. lufs is the ITU-R BS.1770-4 gated integrated loudness, or
+// -infinity if no block passes the gates (e.g. silence). envelope is the unweighted RMS of
+// each complete 100 ms hop.
+struct AudioLevels {
+    double peak = 0.0;
+    double rms = 0.0;
+    double lufs = 0.0;
+    std::vector<float> envelope;
+};
+
+// Streaming BS.1770-4 meter for one mono channel: K-weighting (coefficients derived for the
+// sample rate), 400 ms blocks with 75% overlap, then the absolute (-70 LUFS) and relative
+// (-10 LU) gates. Also tracks the unweighted sample peak, RMS and RMS envelope.
+class LoudnessMeter {
+public:
+    explicit LoudnessMeter(double sampleRate);
+
+    void push(const double* samples, size_t count);
+    AudioLevels levels() const;
+
+private:
+    struct Biquad {
+        double b0 = 0.0, b1 = 0.0, b2 = 0.0, a1 = 0.0, a2 = 0.0;
+        double z1 = 0.0, z2 = 0.0;
+
+        double process(double x) {
+            const double y = b0 * x + z1;
+            z1 = b1 * x - a1 * y + z2;
+            z2 = b2 * x - a2 * y;
+            return y;
+        }
+    };
+
+    Biquad shelf_;
+    Biquad highPass_;
+    size_t hopSize_;             // 100 ms
+    double hopSum_ = 0.0;        // K-weighted energy of the current hop
+    double hopSquares_ = 0.0;    // and its unweighted energy
+    size_t hopFill_ = 0;
+    double recentHops_[4] = {};  // the last four hops make one 400 ms block
+    size_t hopCount_ = 0;
+    std::vector<double> blockPowers_;
+    std::vector<float> envelope_;
+    double peak_ = 0.0;
+    double sumSquares_ = 0.0;
+    size_t sampleCount_ = 0;
+};
+
+// A test signal: the multitone below or white noise from a fixed seed, at an RMS level.
+// Written as "multitone" or "noise", optionally followed by ":<dBFS RMS>[:<seconds>]".
+struct StimulusSpec {
+    enum class Kind { Multitone, Noise };
+    Kind kind = Kind::Multitone;
+    double levelDb = -18.0;
+    double seconds = 5.0;
+
+    // Canonical text form, e.g. "multitone:-18:5"; equal ids generate equal signals.
+    std::string id() const;
+};
+
+// Test signals; deterministic for a given spec and rate. The multitone is equal-amplitude
+// sines at 110, 220, 440, 880, 1760 and 3520 Hz with fixed phases.
+class TestSignal {
+public:
+    // The multitone at -18 dBFS RMS, used for loudness matching.
+    static std::vector<double> standard(double sampleRate, double seconds);
+    static std::vector<double> generate(const StimulusSpec& spec, double sampleRate);
+
+    static bool tryParse(const std::string& text, StimulusSpec& spec, std::string& error);
+};
+
+#endif // LOUDNESS_H
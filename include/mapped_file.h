@@ -0,0 +1,41 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Read-only view of a whole file. Regular files are memory-mapped with a sequential-access
+// hint, so parsers can run straight over the page cache without an iostream layer. Anything
+// else (pipes, /dev/stdin, character devices) and platforms without mmap fall back to
+// reading the stream into an owned buffer.
+class MappedFile {
+public:
+    MappedFile() = default;
+    // Throws std::runtime_error if the file cannot be opened or read. With allowMap false the
+    // file is always read: a mapping of a file that shrinks underneath it (e.g. truncated on
+    // NFS or SMB) raises SIGBUS on access, where a read just returns fewer bytes.
+    explicit MappedFile(const std::string& path, bool allowMap = true);
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return mapping_ != nullptr ? static_cast<const char*>(mapping_) : buffer_.data(); }
+    size_t size() const { return mapping_ != nullptr ? mappedSize_ : buffer_.size(); }
+    std::string_view view() const { return std::string_view(data(), size()); }
+
+    // True if the contents are mapped rather than copied into a buffer.
+    bool isMapped() const { return mapping_ != nullptr; }
+
+private:
+    void release();
+
+    void* mapping_ = nullptr;
+    size_t mappedSize_ = 0;
+    std::string buffer_;
+};
+
+#endif // MAPPED_FILE_H
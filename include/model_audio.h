@@ -0,0 +1,28 @@
+#ifndef MODEL_AUDIO_H
+#define MODEL_AUDIO_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "loudness.h"
+
+// Runs .nam models on test signals through NeuralAmpModelerCore. Only builds configured with
+// it (NAM_VOLUME_KNOB_WITH_NAM_CORE and the library in third_party/) can do this; elsewhere
+// every call fails with an error saying so.
+class ModelAudio {
+public:
+    static bool available();
+
+    // Loads modelPath, resets and prewarms it at sampleRate, then streams input through it in
+    // blocks of blockSize frames and meters the output. The sample buffers are per thread and
+    // reused, so measuring many models on a pool allocates little beyond the models. If
+    // processSeconds is given it receives the time spent in the model's process() calls.
+    static bool tryMeasure(const std::string& modelPath, const std::vector<double>& input, double sampleRate,
+                           size_t blockSize, AudioLevels& levels, std::string& error,
+                           double* processSeconds = nullptr);
+
+    static constexpr double kSampleRate = 48000.0;
+    static constexpr size_t kBlockSize = 2048;
+};
+
+#endif // MODEL_AUDIO_H
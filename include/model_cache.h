@@ -0,0 +1,50 @@
+#ifndef MODEL_CACHE_H
+#define MODEL_CACHE_H
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "nam_model.h"
+#include "result_cache.h"
+
+// In-memory LRU of parsed and validated models, so a long-running process (the serve
+// daemon) parses each input once and renders every later request from the shared model.
+// Entries are immutable and handed out as shared_ptrs, so evicting one never invalidates a
+// render that is still using it. Safe to use from several threads.
+class ModelCache {
+public:
+    // Holds at most capacity models (at least one).
+    explicit ModelCache(size_t capacity);
+
+    // The model cached under key, marked as most recently used; nullptr on a miss.
+    std::shared_ptr<const NamModel> find(const std::string& key);
+
+    // Caches model under key (replacing any older entry) and evicts the least recently used
+    // models beyond capacity.
+    void insert(const std::string& key, std::shared_ptr<const NamModel> model);
+
+    // Key for the current contents of the file at path: its canonical path, size and
+    // modification time, so an edited file misses. Empty if the file cannot be stat'ed.
+    static std::string fileKey(const std::string& path);
+
+    // Key for an in-memory document (its XXH64 and length).
+    static std::string bytesKey(std::string_view bytes);
+
+    size_t size() const;
+    CacheStats stats() const;
+
+private:
+    using Entry = std::pair<std::string, std::shared_ptr<const NamModel>>;
+
+    size_t capacity_;
+    mutable std::mutex mutex_;
+    // Most recently used first.
+    std::list<Entry> entries_;
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+    CacheStats stats_;
+};
+
+#endif // MODEL_CACHE_H
@@ -0,0 +1,38 @@
+#ifndef NAM_BINARY_H
+#define NAM_BINARY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+// .namb, the binary companion of .nam (written by NamWriter::dumpBinary, read by NamParser).
+// All integers and floats are little-endian:
+//
+//   0   "NAMB"           magic
+//   4   uint32 version   kVersion
+//   8   uint64 size      of the JSON header that follows
+//   16  JSON header      {"document": <NamModel::document, weights left as null>,
+//                         "weights": [{"owner": <JSON pointer>, "offset": <bytes>, "count": <floats>}, ...]}
+//       zero padding up to the next multiple of kAlignment: the start of the data section
+//   ... float32 blobs    one per weight array, each at a kAlignment-aligned offset from the
+//                        start of the data section
+//
+// Loading is a bounds check and a memcpy per array; no float text is parsed or printed.
+namespace NamBinary {
+constexpr char kMagic[4] = {'N', 'A', 'M', 'B'};
+constexpr uint32_t kVersion = 1;
+constexpr size_t kPrefixSize = 16;
+constexpr size_t kAlignment = 64;
+constexpr const char* kExtension = ".namb";
+
+inline size_t alignUp(size_t offset) {
+    return (offset + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+inline bool matches(std::string_view bytes) {
+    return bytes.size() >= sizeof(kMagic) && std::memcmp(bytes.data(), kMagic, sizeof(kMagic)) == 0;
+}
+} // namespace NamBinary
+
+#endif // NAM_BINARY_H
@@ -0,0 +1,72 @@
+#ifndef NAM_MODEL_H
+#define NAM_MODEL_H
+
+#include <nlohmann/json.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+// A "weights" array lifted out of the JSON document into contiguous float storage.
+struct NamWeightArray {
+    // JSON pointer to the object that owns the "weights" key: "" for the root model,
+    // "/config/submodels/0/model" for the first SlimmableContainer submodel, and so on.
+    std::string ownerPointer;
+    std::vector<float> values;
+    // Index of the first source element that is not a finite float (a non-number, NaN,
+    // Inf, or a double that overflows float), recorded while parsing so validation does
+    // not have to walk the values again; npos if every element is valid.
+    size_t firstInvalid = npos;
+
+    static constexpr size_t npos = static_cast<size_t>(-1);
+};
+
+// A parsed .nam file in which every "weights" array is stored as floats instead of as
+// nlohmann::json nodes. Everything else (version, config, metadata, ...) stays in a small
+// DOM; each lifted array is left behind in it as a null placeholder under its "weights" key.
+struct NamModel {
+    nlohmann::json document;
+    std::vector<NamWeightArray> weightArrays;
+
+    NamWeightArray* findWeights(const std::string& ownerPointer);
+    const NamWeightArray* findWeights(const std::string& ownerPointer) const;
+
+    // Full DOM with the weights put back, equivalent to what NamParser::parseNamFile returns
+    // (weights become float-valued numbers).
+    nlohmann::json toJson() const;
+
+    // Appends one escaped JSON pointer reference token ("/" + token) to pointer.
+    static void appendPointerToken(std::string& pointer, const std::string& token);
+};
+
+// Replacement values for the range [start, start + values.size()) of one base weight array.
+struct NamWeightOverlay {
+    size_t arrayIndex = 0;  // index into NamModel::weightArrays
+    size_t start = 0;
+    std::vector<float> values;
+};
+
+// One variant (e.g. one gain) of a shared, immutable NamModel. It owns a copy of the document,
+// which is small since weights are only placeholders there, plus overlays for the weight
+// ranges it changed; every other weight is read from the base. N variants of a model cost
+// O(base + N x head) instead of O(N x model).
+struct NamModelVariant {
+    std::shared_ptr<const NamModel> base;
+    nlohmann::json document;
+    std::vector<NamWeightOverlay> overlays;
+
+    explicit NamModelVariant(std::shared_ptr<const NamModel> baseModel);
+
+    // Copies [start, end) of the array owned by ownerPointer into an overlay (once) and returns
+    // it for modification. Returns nullptr if there is no such array, the range is out of
+    // bounds, or the array already has an overlay for a different range.
+    NamWeightOverlay* overlay(const std::string& ownerPointer, size_t start, size_t end);
+    const NamWeightOverlay* findOverlay(size_t arrayIndex) const;
+
+    // Length of the base array owned by ownerPointer; false if there is none.
+    bool tryGetWeightCount(const std::string& ownerPointer, size_t& count) const;
+
+    // Standalone NamModel with the overlays applied (mainly for tests and debugging).
+    NamModel materialize() const;
+};
+
+#endif // NAM_MODEL_H
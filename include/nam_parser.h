@@ -3,10 +3,41 @@
 
 #include <nlohmann/json.hpp>
 #include <string>
+#include <string_view>
+#include "nam_model.h"
 
+class MappedFile;
+
+// Top-level fields of a model, read without parsing its weights.
+struct NamProbe {
+    std::string architecture;  // empty if absent or not a string
+    std::string version;
+};
+
+// File entry points parse straight over the bytes of a MappedFile (no iostream layer).
+// Model entry points accept both JSON .nam and binary .namb input.
 class NamParser {
 public:
     static nlohmann::json parseNamFile(const std::string& path);
+
+    // Streaming (SAX) parse: weights go straight into float storage and never become
+    // JSON nodes, so memory scales with file size rather than with the weight count.
+    static NamModel parseNamModel(const std::string& path);
+    // Same, over a file the caller already mapped (path only names it in errors).
+    static NamModel parseNamModel(const MappedFile& file, const std::string& path);
+
+    // Same streaming parse over an in-memory document, without exceptions (for builds that
+    // disable exception catching). Returns false and sets error if text is not valid JSON.
+    static bool tryParseNamModel(std::string_view text, NamModel& model, std::string& error);
+
+    // Reads a .namb file (see nam_binary.h). parseNamModel and tryParseNamModel call this
+    // themselves when the bytes start with the .namb magic.
+    static bool tryParseNamBinary(std::string_view bytes, NamModel& model, std::string& error);
+
+    // Reads the top-level "architecture" and "version" strings of a .nam or .namb, stopping
+    // as soon as both are seen (before the weights in files written by NAM or this tool).
+    // Returns false if the bytes are not JSON or .namb up to that point. No exceptions.
+    static bool tryProbeNam(std::string_view bytes, NamProbe& probe, std::string& error);
 };
 
-#endif // NAM_PARSER_H
\ No newline at end of file
+#endif // NAM_PARSER_H
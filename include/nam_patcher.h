@@ -0,0 +1,71 @@
+#ifndef NAM_PATCHER_H
+#define NAM_PATCHER_H
+
+#include <nlohmann/json.hpp>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "nam_writer.h"
+
+// Location of one "weights" array in the original .nam text.
+struct NamWeightsSpan {
+    // JSON pointer of the object that owns the "weights" key (see NamWeightArray).
+    std::string ownerPointer;
+    // Byte range between the brackets, i.e. the array contents.
+    size_t begin = 0;
+    size_t end = 0;
+    size_t count = 0;
+    // False if any element is not a JSON number.
+    bool numeric = true;
+    // First element that is not a number or does not convert to a finite float, as in
+    // NamWeightArray; npos if there is none.
+    size_t firstInvalid = static_cast<size_t>(-1);
+};
+
+// Result of lexing a .nam file once: a small DOM of everything except weights (each
+// weights array is a null placeholder, as in NamModel) plus byte offsets into the text.
+struct NamTextIndex {
+    nlohmann::json document;
+    std::vector<NamWeightsSpan> weights;
+    // Byte range of every number outside the weights arrays, keyed by JSON pointer.
+    std::map<std::string, std::pair<size_t, size_t>> numbers;
+
+    const NamWeightsSpan* findWeights(const std::string& ownerPointer) const;
+};
+
+// One replacement of text[begin, end) by text.
+struct NamPatchEdit {
+    size_t begin = 0;
+    size_t end = 0;
+    std::string text;
+};
+
+// "Surgical" output: instead of re-serializing the whole document, copy the original
+// bytes and splice in re-formatted numbers for the head weights and for the
+// loudness/gain/output_level metadata. Untouched weights keep their original text.
+class NamPatcher {
+public:
+    static bool tryIndex(std::string_view text, NamTextIndex& index, std::string& error);
+
+    // Validation equivalent to Validator::validateNam, using the lexed structure.
+    static bool validate(const NamTextIndex& index);
+    static bool validate(const NamTextIndex& index, std::string& error);
+
+    // Computes the edits for one gain, sorted by offset. dbGain is used for the metadata
+    // of A1 models; SlimmableContainer models derive it from factor, as WeightScaler does.
+    // weightFormat picks how scaled head weights are printed (see NamWriter::appendWeight),
+    // so patching text written by NamWriter::dump(..., Compact) matches a full compact dump.
+    static bool tryBuildEdits(std::string_view text, const NamTextIndex& index, float factor, float dbGain,
+                              std::vector<NamPatchEdit>& edits, std::string& error,
+                              NamOutputFormat weightFormat = NamOutputFormat::Pretty);
+
+    static std::string apply(std::string_view text, const std::vector<NamPatchEdit>& edits);
+
+    // The patched output as an ordered list of non-empty views: unchanged slices of text
+    // interleaved with edit texts. Lets writers scatter-gather (writev) without building
+    // the patched copy. Views stay valid as long as text and edits do.
+    static std::vector<std::string_view> pieces(std::string_view text, const std::vector<NamPatchEdit>& edits);
+};
+
+#endif // NAM_PATCHER_H
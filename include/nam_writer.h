@@ -0,0 +1,36 @@
+#ifndef NAM_WRITER_H
+#define NAM_WRITER_H
+
+#include <string>
+#include <string_view>
+#include "nam_model.h"
+
+// Pretty matches dump(4), one weight per line. Compact has no whitespace at all and
+// prints weights as the shortest text that reads back as the same float.
+enum class NamOutputFormat { Pretty, Compact };
+
+class NamWriter {
+public:
+    // Serializes the model exactly as model.toJson().dump(4) would, without building the
+    // weight nodes: weights are formatted straight from float storage.
+    static std::string dump(const NamModel& model, NamOutputFormat format = NamOutputFormat::Pretty);
+    // Same for a variant: its document, with overlay values merged over the shared base weights.
+    static std::string dump(const NamModelVariant& variant, NamOutputFormat format = NamOutputFormat::Pretty);
+
+    // The model as a .namb file (see nam_binary.h): the document as compact JSON, then every
+    // weight array as raw float32. Reads back bit-exactly with NamParser.
+    static std::string dumpBinary(const NamModel& model);
+    static std::string dumpBinary(const NamModelVariant& variant);
+
+    // Appends a float the way dump(4) prints it once stored in a JSON number.
+    static void appendFloat(std::string& out, float value);
+    // Appends the shortest decimal that parses back (as float, or as double then narrowed)
+    // to exactly value. Non-finite values become null, as in appendFloat.
+    static void appendShortestFloat(std::string& out, float value);
+    // appendFloat or appendShortestFloat, whichever format uses for weights.
+    static void appendWeight(std::string& out, float value, NamOutputFormat format);
+
+    static bool tryParseFormat(std::string_view name, NamOutputFormat& format);
+};
+
+#endif // NAM_WRITER_H
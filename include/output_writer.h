@@ -0,0 +1,110 @@
+#ifndef OUTPUT_WRITER_H
+#define OUTPUT_WRITER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+class StatsSink;
+
+// When outputs are flushed to stable storage.
+enum class SyncMode {
+    // Never; the page cache decides (previous behavior).
+    None,
+    // fsync every file before it is renamed into place, then its directory.
+    File,
+    // One filesystem-wide sync per batch of files before they are renamed, then their
+    // directories. Far fewer flushes than File on slow or networked storage.
+    Batch
+};
+
+// One output file: pieces are written back to back into a temporary file next to
+// finalPath, which is then renamed over it.
+struct OutputWrite {
+    std::string finalPath;
+    std::vector<std::string_view> pieces;
+    // Owns the memory the pieces point into until the file is written.
+    std::shared_ptr<const void> storage;
+    // If set, the file is published as a copy of this existing file (a reflink where the
+    // filesystem supports it, else a byte copy) and pieces are ignored.
+    std::string sourcePath;
+    // If not -1, an open descriptor of sourcePath that is copied instead of reopening the
+    // path, so the copy still succeeds if sourcePath is deleted meanwhile. storage must keep
+    // it open until the file is written.
+    int sourceFd = -1;
+    // If set, a copy of the published file (reflink or byte copy, never a link to it) is
+    // then stored here. Best effort: failing to store it does not fail the write.
+    std::string copyPath;
+    // If set, receives this file's share of its batch's write time, its bytes and its
+    // output count. Must stay alive until finish() returns.
+    StatsSink* stats = nullptr;
+};
+
+// Writer stage for CliHandler::run. Files are published on a dedicated thread, in submit
+// order and in batches, so writes overlap with parsing and scaling of the next outputs.
+// On Linux the opens, writes, syncs, closes and renames of a batch are each issued as one
+// io_uring submission when the kernel supports it; elsewhere (or if io_uring is
+// unavailable) the thread makes the same calls one by one.
+//
+// After the first failure nothing else is published, so the published files are always a
+// prefix of the submitted ones.
+class OutputWriter {
+public:
+    enum class Backend { Auto, Thread };
+
+    explicit OutputWriter(SyncMode sync, Backend backend = Backend::Auto);
+    // Publishes everything still queued.
+    ~OutputWriter();
+
+    OutputWriter(const OutputWriter&) = delete;
+    OutputWriter& operator=(const OutputWriter&) = delete;
+
+    // Queues a file. Blocks while too much output is already pending. Returns false (and
+    // drops the write) once an earlier write has failed.
+    bool submit(OutputWrite write);
+
+    // Waits until every queued file is published or dropped. On failure, error is the
+    // CLI message for the first file that could not be written.
+    bool finish(std::string& error);
+
+    // Number of files published so far; they are the first ones submitted.
+    size_t publishedCount() const;
+
+    // "io_uring" or "thread".
+    const char* backendName() const;
+
+    static bool tryParseSyncMode(std::string_view name, SyncMode& sync);
+
+    // Upper bound on bytes queued but not yet written before submit() waits.
+    static constexpr size_t kMaxQueuedBytes = size_t(256) << 20;
+    // Most files handled by one batch.
+    static constexpr size_t kMaxBatchFiles = 32;
+
+    class Engine;
+
+private:
+    void writerLoop();
+
+    SyncMode sync_;
+    std::unique_ptr<Engine> engine_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable queueChanged_;
+    std::deque<OutputWrite> queue_;
+    size_t queuedBytes_ = 0;
+    bool busy_ = false;
+    bool stopping_ = false;
+    bool failed_ = false;
+    std::string error_;
+    size_t published_ = 0;
+
+    std::thread thread_;
+};
+
+#endif // OUTPUT_WRITER_H
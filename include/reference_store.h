@@ -0,0 +1,43 @@
+#ifndef REFERENCE_STORE_H
+#define REFERENCE_STORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "loudness.h"
+
+// On-disk store of original models' measurements for `verify --reference-cache`, so an
+// unchanged original is run once per stimulus and sample rate instead of on every verify.
+// One JSON line per entry (key, peak, RMS, LUFS, envelope). New entries are appended, so
+// runs sharing the file keep each other's results; the last line for a key wins, and the
+// file is rewritten without duplicates once they make up half of it. The rewrite re-reads
+// the file under an exclusive lock on "<path>.lock" (appends hold it shared), so lines
+// other runs appended meanwhile are kept.
+class ReferenceStore {
+public:
+    // Loads path if it exists; lines that cannot be read are skipped. Throws
+    // std::runtime_error if the file exists but cannot be opened.
+    explicit ReferenceStore(std::string path);
+
+    // "<XXH64 of the model bytes>/<stimulus id>/<sample rate>".
+    static std::string makeKey(uint64_t contentHash, const StimulusSpec& stimulus, double sampleRate);
+
+    bool lookup(const std::string& key, AudioLevels& levels) const;
+    void insert(const std::string& key, const AudioLevels& levels);
+
+    // Appends the entries inserted since loading, or rewrites the file (temp file + rename)
+    // merged with its current contents when compacting.
+    bool trySave(std::string& error);
+
+    size_t size() const { return entries_.size(); }
+
+private:
+    std::string path_;
+    std::unordered_map<std::string, AudioLevels> entries_;
+    std::vector<std::string> added_;
+    size_t lines_ = 0;
+};
+
+#endif // REFERENCE_STORE_H
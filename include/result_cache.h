@@ -0,0 +1,75 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+struct CacheStats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evicted = 0;
+};
+
+// A cache entry found by ResultCache::lookup(). It is held open, so its bytes stay readable
+// even if the file is deleted (e.g. evicted by another run's trim()) before they are used.
+class CacheEntry {
+public:
+    CacheEntry(std::string path, int fd);
+    ~CacheEntry();
+
+    CacheEntry(const CacheEntry&) = delete;
+    CacheEntry& operator=(const CacheEntry&) = delete;
+
+    const std::string& path() const { return path_; }
+    // -1 where POSIX descriptors are unavailable; the entry is then only a path.
+    int fd() const { return fd_; }
+
+private:
+    std::string path_;
+    int fd_;
+};
+
+// Opt-in on-disk cache of finished outputs (--cache-dir). An entry is a plain read-only
+// file named <key>.entry, whether it holds a JSON or a binary output; the key is a hash of
+// the input bytes and of every option that shapes the output bytes. Its mtime records its
+// last use; trim() deletes the least recently used entries once the directory holds more
+// than maxBytes.
+class ResultCache {
+public:
+    // Creates dir if needed. Throws std::runtime_error if it cannot be created.
+    ResultCache(std::string dir, uint64_t maxBytes);
+
+    // XXH64 of bytes.
+    static uint64_t hash(std::string_view bytes, uint64_t seed = 0);
+
+    // 32 hex digits: the input hash followed by a hash of options (gain, mode, format,
+    // tool version, ...) seeded with it.
+    static std::string makeKey(uint64_t inputHash, std::string_view options);
+
+    // Key's entry, opened, if it is cached; else nullptr. Counts a hit or a miss; a hit
+    // also marks the entry as just used. Safe to call from several threads.
+    std::shared_ptr<const CacheEntry> lookup(const std::string& key);
+
+    // Where the entry for key lives (whether or not it exists yet).
+    std::string entryPath(const std::string& key) const;
+
+    // Deletes least recently used entries until the cache fits in maxBytes.
+    void trim();
+
+    CacheStats stats() const;
+
+    static constexpr uint64_t kDefaultMaxBytes = uint64_t(1024) << 20;
+
+private:
+    std::string dir_;
+    uint64_t maxBytes_;
+    std::atomic<size_t> hits_{0};
+    std::atomic<size_t> misses_{0};
+    size_t evicted_ = 0;
+};
+
+#endif // RESULT_CACHE_H
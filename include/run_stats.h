@@ -0,0 +1,150 @@
+#ifndef RUN_STATS_H
+#define RUN_STATS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+// Stages of one run. Times are summed over every thread that worked on a file, so with
+// --jobs > 1 they can add up to more than the wall time.
+enum class StatsStage { Cache, Parse, Validate, Scale, Serialize, Write };
+constexpr size_t kStatsStageCount = 6;
+
+enum class StatsCounter {
+    BytesRead,
+    BytesWritten,
+    // Weights parsed, validated or serialized.
+    WeightsVisited,
+    WeightsScaled,
+    // Heap allocations made inside timed stages (0 unless the program counts them, see
+    // Stats::noteAllocation).
+    Allocations,
+    Outputs
+};
+constexpr size_t kStatsCounterCount = 6;
+
+// Totals of one input file, or of a whole run.
+struct FileStats {
+    std::string inputPath;
+    std::array<uint64_t, kStatsStageCount> stageNs{};
+    std::array<uint64_t, kStatsCounterCount> counters{};
+
+    uint64_t counter(StatsCounter c) const { return counters[static_cast<size_t>(c)]; }
+};
+
+// --stats / --stats-json: what CliHandler::run measured.
+struct RunStats {
+    bool collected = false;
+    std::vector<FileStats> files;  // in input order; inputs never started are left out
+    uint64_t wallNs = 0;
+    uint64_t peakRssBytes = 0;  // of the process that did the work; 0 if unknown
+
+    FileStats total() const;
+
+    // Aggregate table (stage percentiles over files, counters, peak RSS) and one line per file.
+    std::string summary() const;
+    // One {"type": "file", ...} line per input, then a {"type": "run", ...} line with the
+    // totals and a per-stage histogram of the file times.
+    std::string jsonLines() const;
+
+    nlohmann::json toJson() const;
+    // Throws nlohmann::json::exception on missing or mistyped fields.
+    static RunStats fromJson(const nlohmann::json& json);
+};
+
+// Collects the stages and counters of one input from every thread working on it.
+class StatsSink {
+public:
+    void add(StatsStage stage, uint64_t ns) { stageNs_[static_cast<size_t>(stage)].fetch_add(ns, std::memory_order_relaxed); }
+    void add(StatsCounter counter, uint64_t n) { counters_[static_cast<size_t>(counter)].fetch_add(n, std::memory_order_relaxed); }
+
+    FileStats snapshot(const std::string& inputPath) const;
+
+private:
+    std::array<std::atomic<uint64_t>, kStatsStageCount> stageNs_{};
+    std::array<std::atomic<uint64_t>, kStatsCounterCount> counters_{};
+};
+
+// Hooks for instrumented code. Everything records into the sink bound to the calling thread
+// (StatsBinding) and is a single thread-local load and branch when none is bound.
+class Stats {
+public:
+    static StatsSink* current() { return current_; }
+
+    static void count(StatsCounter counter, uint64_t n) {
+        if (current_ != nullptr) current_->add(counter, n);
+    }
+
+    // Called by a replacement operator new (main.cpp) so timed stages can report their
+    // allocations.
+    static void noteAllocation() { ++allocations_; }
+    static uint64_t allocations() { return allocations_; }
+
+    // Peak resident set size of this process; 0 where it cannot be read.
+    static uint64_t peakRssBytes();
+
+private:
+    friend class StatsBinding;
+    friend class StatsTimer;
+
+    // Constant-initialized inline variables, so reading them needs no TLS init call.
+    static inline thread_local StatsSink* current_ = nullptr;
+    static inline thread_local uint64_t allocations_ = 0;
+    static inline thread_local bool timing_ = false;
+};
+
+// Binds sink (which may be nullptr) to the calling thread for the lifetime of the binding.
+class StatsBinding {
+public:
+    explicit StatsBinding(StatsSink* sink) : previous_(Stats::current_), previousTiming_(Stats::timing_) {
+        Stats::current_ = sink;
+        Stats::timing_ = false;
+    }
+    ~StatsBinding() {
+        Stats::current_ = previous_;
+        Stats::timing_ = previousTiming_;
+    }
+
+    StatsBinding(const StatsBinding&) = delete;
+    StatsBinding& operator=(const StatsBinding&) = delete;
+
+private:
+    StatsSink* previous_;
+    bool previousTiming_;
+};
+
+// Adds the time of its scope to stage of the thread's sink. Timers nested in another one
+// are ignored, so a stage calling into another is counted once, as the outer stage.
+class StatsTimer {
+public:
+    explicit StatsTimer(StatsStage stage) : stage_(stage) {
+        if (Stats::current_ == nullptr || Stats::timing_) return;
+        sink_ = Stats::current_;
+        Stats::timing_ = true;
+        allocations_ = Stats::allocations_;
+        start_ = std::chrono::steady_clock::now();
+    }
+    ~StatsTimer() {
+        if (sink_ == nullptr) return;
+        const auto elapsed = std::chrono::steady_clock::now() - start_;
+        sink_->add(stage_, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+        sink_->add(StatsCounter::Allocations, Stats::allocations_ - allocations_);
+        Stats::timing_ = false;
+    }
+
+    StatsTimer(const StatsTimer&) = delete;
+    StatsTimer& operator=(const StatsTimer&) = delete;
+
+private:
+    StatsStage stage_;
+    StatsSink* sink_ = nullptr;
+    uint64_t allocations_ = 0;
+    std::chrono::steady_clock::time_point start_;
+};
+
+#endif // RUN_STATS_H
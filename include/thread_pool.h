@@ -0,0 +1,84 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool. Each worker owns a deque: it pops its own work LIFO and
+// steals from the other workers FIFO. Threads that are not workers (e.g. the CLI main
+// thread) submit into a shared queue and can help drain the pool via tryRunPendingTask().
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+
+    // workerCount may be 0, in which case tasks only run when a caller helps (see TaskGroup::wait).
+    explicit ThreadPool(size_t workerCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(Task task);
+
+    // Runs one queued task on the calling thread. Returns false if no task was available.
+    bool tryRunPendingTask();
+
+    size_t workerCount() const { return workers_.size(); }
+
+    static size_t hardwareThreads();
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void workerLoop(size_t index);
+    bool popFrom(size_t queueIndex, bool back, Task& task);
+    bool findTask(size_t preferredQueue, Task& task);
+
+    // queues_[0] is the shared queue for external submitters; queues_[i + 1] belongs to worker i.
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+
+    std::mutex sleepMutex_;
+    std::condition_variable wake_;
+    size_t queued_ = 0;
+    bool stopping_ = false;
+};
+
+// Tracks a set of tasks submitted to a ThreadPool. wait() helps execute queued work
+// instead of blocking, so groups can be nested inside pool tasks without deadlocking
+// or oversubscribing the machine.
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool& pool) : pool_(pool) {}
+    ~TaskGroup();
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void run(std::function<void()> task);
+
+    // Blocks until every task added via run() has finished. Rethrows the first exception
+    // thrown by a task, if any.
+    void wait();
+
+private:
+    void waitNoThrow();
+
+    ThreadPool& pool_;
+    std::mutex mutex_;
+    std::condition_variable done_;
+    size_t pending_ = 0;
+    std::exception_ptr firstError_;
+};
+
+#endif // THREAD_POOL_H
@@ -2,10 +2,73 @@
 #define VALIDATOR_H
 
 #include <nlohmann/json.hpp>
+#include <climits>
+#include <functional>
+#include <string>
+#include <string_view>
+#include "nam_model.h"
+
+// A "MAJOR.MINOR.PATCH" version string, e.g. the top-level "version" field of a .nam file.
+struct NamVersion {
+    int major = 0;
+    int minor = 0;
+    int patch = 0;
+};
 
 class Validator {
 public:
+    // Oldest .nam format accepted; any 0.MINOR.PATCH with MINOR >= 5 is supported.
+    static constexpr NamVersion kMinimumVersion{0, 5, 0};
+
+    // Hand-written replacement for matching ^\d+\.\d+\.\d+$: three runs of ASCII digits
+    // separated by dots, nothing else. Fails if a part does not fit in an int. Usable in
+    // constant expressions and never allocates.
+    static constexpr bool tryParseVersion(std::string_view text, NamVersion& version) {
+        int parts[3] = {0, 0, 0};
+        size_t pos = 0;
+        for (int i = 0; i < 3; ++i) {
+            if (i > 0) {
+                if (pos >= text.size() || text[pos] != '.') return false;
+                ++pos;
+            }
+            const size_t begin = pos;
+            int value = 0;
+            while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9') {
+                const int digit = text[pos] - '0';
+                if (value > (INT_MAX - digit) / 10) return false;
+                value = value * 10 + digit;
+                ++pos;
+            }
+            if (pos == begin) return false;
+            parts[i] = value;
+        }
+        if (pos != text.size()) return false;
+        version = NamVersion{parts[0], parts[1], parts[2]};
+        return true;
+    }
+
+    static constexpr bool isSupportedVersion(const NamVersion& version) {
+        return version.major == kMinimumVersion.major && version.minor >= kMinimumVersion.minor;
+    }
+
+    // tryParseVersion plus isSupportedVersion; on failure error is the message validateNam
+    // gives. For callers that only have the version string (e.g. the web UI's probe).
+    static bool tryCheckVersion(std::string_view text, NamVersion& version, std::string& error);
+
     static bool validateNam(const nlohmann::json& j);
+    static bool validateNam(const NamModel& model);
+    // Same; if the failure is an unsupported version or a bad weight value, error says which.
+    static bool validateNam(const NamModel& model, std::string& error);
+
+    // Structural checks only, for documents whose weight arrays are stored elsewhere.
+    // hasValidWeights(modelPointer) must report whether the weights owned by the model at
+    // that JSON pointer are a non-empty array of finite numbers.
+    static bool validateNamStructure(const nlohmann::json& document,
+                                     const std::function<bool(const std::string& modelPointer)>& hasValidWeights);
+    // Same; error is set if the failure is an unsupported version.
+    static bool validateNamStructure(const nlohmann::json& document,
+                                     const std::function<bool(const std::string& modelPointer)>& hasValidWeights,
+                                     std::string& error);
 };
 
-#endif // VALIDATOR_H
\ No newline at end of file
+#endif // VALIDATOR_H
@@ -0,0 +1,69 @@
+#ifndef VERIFIER_H
+#define VERIFIER_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "loudness.h"
+
+struct VerifyOptions {
+    std::string originalPath;
+    std::vector<std::string> scaledPaths;
+    // One per scaled path; empty means read each from its name (see Verifier::tryExpectedDbFromName).
+    std::vector<float> expectedDbs;
+    StimulusSpec stimulus;
+    double sampleRate = 48000.0;
+    size_t blockSize = 512;
+    // Models run at once; 0 means one per hardware thread.
+    size_t jobs = 1;
+    double toleranceDb = 0.1;
+    // ReferenceStore file for the original's measurement; empty runs it every time.
+    std::string referenceCachePath;
+    bool showHelp = false;
+};
+
+// One model's run. The dB fields compare it with the original and are only set for scaled models.
+struct VerifiedModel {
+    std::string path;
+    AudioLevels levels;
+    double processSeconds = 0.0;
+    double expectedDb = 0.0;
+    double rmsDb = 0.0;
+    double peakDb = 0.0;
+    double lufsDb = 0.0;
+    double envelopeErrorDb = 0.0;  // largest hop-by-hop deviation from expectedDb
+    bool passed = false;
+    bool cached = false;  // levels came from the reference cache
+};
+
+struct VerifyResult {
+    int exitCode = 0;  // 0 all within tolerance, 1 some are not, 2 usage, 3 a model failed to run
+    std::string error;
+    std::string warning;  // e.g. the reference cache could not be saved
+    VerifiedModel original;
+    std::vector<VerifiedModel> scaled;
+    double wallSeconds = 0.0;
+};
+
+// `nam-volume-knob verify`: runs an original and its scaled outputs on a test stimulus,
+// streamed in host-sized blocks with every model on a thread pool, and checks that each
+// output's level differs from the original's by its gain.
+class Verifier {
+public:
+    // Parses `verify` arguments (argv[1] is "verify").
+    static bool tryParseArgs(int argc, char* argv[], VerifyOptions& options, std::string& error);
+    static std::string usage();
+
+    // The gain in a CLI output name: "model_+3_5db.nam" is +3.5, "model_0_5lin_v2.nam" is
+    // 20*log10(0.5).
+    static bool tryExpectedDbFromName(const std::string& path, float& gainDb);
+
+    // Fills model's dB differences from original and whether the RMS one is within tolerance.
+    // The envelope deviation is only informative; it does not decide the result.
+    static void compare(const AudioLevels& original, double toleranceDb, VerifiedModel& model);
+
+    static VerifyResult run(const VerifyOptions& options);
+    static std::string report(const VerifyOptions& options, const VerifyResult& result);
+};
+
+#endif // VERIFIER_H
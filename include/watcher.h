@@ -0,0 +1,94 @@
+#ifndef WATCHER_H
+#define WATCHER_H
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "cli.h"
+
+class ThreadPool;
+
+struct WatchOptions {
+    std::string inputDir;
+    // Every other CLI option (gains, --output-dir, --format, ...); inputs are filled per file.
+    CliArgs args;
+    // Processed inputs; defaults to .nam-volume-knob-watch in the output directory.
+    std::string statePath;
+    // A file is processed once it has had no events for this long.
+    size_t debounceMs = 1000;
+    // Also rescan the directory this often (0: only on start and when inotify overflows),
+    // for shares whose remote writes the kernel does not report.
+    size_t rescanSeconds = 0;
+    // Process what is there now and exit instead of watching.
+    bool once = false;
+    bool showHelp = false;
+};
+
+// One input handled by the watcher.
+struct WatchedFile {
+    std::string inputPath;
+    bool skipped = false;  // already processed with these options (per the state file)
+    int exitCode = 0;
+    std::string error;
+    std::string warning;  // e.g. the state file could not be updated
+    std::vector<std::string> outputPaths;
+};
+
+// `nam-volume-knob watch`: processes the .nam/.namb files in a directory as they land.
+// Each file goes through CliHandler::run once writes to it have settled, up to --jobs files
+// at a time. The state file records an XXH64 of every processed input (bytes and name) under
+// a fingerprint of the options, so a restart skips what is done and a changed file or
+// changed options are processed again. The output directory belongs to the watcher: a
+// changed file's outputs replace the ones written for it before.
+class FolderWatcher {
+public:
+    explicit FolderWatcher(WatchOptions options);
+    ~FolderWatcher();
+
+    FolderWatcher(const FolderWatcher&) = delete;
+    FolderWatcher& operator=(const FolderWatcher&) = delete;
+
+    // Parses `watch` arguments (argv[1] is "watch").
+    static bool tryParseArgs(int argc, char* argv[], WatchOptions& options, std::string& error);
+    static std::string usage();
+
+    // Creates the output directory, loads the state file and, unless --once, starts watching
+    // the input directory (inotify; Linux only).
+    bool tryStart(std::string& error);
+
+    // Processes the current contents, then (unless --once) every file that settles until
+    // stop() is called. report is called on this thread for each file not skipped. Returns
+    // false if watching fails, e.g. when the input directory is removed.
+    bool run(const std::function<void(const WatchedFile&)>& report, std::string& error);
+
+    // Async-signal-safe.
+    void stop();
+
+    // The .nam/.namb files directly in the input directory (not hidden ones), sorted.
+    std::vector<std::string> scan() const;
+
+    // Runs every path that is not already in the state file, up to --jobs at a time, and
+    // records the ones that succeed. Results are in the order of paths.
+    std::vector<WatchedFile> processFiles(const std::vector<std::string>& paths);
+
+private:
+    bool tryLoadState(std::string& error);
+    bool recordProcessed(const std::string& key, std::string& error);
+    bool watchLoop(const std::function<void(const WatchedFile&)>& report, std::string& error);
+
+    WatchOptions options_;
+    std::string optionsKey_;
+    std::unique_ptr<ThreadPool> pool_;
+    std::mutex stateMutex_;
+    std::unordered_set<std::string> processed_;
+    int inotifyFd_ = -1;
+    int wakeFds_[2] = {-1, -1};
+    std::atomic<bool> stopRequested_{false};
+};
+
+#endif // WATCHER_H
@@ -0,0 +1,28 @@
+#ifndef WEIGHT_KERNELS_H
+#define WEIGHT_KERNELS_H
+
+#include <cstddef>
+
+// Vectorized float kernels used by WeightScaler and Validator. The instruction set is
+// picked once at runtime on x86 (AVX-512F, AVX2, SSE2) and at compile time for
+// WebAssembly (SIMD128 when built with -msimd128); a scalar loop is the fallback.
+// Every path performs the same IEEE single-precision multiply, so results are
+// bit-identical to the scalar loop.
+class WeightKernels {
+public:
+    // data[i] *= factor for every i in [0, count).
+    static void scale(float* data, size_t count, float factor);
+
+    // scale() fused with a finite check of the results: returns the index of the first
+    // element that is NaN or infinite after scaling, or count if all are finite. All
+    // elements are scaled either way.
+    static size_t scaleAndFindNonFinite(float* data, size_t count, float factor);
+
+    // Index of the first NaN or infinite element, or count if there is none.
+    static size_t findNonFinite(const float* data, size_t count);
+
+    // Name of the selected implementation: "avx512f", "avx2", "sse2", "simd128" or "scalar".
+    static const char* activeIsa();
+};
+
+#endif // WEIGHT_KERNELS_H
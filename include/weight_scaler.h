@@ -5,16 +5,35 @@
 #include <vector>
 #include <utility>
 #include <string>
+#include "nam_model.h"
+
+class ThreadPool;
 
 class WeightScaler {
 public:
     static bool tryGetHeadWeightIndices(const std::string& arch, const nlohmann::json& config, size_t weightsSize, size_t& start, size_t& end, std::string& error);
     static std::pair<size_t, size_t> getHeadWeightIndices(const std::string& arch, const nlohmann::json& config, size_t weightsSize);
     static void scaleWeights(std::vector<float>& weights, size_t start, size_t end, float factor);
+    // scaleWeights() fused with a finite check of the scaled values (e.g. overflow to Inf).
+    static bool tryScaleWeights(std::vector<float>& weights, size_t start, size_t end, float factor, std::string& error);
+    // Same for a variant: [start, end) of the base array owned by ownerPointer is copied into
+    // an overlay and scaled there; the shared base is left untouched.
+    static bool tryScaleWeights(NamModelVariant& variant, const std::string& ownerPointer, size_t start, size_t end,
+                                float factor, std::string& error);
+    // In-place single pass over a JSON weights array: checks each element is a finite number,
+    // rounds it to float, and scales [start, end). On failure error names the first bad index
+    // and the array is left partially converted.
+    static bool tryScaleJsonWeights(nlohmann::json& weights, size_t start, size_t end, float factor, std::string& error);
 
-    // Scale A2 (SlimmableContainer) model by recursively scaling each submodel's head weights
-    static bool tryScaleA2Model(nlohmann::json& model, float factor, std::string& error);
+    // Scale A2 (SlimmableContainer) model by recursively scaling each submodel's head weights.
+    // With a pool, the submodels of each container are scaled as tasks of it (nested
+    // containers share it); on failure error is that of the first failing submodel by index.
+    static bool tryScaleA2Model(nlohmann::json& model, float factor, std::string& error, ThreadPool* pool = nullptr);
     static void scaleA2Model(nlohmann::json& model, float factor);
+    // Same, for a streamed NamModel whose weights live in NamModel::weightArrays
+    static bool tryScaleA2Model(NamModel& model, float factor, std::string& error, ThreadPool* pool = nullptr);
+    // Same, recording scaled head ranges as overlays of the variant
+    static bool tryScaleA2Model(NamModelVariant& variant, float factor, std::string& error, ThreadPool* pool = nullptr);
 
     // Update model metadata (loudness, gain, output_level) to reflect scaling applied to weights
     // This prevents host normalization from negating the weight-level changes
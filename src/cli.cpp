@@ -1,22 +1,49 @@
 #include "cli.h"
 #include "nam_parser.h"
+#include "mapped_file.h"
+#include "nam_writer.h"
+#include "nam_patcher.h"
 #include "weight_scaler.h"
 #include "validator.h"
+#include "thread_pool.h"
+#include "output_writer.h"
+#include "model_cache.h"
+#include "nam_binary.h"
+#include "model_audio.h"
+#include <atomic>
+#include <chrono>
+#include <deque>
 #include <iostream>
 #include <fstream>
 #include <cmath>
+#include <cstring>
 #include <algorithm>
 #include <iomanip>
 #include <sstream>
 #include <filesystem>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <unordered_set>
 
 std::string CliHandler::usage() {
-    return "Usage: nam-volume-knob --input <file> [--input <file> ...] [--output <file> | --output-dir <dir>] (--gain-db <dB[,dB...]> | --gain-linear <factor[,factor...]>)";
+    return "Usage: nam-volume-knob --input <file> [--input <file> ...] [--output <file> | --output-dir <dir>] (--gain-db <dB[,dB...]> | --gain-linear <factor[,factor...]> | --gain-sweep <start:stop:step> | --target-lufs <LUFS> | --match-to <ref.nam>) [--jobs <N>] [--surgical] [--format compact|pretty] [--to-binary | --from-binary] [--sync none|file|batch] [--cache-dir <dir> [--cache-max-mb <N>]] [--server <socket>] [--stats] [--stats-json <file|->]";
 }
 
 static constexpr float kMaxGainDb = 9.0f;
 static constexpr float kMaxGainLinear = 2.8183829312644537f; // pow(10, 9/20)
 
+static constexpr size_t kMaxJobs = 256;
+static constexpr float kMinTargetLufs = -70.0f;  // the BS.1770 absolute gate
+static constexpr uint64_t kMaxCacheMb = uint64_t(1) << 24;
+
+#ifndef NAM_VOLUME_KNOB_VERSION
+#define NAM_VOLUME_KNOB_VERSION "dev"
+#endif
+
+// Part of every cache key; bump whenever the bytes written for the same input and options change.
+static constexpr int kCacheOutputRevision = 1;
+
 static bool startsWith(const std::string& s, const std::string& prefix) {
     return s.size() >= prefix.size() && s.compare(0, prefix.size(), prefix) == 0;
 }
@@ -58,6 +85,85 @@ static bool parseFloatList(const std::string& raw, std::vector<float>& out, std:
     return true;
 }
 
+static bool parseJobCount(const std::string& raw, size_t& out) {
+    if (raw.empty() || !std::all_of(raw.begin(), raw.end(), [](unsigned char c) { return std::isdigit(c); })) {
+        return false;
+    }
+    try {
+        out = static_cast<size_t>(std::stoul(raw));
+    } catch (...) {
+        return false;
+    }
+    return out <= kMaxJobs;
+}
+
+static bool parseCacheMb(const std::string& raw, uint64_t& bytes) {
+    if (raw.empty() || !std::all_of(raw.begin(), raw.end(), [](unsigned char c) { return std::isdigit(c); })) {
+        return false;
+    }
+    uint64_t mb = 0;
+    try {
+        mb = std::stoull(raw);
+    } catch (...) {
+        return false;
+    }
+    if (mb == 0 || mb > kMaxCacheMb) return false;
+    bytes = mb << 20;
+    return true;
+}
+
+bool GainSweep::tryParse(const std::string& text, GainSweep& sweep, std::string& error) {
+    double values[3] = {0.0, 0.0, 0.0};
+    size_t begin = 0;
+    for (int i = 0; i < 3; ++i) {
+        const size_t colon = text.find(':', begin);
+        if ((i < 2) != (colon != std::string::npos)) {
+            error = "Expected start:stop:step, got " + text;
+            return false;
+        }
+        const std::string part = text.substr(begin, i < 2 ? colon - begin : std::string::npos);
+        size_t used = 0;
+        try {
+            values[i] = std::stod(part, &used);
+        } catch (...) {
+            used = 0;
+        }
+        if (part.empty() || used != part.size() || !std::isfinite(values[i])) {
+            error = "Invalid float: " + part;
+            return false;
+        }
+        begin = colon + 1;
+    }
+    sweep.startDb = values[0];
+    sweep.stopDb = values[1];
+    sweep.stepDb = values[2];
+    return true;
+}
+
+bool GainSweep::tryExpand(std::vector<float>& gainsDb, std::string& error) const {
+    if (stepDb == 0.0) {
+        error = "Sweep step must not be 0.";
+        return false;
+    }
+    // Steps are computed as start + i * step (no accumulated rounding); a small tolerance
+    // keeps stop inclusive when (stop - start) / step is not exact in binary.
+    const double steps = (stopDb - startDb) / stepDb;
+    if (steps < -1e-6) {
+        error = "Sweep step moves away from stop.";
+        return false;
+    }
+    const double count = std::floor(steps + 1e-6) + 1.0;
+    if (count > static_cast<double>(kMaxGains)) {
+        error = "Sweep produces more than " + std::to_string(kMaxGains) + " gains.";
+        return false;
+    }
+    gainsDb.clear();
+    for (size_t i = 0; i < static_cast<size_t>(count); ++i) {
+        gainsDb.push_back(static_cast<float>(startDb + static_cast<double>(i) * stepDb));
+    }
+    return true;
+}
+
 static std::string formatGainForName(float gain, bool isDb) {
     std::ostringstream oss;
     oss << std::fixed << std::setprecision(7) << gain;
@@ -79,12 +185,113 @@ static std::string joinPath(const std::string& dir, const std::string& filename)
     return p.string();
 }
 
-CliParseResult CliHandler::parseArgs(int argc, char* argv[]) {
+// Rejects non-positive linear gains, non-finite values and boosts above +9 dB.
+static bool checkGainLimits(const CliArgs& args, std::string& error) {
+    if (!args.useDb) {
+        for (float g : args.gainLinears) {
+            if (g <= 0.0f) {
+                error = "Error: --gain-linear values must be > 0 (required for log10 + metadata update).";
+                return false;
+            }
+        }
+    }
+
+    // Safety limit: cap maximum boost.
+    if (args.useDb) {
+        for (float g : args.gainDbs) {
+            if (!std::isfinite(g)) {
+                error = "Error: --gain-db values must be finite numbers.";
+                return false;
+            }
+            if (g > kMaxGainDb) {
+                error = "Error: Maximum allowed gain is +" + std::to_string(kMaxGainDb) + " dB. Got: " + std::to_string(g);
+                return false;
+            }
+        }
+    } else {
+        for (float g : args.gainLinears) {
+            if (!std::isfinite(g)) {
+                error = "Error: --gain-linear values must be finite numbers.";
+                return false;
+            }
+            if (g > kMaxGainLinear) {
+                error = "Error: Maximum allowed gain is +" + std::to_string(kMaxGainDb)
+                    + " dB (linear <= " + std::to_string(kMaxGainLinear) + "). Got: " + std::to_string(g);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool CliHandler::validateArgs(const CliArgs& args, std::string& error, bool requireInputs) {
+    if (requireInputs && args.inputPaths.empty()) {
+        error = "Error: --input is required.\n" + usage();
+        return false;
+    }
+
+    if (args.matchesLoudness()) {
+        if (!args.gainDbs.empty() || !args.gainLinears.empty() || args.convertOnly) {
+            error = "Error: --target-lufs and --match-to pick the gain; they cannot be combined with gains.\n" + usage();
+            return false;
+        }
+        if (args.hasTargetLufs && !args.matchToPath.empty()) {
+            error = "Error: --target-lufs and --match-to are mutually exclusive.\n" + usage();
+            return false;
+        }
+        if (args.hasTargetLufs && !(args.targetLufs >= kMinTargetLufs && args.targetLufs <= 0.0f)) {
+            error = "Error: --target-lufs must be from " + std::to_string(kMinTargetLufs) + " to 0.";
+            return false;
+        }
+        if (!args.matchToPath.empty() && !fileExists(args.matchToPath)) {
+            error = "Error: --match-to file does not exist or is not readable: " + args.matchToPath;
+            return false;
+        }
+    } else if ((args.useDb ? args.gainDbs : args.gainLinears).empty()) {
+        error = "Error: One of --gain-db, --gain-linear or --gain-sweep is required.\n" + usage();
+        return false;
+    }
+
+    if (!args.outputPath.empty() && !args.outputDir.empty()) {
+        error = "Error: Use either --output or --output-dir (not both).\n" + usage();
+        return false;
+    }
+
+    for (const auto& in : args.inputPaths) {
+        if (!fileExists(in)) {
+            error = "Error: Input file does not exist or is not readable: " + in;
+            return false;
+        }
+    }
+
+    if (!checkGainLimits(args, error)) {
+        return false;
+    }
+
+    // If user requested a single explicit output file, enforce single-output mode.
+    const size_t inputCount = args.inputPaths.size();
+    const size_t gainCount = args.matchesLoudness() ? 1 : args.useDb ? args.gainDbs.size() : args.gainLinears.size();
+    const size_t outputCount = inputCount * gainCount;
+    if (!args.outputPath.empty() && outputCount != 1) {
+        error = "Error: --output can only be used when producing exactly one output. Use --output-dir instead.\n" + usage();
+        return false;
+    }
+
+    return true;
+}
+
+CliParseResult CliHandler::parseArgs(int argc, char* argv[], bool requireInputs) {
     CliParseResult result;
     CliArgs args;
 
     bool seenGainDb = false;
     bool seenGainLinear = false;
+    bool seenGainSweep = false;
+    bool seenLoudness = false;
+    bool seenFormat = false;
+    bool seenCacheMax = false;
+    bool seenToBinary = false;
+    bool seenFromBinary = false;
     bool seenInput = false;
 
     for (int i = 1; i < argc; ++i) {
@@ -155,13 +362,157 @@ CliParseResult CliHandler::parseArgs(int argc, char* argv[]) {
             continue;
         }
 
+        if (arg == "--gain-sweep") {
+            if (i + 1 >= argc) {
+                result.error = "Error: Missing value for --gain-sweep.\n" + usage();
+                return result;
+            }
+            GainSweep sweep;
+            std::string err;
+            if (!GainSweep::tryParse(argv[++i], sweep, err) || !sweep.tryExpand(args.gainDbs, err)) {
+                result.error = "Error: Invalid value for --gain-sweep: " + err + "\n" + usage();
+                return result;
+            }
+            args.useDb = true;
+            args.gainSweep = true;
+            seenGainSweep = true;
+            continue;
+        }
+
+        if (arg == "--target-lufs") {
+            if (i + 1 >= argc) {
+                result.error = "Error: Missing value for --target-lufs.\n" + usage();
+                return result;
+            }
+            std::vector<float> values;
+            std::string err;
+            if (!parseFloatList(argv[++i], values, err) || values.size() != 1) {
+                result.error = "Error: Invalid value for --target-lufs: expected one number.\n" + usage();
+                return result;
+            }
+            args.hasTargetLufs = true;
+            args.targetLufs = values[0];
+            seenLoudness = true;
+            continue;
+        }
+
+        if (arg == "--match-to") {
+            if (i + 1 >= argc) {
+                result.error = "Error: Missing value for --match-to.\n" + usage();
+                return result;
+            }
+            args.matchToPath = argv[++i];
+            seenLoudness = true;
+            continue;
+        }
+
+        if (arg == "--surgical") {
+            args.surgical = true;
+            continue;
+        }
+
+        if (arg == "--to-binary" || arg == "--from-binary") {
+            const bool toBinary = arg == "--to-binary";
+            args.container = toBinary ? NamContainer::Binary : NamContainer::Json;
+            (toBinary ? seenToBinary : seenFromBinary) = true;
+            continue;
+        }
+
+        if (arg == "--sync") {
+            if (i + 1 >= argc) {
+                result.error = "Error: Missing value for --sync.\n" + usage();
+                return result;
+            }
+            const std::string raw = argv[++i];
+            if (!OutputWriter::tryParseSyncMode(raw, args.sync)) {
+                result.error = "Error: Invalid value for --sync: expected none, file or batch, got " + raw + "\n" + usage();
+                return result;
+            }
+            continue;
+        }
+
+        if (arg == "--cache-dir") {
+            if (i + 1 >= argc) {
+                result.error = "Error: Missing value for --cache-dir.\n" + usage();
+                return result;
+            }
+            args.cacheDir = argv[++i];
+            continue;
+        }
+
+        if (arg == "--cache-max-mb") {
+            if (i + 1 >= argc) {
+                result.error = "Error: Missing value for --cache-max-mb.\n" + usage();
+                return result;
+            }
+            const std::string raw = argv[++i];
+            if (!parseCacheMb(raw, args.cacheMaxBytes)) {
+                result.error = "Error: Invalid value for --cache-max-mb: expected an integer from 1 to "
+                    + std::to_string(kMaxCacheMb) + ", got " + raw + "\n" + usage();
+                return result;
+            }
+            seenCacheMax = true;
+            continue;
+        }
+
+        if (arg == "--server") {
+            if (i + 1 >= argc) {
+                result.error = "Error: Missing value for --server.\n" + usage();
+                return result;
+            }
+            args.server = argv[++i];
+            continue;
+        }
+
+        if (arg == "--stats") {
+            args.stats = true;
+            continue;
+        }
+
+        if (arg == "--stats-json") {
+            if (i + 1 >= argc) {
+                result.error = "Error: Missing value for --stats-json.\n" + usage();
+                return result;
+            }
+            args.statsJsonPath = argv[++i];
+            continue;
+        }
+
+        if (arg == "--format") {
+            if (i + 1 >= argc) {
+                result.error = "Error: Missing value for --format.\n" + usage();
+                return result;
+            }
+            const std::string raw = argv[++i];
+            if (!NamWriter::tryParseFormat(raw, args.format)) {
+                result.error = "Error: Invalid value for --format: expected compact or pretty, got " + raw + "\n" + usage();
+                return result;
+            }
+            seenFormat = true;
+            continue;
+        }
+
+        if (arg == "--jobs") {
+            if (i + 1 >= argc) {
+                result.error = "Error: Missing value for --jobs.\n" + usage();
+                return result;
+            }
+            const std::string raw = argv[++i];
+            if (!parseJobCount(raw, args.jobs)) {
+                result.error = "Error: Invalid value for --jobs: expected an integer from 0 to "
+                    + std::to_string(kMaxJobs) + ", got " + raw + "\n" + usage();
+                return result;
+            }
+            continue;
+        }
+
         if (startsWith(arg, "-")) {
             result.error = "Error: Unknown option: " + arg + "\n" + usage();
             return result;
         }
     }
 
-    if (!seenInput || args.inputPaths.empty()) {
+    if (requireInputs && (!seenInput || args.inputPaths.empty())) {
         result.error = "Error: --input is required.\n" + usage();
         return result;
     }
@@ -171,69 +522,58 @@ CliParseResult CliHandler::parseArgs(int argc, char* argv[]) {
         return result;
     }
 
-    if (!seenGainDb && !seenGainLinear) {
-        result.error = "Error: One of --gain-db or --gain-linear is required.\n" + usage();
+    if (seenGainSweep && (seenGainDb || seenGainLinear)) {
+        result.error = "Error: --gain-sweep cannot be combined with --gain-db or --gain-linear.\n" + usage();
         return result;
     }
 
-    if (!args.outputPath.empty() && !args.outputDir.empty()) {
-        result.error = "Error: Use either --output or --output-dir (not both).\n" + usage();
+    if (seenCacheMax && args.cacheDir.empty()) {
+        result.error = "Error: --cache-max-mb requires --cache-dir.\n" + usage();
         return result;
     }
 
-    for (const auto& in : args.inputPaths) {
-        if (!fileExists(in)) {
-            result.error = "Error: Input file does not exist or is not readable: " + in;
-            return result;
-        }
+    if (seenFormat && args.surgical) {
+        result.error = "Error: --format cannot be combined with --surgical (surgical output keeps the input's layout).\n" + usage();
+        return result;
     }
 
-    if (!args.useDb) {
-        for (float g : args.gainLinears) {
-            if (g <= 0.0f) {
-                result.error = "Error: --gain-linear values must be > 0 (required for log10 + metadata update).";
-                return result;
-            }
-        }
+    if (seenToBinary && seenFromBinary) {
+        result.error = "Error: --to-binary and --from-binary are mutually exclusive.\n" + usage();
+        return result;
     }
 
-    // Safety limit: cap maximum boost.
-    if (args.useDb) {
-        for (float g : args.gainDbs) {
-            if (!std::isfinite(g)) {
-                result.error = "Error: --gain-db values must be finite numbers.";
-                return result;
-            }
-            if (g > kMaxGainDb) {
-                result.error = "Error: Maximum allowed gain is +" + std::to_string(kMaxGainDb) + " dB. Got: " + std::to_string(g);
-                return result;
-            }
-        }
-    } else {
-        for (float g : args.gainLinears) {
-            if (!std::isfinite(g)) {
-                result.error = "Error: --gain-linear values must be finite numbers.";
-                return result;
-            }
-            if (g > kMaxGainLinear) {
-                result.error = "Error: Maximum allowed gain is +" + std::to_string(kMaxGainDb)
-                    + " dB (linear <= " + std::to_string(kMaxGainLinear) + "). Got: " + std::to_string(g);
-                return result;
-            }
+    if ((seenToBinary || seenFromBinary) && args.surgical) {
+        result.error = "Error: --to-binary and --from-binary cannot be combined with --surgical.\n" + usage();
+        return result;
+    }
+
+    if (seenToBinary && seenFormat) {
+        result.error = "Error: --format cannot be combined with --to-binary (.namb outputs have no text layout).\n" + usage();
+        return result;
+    }
+
+    if (seenLoudness && (seenGainDb || seenGainLinear || seenGainSweep)) {
+        result.error = "Error: --target-lufs and --match-to cannot be combined with --gain-db, --gain-linear or --gain-sweep.\n" + usage();
+        return result;
+    }
+
+    if (!seenGainDb && !seenGainLinear && !seenGainSweep && !seenLoudness) {
+        if (!seenToBinary && !seenFromBinary) {
+            result.error = "Error: One of --gain-db, --gain-linear or --gain-sweep is required.\n" + usage();
+            return result;
         }
+        // Plain conversion: one unscaled output per input.
+        args.convertOnly = true;
+        args.useDb = true;
+        args.gainDbs = {0.0f};
     }
 
-    // If user requested a single explicit output file, enforce single-output mode.
-    const size_t inputCount = args.inputPaths.size();
-    const size_t gainCount = args.useDb ? args.gainDbs.size() : args.gainLinears.size();
-    const size_t outputCount = inputCount * gainCount;
-    if (!args.outputPath.empty() && outputCount != 1) {
-        result.error = "Error: --output can only be used when producing exactly one output. Use --output-dir instead.\n" + usage();
+    if (!validateArgs(args, result.error, requireInputs)) {
         return result;
     }
 
     // Default behavior: if a gain flag appeared but list is empty (shouldn't happen), provide a single default.
-    if (args.useDb && args.gainDbs.empty()) args.gainDbs.push_back(0.0f);
+    if (args.useDb && args.gainDbs.empty() && !args.matchesLoudness()) args.gainDbs.push_back(0.0f);
     if (!args.useDb && args.gainLinears.empty()) args.gainLinears.push_back(1.0f);
 
     result.ok = true;
@@ -241,138 +581,653 @@ CliParseResult CliHandler::parseArgs(int argc, char* argv[]) {
     return result;
 }
 
-CliRunResult CliHandler::run(const CliArgs& args) {
+namespace {
+
+// Text that every gain of one input patches, plus its lexed index: the original bytes
+// (--surgical) or the model serialized once (--gain-sweep).
+struct PatchSource {
+    MappedFile file;
+    std::string serialized;
+    std::string_view text;  // view of file or serialized
+    NamTextIndex index;
+    // How patched head weights are printed; Compact only when serialized is a compact dump.
+    NamOutputFormat weightFormat = NamOutputFormat::Pretty;
+};
+
+// One serialized (input, gain) output, rendered on a pool thread and committed in order.
+struct RenderedOutput {
+    int exitCode = 0;
+    std::string error;
+    std::string serializeError;
+    std::string contents;
+    // Patch-based outputs keep the shared source and this gain's edits instead of contents;
+    // the file is written as NamPatcher::pieces() without concatenating them first.
+    std::shared_ptr<const PatchSource> source;
+    std::vector<NamPatchEdit> edits;
+};
+
+// Work for one input file. Its tasks parse the file and then fan out one task per gain.
+struct InputJob {
+    explicit InputJob(ThreadPool& pool) : pool(pool), tasks(pool) {}
+
+    ThreadPool& pool;
+    TaskGroup tasks;
+    int exitCode = 0;
+    std::string error;
+    std::vector<RenderedOutput> outputs;
+    // With --cache-dir, per gain: the cache entry to publish (null on a miss), and where a
+    // rendered output is stored afterwards.
+    std::vector<std::shared_ptr<const CacheEntry>> cacheHits;
+    std::vector<std::string> cacheEntries;
+    // With --cache-dir, the input as read for hashing; the loader parses it from here instead
+    // of reading the file again.
+    std::optional<MappedFile> input;
+    // Outputs are written as .namb.
+    bool binaryOutput = false;
+    // With --stats, where every task of this input records (owned by run()).
+    StatsSink* stats = nullptr;
+
+    bool isCached(size_t g) const { return !cacheHits.empty() && cacheHits[g] != nullptr; }
+};
+
+struct CancelOnExit {
+    std::atomic<bool>& flag;
+    ~CancelOnExit() { flag = true; }
+};
+
+} // namespace
+
+// pool, if given, is the one the caller runs on; A2 submodels are scaled as tasks of it.
+static RenderedOutput renderOutput(const std::shared_ptr<const NamModel>& model, float gain, bool useDb,
+                                   NamOutputFormat format, bool binary, bool convertOnly, ThreadPool* pool) {
+    RenderedOutput rendered;
+
+    // Each gain gets a copy-on-write variant: the document is copied (weights are only
+    // placeholders there) and scaled head ranges become overlays over the shared weights.
+    NamModelVariant out(model);
+    if (convertOnly) {
+        rendered.contents = binary ? NamWriter::dumpBinary(out) : NamWriter::dump(out, format);
+        return rendered;
+    }
+
+    std::string arch = out.document["architecture"].get<std::string>();
+    float factor = useDb ? std::pow(10.0f, gain / 20.0f) : gain;
+
+    // Handle A2 (SlimmableContainer) models differently from flat architectures
+    if (arch == "SlimmableContainer") {
+        std::string err;
+        if (!WeightScaler::tryScaleA2Model(out, factor, err, pool)) {
+            rendered.exitCode = 3;
+            rendered.error = "Error: Failed to scale A2 model: " + err;
+            return rendered;
+        }
+    } else {
+        // A1 models: scale weights with consistent error handling
+        try {
+            const auto& config = out.document["config"];
+            size_t weightCount = 0;
+            if (!out.tryGetWeightCount("", weightCount)) {
+                throw std::runtime_error("Model missing or invalid weights array.");
+            }
+            auto [start, end] = WeightScaler::getHeadWeightIndices(arch, config, weightCount);
+            std::string err;
+            if (!WeightScaler::tryScaleWeights(out, "", start, end, factor, err)) {
+                throw std::runtime_error(err);
+            }
+
+            // Update metadata to reflect the scaling
+            float dbGain = useDb ? gain : 20.0f * std::log10(gain);
+            WeightScaler::updateMetadata(out.document, dbGain);
+        } catch (const std::exception& e) {
+            rendered.exitCode = 3;
+            rendered.error = "Error: Failed to scale A1 model: " + std::string(e.what());
+            return rendered;
+        }
+    }
+
+    try {
+        rendered.contents = binary ? NamWriter::dumpBinary(out) : NamWriter::dump(out, format);
+    } catch (const std::exception& e) {
+        rendered.serializeError = e.what();
+    }
+    return rendered;
+}
+
+static std::string buildOutputPath(const CliArgs& args, const std::string& inputPath, float gain) {
+    if (!args.outputPath.empty()) {
+        return args.outputPath;
+    }
+
+    std::filesystem::path inPath(inputPath);
+    const std::string baseName = inPath.stem().string();
+    const std::string ext = args.container == NamContainer::Binary ? NamBinary::kExtension
+        : args.container == NamContainer::Json ? ".nam" : inPath.extension().string();
+    const std::string gainStr = formatGainForName(gain, args.useDb);
+    const std::string suffix = args.useDb ? "db" : "lin";
+    const std::string outName = args.convertOnly ? baseName + ext : baseName + "_" + gainStr + suffix + ext;
+
+    if (!args.outputDir.empty()) {
+        return joinPath(args.outputDir, outName);
+    }
+    // Default: write next to input file
+    std::filesystem::path outPath = inPath.parent_path() / outName;
+    return outPath.string();
+}
+
+// Avoid overwriting existing files (unless replace is set). claimed holds the paths already
+// given to earlier outputs of this run, which may still be queued in the writer and not exist
+// yet; those are never reused.
+static std::string resolveCollision(const std::string& outputPath, std::unordered_set<std::string>& claimed,
+                                    bool replace) {
+    std::string finalPath = outputPath;
+    int version = 2;
+    while (claimed.count(finalPath) != 0 || (!replace && std::filesystem::exists(finalPath))) {
+        std::filesystem::path p(outputPath);
+        std::filesystem::path base = p;
+        base.replace_extension();
+        const std::string ext = p.extension().string();
+        finalPath = base.string() + "_v" + std::to_string(version) + ext;
+        version++;
+    }
+    claimed.insert(finalPath);
+    return finalPath;
+}
+
+// True if the file starts with the .namb magic. Pipes are judged by their name instead, since
+// peeking would consume bytes the loader needs.
+static bool isBinaryFile(const std::string& path) {
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file(path, ec)) {
+        return std::filesystem::path(path).extension() == NamBinary::kExtension;
+    }
+    std::ifstream in(path, std::ios::binary);
+    char magic[sizeof(NamBinary::kMagic)] = {};
+    in.read(magic, sizeof(magic));
+    return in.gcount() == sizeof(magic) && NamBinary::matches(std::string_view(magic, sizeof(magic)));
+}
+
+static const char* kInvalidFormatError = "Error: Invalid .nam file format (missing required fields or corrupted): ";
+
+// Parses and validates one input (or takes it from models); on failure sets the job's
+// error and returns nullptr.
+static std::shared_ptr<const NamModel> loadValidatedModel(const std::string& inputPath, InputJob& job,
+                                                          ModelCache* models) {
+    const std::string key = models != nullptr ? ModelCache::fileKey(inputPath) : std::string();
+    if (!key.empty()) {
+        if (auto cached = models->find(key)) {
+            job.input.reset();
+            return cached;
+        }
+    }
+    std::shared_ptr<const NamModel> model;
+    try {
+        if (job.input) {
+            model = std::make_shared<const NamModel>(NamParser::parseNamModel(*job.input, inputPath));
+            job.input.reset();
+        } else {
+            model = std::make_shared<const NamModel>(NamParser::parseNamModel(inputPath));
+        }
+    } catch (const std::exception& e) {
+        job.exitCode = 1;
+        job.error = std::string("Error: ") + e.what();
+        return nullptr;
+    }
+    std::string detail;
+    if (!Validator::validateNam(*model, detail)) {
+        job.exitCode = 3;
+        job.error = kInvalidFormatError + inputPath;
+        if (!detail.empty()) job.error += ": " + detail;
+        return nullptr;
+    }
+    if (!key.empty()) models->insert(key, model);
+    return model;
+}
+
+// Parses one input into a NamModel, then queues one render task per gain on the same group.
+static void loadModelInput(const CliArgs& args, const std::vector<float>& gains, const std::atomic<bool>& cancelled,
+                           const std::string& inputPath, ModelCache* models, InputJob& job) {
+    std::shared_ptr<const NamModel> model = loadValidatedModel(inputPath, job, models);
+    if (!model) return;
+    for (size_t g = 0; g < gains.size(); ++g) {
+        if (job.isCached(g)) continue;
+        job.tasks.run([&args, &gains, &cancelled, &job, model, g] {
+            if (cancelled) return;
+            StatsBinding binding(job.stats);
+            job.outputs[g] = renderOutput(model, gains[g], args.useDb, args.format, job.binaryOutput, args.convertOnly,
+                                          &job.pool);
+        });
+    }
+}
+
+static RenderedOutput renderPatched(const std::shared_ptr<const PatchSource>& source, float gain, bool useDb) {
+    RenderedOutput rendered;
+    const float factor = useDb ? std::pow(10.0f, gain / 20.0f) : gain;
+    const float dbGain = useDb ? gain : 20.0f * std::log10(gain);
+
+    std::string err;
+    if (!NamPatcher::tryBuildEdits(source->text, source->index, factor, dbGain, rendered.edits, err,
+                                   source->weightFormat)) {
+        const bool isA2 = source->index.document["architecture"] == "SlimmableContainer";
+        rendered.exitCode = 3;
+        rendered.error = std::string("Error: Failed to scale ") + (isA2 ? "A2" : "A1") + " model: " + err;
+        rendered.edits.clear();
+        return rendered;
+    }
+    rendered.source = source;
+    return rendered;
+}
+
+static void queuePatchedOutputs(const CliArgs& args, const std::vector<float>& gains, const std::atomic<bool>& cancelled,
+                                std::shared_ptr<const PatchSource> source, InputJob& job) {
+    for (size_t g = 0; g < gains.size(); ++g) {
+        if (job.isCached(g)) continue;
+        job.tasks.run([&args, &gains, &cancelled, &job, source, g] {
+            if (cancelled) return;
+            StatsBinding binding(job.stats);
+            job.outputs[g] = renderPatched(source, gains[g], args.useDb);
+        });
+    }
+}
+
+// --surgical: the original bytes are indexed once and patched per gain.
+static void loadSurgicalInput(const CliArgs& args, const std::vector<float>& gains, const std::atomic<bool>& cancelled,
+                              const std::string& inputPath, InputJob& job) {
+    auto source = std::make_shared<PatchSource>();
+    if (job.input) {
+        source->file = std::move(*job.input);
+        job.input.reset();
+    } else {
+        try {
+            source->file = MappedFile(inputPath);
+        } catch (const std::exception& e) {
+            job.exitCode = 1;
+            job.error = std::string("Error: ") + e.what();
+            return;
+        }
+        Stats::count(StatsCounter::BytesRead, source->file.size());
+    }
+    source->text = source->file.view();
+    if (NamBinary::matches(source->text)) {
+        job.exitCode = 1;
+        job.error = "Error: --surgical needs a JSON .nam input: " + inputPath;
+        return;
+    }
+    std::string err;
+    if (!NamPatcher::tryIndex(source->text, source->index, err)) {
+        job.exitCode = 1;
+        job.error = "Error: JSON parsing failed in " + inputPath + ": " + err;
+        return;
+    }
+    if (!NamPatcher::validate(source->index, err)) {
+        job.exitCode = 3;
+        job.error = kInvalidFormatError + inputPath;
+        if (!err.empty()) job.error += ": " + err;
+        return;
+    }
+    queuePatchedOutputs(args, gains, cancelled, std::move(source), job);
+}
+
+// --gain-sweep: the model is serialized once (exactly as renderOutput would at 0 dB) and
+// every gain patches only its head weights and metadata numbers in that text.
+static void loadSweepInput(const CliArgs& args, const std::vector<float>& gains, const std::atomic<bool>& cancelled,
+                           const std::string& inputPath, ModelCache* models, InputJob& job) {
+    // Binary outputs have no float text to patch, and rendering them is cheap anyway.
+    if (job.binaryOutput) {
+        loadModelInput(args, gains, cancelled, inputPath, models, job);
+        return;
+    }
+    auto source = std::make_shared<PatchSource>();
+    {
+        std::shared_ptr<const NamModel> model = loadValidatedModel(inputPath, job, models);
+        if (!model) return;
+        try {
+            source->serialized = NamWriter::dump(*model, args.format);
+        } catch (const std::exception& e) {
+            job.exitCode = 4;
+            job.error = "Error: Failed to serialize JSON for " + inputPath + ": " + e.what();
+            return;
+        }
+    }
+    source->text = source->serialized;
+    source->weightFormat = args.format;
+    std::string err;
+    if (!NamPatcher::tryIndex(source->text, source->index, err)) {
+        job.exitCode = 1;
+        job.error = "Error: JSON parsing failed in " + inputPath + ": " + err;
+        return;
+    }
+    queuePatchedOutputs(args, gains, cancelled, std::move(source), job);
+}
+
+// Everything besides the input bytes that determines the bytes of one output. --gain-sweep
+// is left out on purpose: its outputs are identical to the equivalent --gain-db list.
+static std::string cacheOptions(const CliArgs& args, float gain, bool binaryOutput) {
+    uint32_t gainBits = 0;
+    std::memcpy(&gainBits, &gain, sizeof(gainBits));
+    return std::string("nam-volume-knob ") + NAM_VOLUME_KNOB_VERSION
+        + ";revision=" + std::to_string(kCacheOutputRevision)
+        + ";mode=" + (args.useDb ? "db" : "linear")
+        + ";gain=" + std::to_string(gainBits)
+        + ";format=" + (args.format == NamOutputFormat::Compact ? "compact" : "pretty")
+        + ";surgical=" + (args.surgical ? "1" : "0")
+        + (binaryOutput ? ";container=binary" : "")
+        + (args.convertOnly ? ";convert=1" : "");
+}
+
+// Reads the input's bytes into job.input for the loader: mapped, or copied into memory with
+// CliArgs::readInputs. Throws std::runtime_error if the file cannot be read.
+static void readInput(const CliArgs& args, const std::string& inputPath, InputJob& job) {
+    job.input.emplace(inputPath, !args.readInputs);
+    Stats::count(StatsCounter::BytesRead, job.input->size());
+}
+
+// --cache-dir: hashes the input bytes and looks every gain up. Returns true if all of them
+// are cached, in which case the input needs no parsing at all; otherwise the bytes are kept
+// in job.input for the loader.
+static bool lookupCachedOutputs(ResultCache& cache, const CliArgs& args, const std::vector<float>& gains,
+                                const std::string& inputPath, InputJob& job) {
+    StatsTimer timer(StatsStage::Cache);
+    uint64_t inputHash = 0;
+    try {
+        readInput(args, inputPath, job);
+        inputHash = ResultCache::hash(job.input->view());
+    } catch (const std::exception&) {
+        job.input.reset();
+        return false;  // the loader reports the read error
+    }
+    bool allCached = true;
+    job.cacheHits.resize(gains.size());
+    job.cacheEntries.resize(gains.size());
+    for (size_t g = 0; g < gains.size(); ++g) {
+        const std::string key = ResultCache::makeKey(inputHash, cacheOptions(args, gains[g], job.binaryOutput));
+        job.cacheHits[g] = cache.lookup(key);
+        if (!job.cacheHits[g]) {
+            job.cacheEntries[g] = cache.entryPath(key);
+            allCached = false;
+        }
+    }
+    if (allCached) job.input.reset();
+    return allCached;
+}
+
+// Length of the test signal --target-lufs / --match-to measure with.
+static constexpr double kLoudnessSeconds = 5.0;
+
+// --target-lufs / --match-to: measures every input (and the reference) on the pool and picks
+// each input's gain, rounded to 0.01 dB; gains above the usual +9 dB limit are errors.
+static bool tryResolveLoudnessGains(const CliArgs& args, ThreadPool& pool, std::vector<LoudnessGain>& gains,
+                                    int& exitCode, std::string& error) {
+    if (!ModelAudio::available()) {
+        exitCode = 2;
+        error = "Error: --target-lufs and --match-to need a build with NeuralAmpModelerCore "
+                "(in third_party/, NAM_VOLUME_KNOB_WITH_NAM_CORE=ON).";
+        return false;
+    }
+
+    // One signal shared by every task; each model streams it in blocks.
+    const std::vector<double> signal = TestSignal::standard(ModelAudio::kSampleRate, kLoudnessSeconds);
+    std::vector<std::string> paths = args.inputPaths;
+    if (!args.matchToPath.empty()) paths.push_back(args.matchToPath);
+    std::vector<AudioLevels> levels(paths.size());
+    std::vector<std::string> errors(paths.size());
+    std::vector<char> failed(paths.size(), 0);
+    TaskGroup tasks(pool);
+    for (size_t i = 0; i < paths.size(); ++i) {
+        tasks.run([&, i] {
+            failed[i] = !ModelAudio::tryMeasure(paths[i], signal, ModelAudio::kSampleRate, ModelAudio::kBlockSize,
+                                                levels[i], errors[i]);
+        });
+    }
+    tasks.wait();
+
+    exitCode = 3;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        if (failed[i]) {
+            error = "Error: " + errors[i];
+            return false;
+        }
+        if (!std::isfinite(levels[i].lufs)) {
+            error = "Error: " + paths[i] + " is silent for the test signal; its loudness cannot be matched.";
+            return false;
+        }
+    }
+
+    const double target = args.hasTargetLufs ? args.targetLufs : levels.back().lufs;
+    gains.clear();
+    for (size_t i = 0; i < args.inputPaths.size(); ++i) {
+        LoudnessGain gain;
+        gain.inputPath = args.inputPaths[i];
+        gain.measuredLufs = levels[i].lufs;
+        gain.gainDb = static_cast<float>(std::round((target - levels[i].lufs) * 100.0) / 100.0);
+        if (gain.gainDb > kMaxGainDb) {
+            std::ostringstream oss;
+            oss << std::fixed << std::setprecision(2) << "Error: " << gain.inputPath << " needs +" << gain.gainDb
+                << " dB to reach " << target << " LUFS; the maximum is +" << std::setprecision(0) << kMaxGainDb << " dB.";
+            error = oss.str();
+            return false;
+        }
+        gains.push_back(std::move(gain));
+    }
+    exitCode = 0;
+    return true;
+}
+
+CliRunResult CliHandler::run(const CliArgs& args, ModelCache* models, ThreadPool* sharedPool) {
     CliRunResult result;
 
     try {
         const auto& gains = args.useDb ? args.gainDbs : args.gainLinears;
 
-        for (const auto& inputPath : args.inputPaths) {
-            auto j = NamParser::parseNamFile(inputPath);
-            if (!Validator::validateNam(j)) {
-                result.exitCode = 3;
-                result.error = "Error: Invalid .nam file format (missing required fields or corrupted): " + inputPath;
+        // Parsing, scaling and serialization run on the pool. Output paths are resolved on
+        // this thread strictly in input order, so names (including _vN collision suffixes)
+        // and outputPaths are identical to a single-threaded run; the writer stage then
+        // publishes the files in that same order.
+        const size_t jobs = args.jobs == 0 ? ThreadPool::hardwareThreads() : args.jobs;
+        std::unique_ptr<ThreadPool> ownPool;
+        if (sharedPool == nullptr) ownPool = std::make_unique<ThreadPool>(jobs - 1);  // the calling thread helps while it waits
+        ThreadPool& pool = sharedPool != nullptr ? *sharedPool : *ownPool;
+        const size_t maxInFlight = jobs == 1 ? 1 : jobs * 2;
+
+        const auto started = std::chrono::steady_clock::now();
+        const bool collectStats = args.stats || !args.statsJsonPath.empty();
+
+        // --target-lufs / --match-to: every input gets its own single gain, measured first.
+        std::vector<std::vector<float>> inputGains;
+        if (args.matchesLoudness()) {
+            int exitCode = 0;
+            std::string error;
+            if (!tryResolveLoudnessGains(args, pool, result.loudness, exitCode, error)) {
+                result.exitCode = exitCode;
+                result.error = std::move(error);
                 return result;
             }
+            for (const auto& loudness : result.loudness) inputGains.push_back({loudness.gainDb});
+        }
+        auto gainsFor = [&](size_t input) -> const std::vector<float>& {
+            return inputGains.empty() ? gains : inputGains[input];
+        };
 
-            for (float gain : gains) {
-                // Work on a fresh copy per gain.
-                auto jOut = j;
+        // One per submitted input; declared before the writer, which records into them.
+        std::vector<std::unique_ptr<StatsSink>> statsSinks;
 
-                std::string arch = jOut["architecture"].get<std::string>();
-                float factor = args.useDb ? std::pow(10.0f, gain / 20.0f) : gain;
+        std::atomic<bool> cancelled{false};
+        std::deque<std::unique_ptr<InputJob>> inFlight;
+        CancelOnExit cancelOnExit{cancelled};
+        size_t nextInput = 0;
 
-                // Handle A2 (SlimmableContainer) models differently from flat architectures
-                if (arch == "SlimmableContainer") {
-                    std::string err;
-                    if (!WeightScaler::tryScaleA2Model(jOut, factor, err)) {
-                        result.exitCode = 3;
-                        result.error = "Error: Failed to scale A2 model: " + err;
-                        return result;
-                    }
-                } else {
-                    // A1 models: scale weights with consistent error handling
+        OutputWriter writer(args.sync);
+        std::unordered_set<std::string> claimedPaths;
+        std::unique_ptr<ResultCache> cache;
+        if (!args.cacheDir.empty()) cache = std::make_unique<ResultCache>(args.cacheDir, args.cacheMaxBytes);
+
+        auto submitNextInput = [&]() {
+            const size_t inputIndex = nextInput++;
+            const std::string& inputPath = args.inputPaths[inputIndex];
+            auto job = std::make_unique<InputJob>(pool);
+            InputJob* jobPtr = job.get();
+            jobPtr->outputs.resize(gainsFor(inputIndex).size());
+            if (collectStats) {
+                statsSinks.push_back(std::make_unique<StatsSink>());
+                jobPtr->stats = statsSinks.back().get();
+            }
+            jobPtr->tasks.run([&args, &gains = gainsFor(inputIndex), &cancelled, &inputPath, &cache, models, jobPtr] {
+                if (cancelled) return;
+                StatsBinding binding(jobPtr->stats);
+                jobPtr->binaryOutput = args.container == NamContainer::Binary
+                    || (args.container == NamContainer::Auto && isBinaryFile(inputPath));
+                if (cache && lookupCachedOutputs(*cache, args, gains, inputPath, *jobPtr)) return;
+                if (args.readInputs && !jobPtr->input) {
                     try {
-                        auto config = jOut["config"];
-                        auto weightsVec = jOut["weights"].get<std::vector<float>>();
-                        size_t weightsSize = weightsVec.size();
-                        auto [start, end] = WeightScaler::getHeadWeightIndices(arch, config, weightsSize);
-                        WeightScaler::scaleWeights(weightsVec, start, end, factor);
-                        jOut["weights"] = weightsVec;
-
-                        // Update metadata to reflect the scaling
-                        float dbGain = args.useDb ? gain : 20.0f * std::log10(gain);
-                        WeightScaler::updateMetadata(jOut, dbGain);
+                        readInput(args, inputPath, *jobPtr);
                     } catch (const std::exception& e) {
-                        result.exitCode = 3;
-                        result.error = "Error: Failed to scale A1 model: " + std::string(e.what());
-                        return result;
+                        jobPtr->exitCode = 1;
+                        jobPtr->error = std::string("Error: ") + e.what();
+                        return;
                     }
                 }
-
-                std::string outputPath;
-                if (!args.outputPath.empty()) {
-                    outputPath = args.outputPath;
+                if (args.surgical) {
+                    loadSurgicalInput(args, gains, cancelled, inputPath, *jobPtr);
+                } else if (args.gainSweep) {
+                    loadSweepInput(args, gains, cancelled, inputPath, models, *jobPtr);
                 } else {
-                    std::filesystem::path inPath(inputPath);
-                    const std::string baseName = inPath.stem().string();
-                    const std::string ext = inPath.extension().string();
-                    const std::string gainStr = formatGainForName(gain, args.useDb);
-                    const std::string suffix = args.useDb ? "db" : "lin";
-                    const std::string outName = baseName + "_" + gainStr + suffix + ext;
-
-                    if (!args.outputDir.empty()) {
-                        outputPath = joinPath(args.outputDir, outName);
-                    } else {
-                        // Default: write next to input file
-                        std::filesystem::path outPath = inPath.parent_path() / outName;
-                        outputPath = outPath.string();
-                    }
+                    loadModelInput(args, gains, cancelled, inputPath, models, *jobPtr);
                 }
+            });
+            inFlight.push_back(std::move(job));
+        };
 
-                // Avoid overwriting existing files
-                std::string finalPath = outputPath;
-                int version = 2;
-                while (std::filesystem::exists(finalPath)) {
-                    std::filesystem::path p(outputPath);
-                    std::filesystem::path base = p;
-                    base.replace_extension();
-                    const std::string ext = p.extension().string();
-                    finalPath = base.string() + "_v" + std::to_string(version) + ext;
-                    version++;
+        // Everything queued before a failure is still published, and a write failure is
+        // reported over any later error since it comes first in output order.
+        auto settle = [&](int exitCode, std::string error) -> CliRunResult& {
+            std::string writeError;
+            const bool written = writer.finish(writeError);
+            if (cache) {
+                cache->trim();
+                result.cache = cache->stats();
+            }
+            if (collectStats) {
+                result.stats.collected = true;
+                for (size_t i = 0; i < statsSinks.size(); ++i) {
+                    result.stats.files.push_back(statsSinks[i]->snapshot(args.inputPaths[i]));
                 }
+                result.stats.wallNs = static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count());
+                result.stats.peakRssBytes = Stats::peakRssBytes();
+            }
+            if (!written) {
+                result.exitCode = 4;
+                result.error = writeError;
+                result.outputPaths.resize(writer.publishedCount());
+                return result;
+            }
+            result.exitCode = exitCode;
+            result.error = std::move(error);
+            return result;
+        };
 
-                // Write to temporary file first, then move to final location on success
-                std::string tempPath = finalPath + ".tmp";
-                {
-                    std::ofstream out(tempPath);
-                    if (!out.is_open()) {
-                        result.exitCode = 4;
-                        result.error = "Error: Failed to open output file for writing: " + finalPath;
-                        return result;
-                    }
+        for (size_t inputIndex = 0; inputIndex < args.inputPaths.size(); ++inputIndex) {
+            const std::string& inputPath = args.inputPaths[inputIndex];
+            const std::vector<float>& inputGainList = gainsFor(inputIndex);
+            while (nextInput < args.inputPaths.size() && inFlight.size() < maxInFlight) {
+                submitNextInput();
+            }
+            std::unique_ptr<InputJob> job = std::move(inFlight.front());
+            inFlight.pop_front();
+            job->tasks.wait();
 
-                    try {
-                        std::string jsonStr = jOut.dump(4);
-                        out << jsonStr;
-                    } catch (const std::exception& e) {
-                        out.close();
-                        std::filesystem::remove(tempPath);
-                        result.exitCode = 4;
-                        result.error = "Error: Failed to serialize JSON for " + finalPath + ": " + e.what();
-                        return result;
-                    }
+            if (job->exitCode != 0) {
+                return settle(job->exitCode, job->error);
+            }
 
-                    out.flush();
-                    if (!out.good()) {
-                        out.close();
-                        std::filesystem::remove(tempPath);
-                        result.exitCode = 4;
-                        result.error = "Error: Failed while writing output file: " + finalPath;
-                        return result;
-                    }
-                    out.close();
+            for (size_t g = 0; g < inputGainList.size(); ++g) {
+                RenderedOutput& rendered = job->outputs[g];
+                const bool cached = job->isCached(g);
+                if (!cached && rendered.exitCode != 0) {
+                    return settle(rendered.exitCode, rendered.error);
                 }
 
-                // Move temporary file to final location
-                try {
-                    std::filesystem::rename(tempPath, finalPath);
-                } catch (const std::exception& e) {
-                    std::filesystem::remove(tempPath);
-                    result.exitCode = 4;
-                    result.error = "Error: Failed to save output file: " + finalPath + ": " + e.what();
-                    return result;
+                const std::string finalPath = resolveCollision(buildOutputPath(args, inputPath, inputGainList[g]), claimedPaths,
+                                                                   args.replaceOutputs);
+                OutputWrite write;
+                write.finalPath = finalPath;
+                if (cached) {
+                    write.sourcePath = job->cacheHits[g]->path();
+                    write.sourceFd = job->cacheHits[g]->fd();
+                    write.storage = job->cacheHits[g];
+                } else {
+                    if (!rendered.serializeError.empty()) {
+                        return settle(4, "Error: Failed to serialize JSON for " + finalPath + ": " + rendered.serializeError);
+                    }
+                    auto storage = std::make_shared<RenderedOutput>(std::move(rendered));
+                    rendered = RenderedOutput();
+                    if (storage->source) {
+                        write.pieces = NamPatcher::pieces(storage->source->text, storage->edits);
+                    } else {
+                        write.pieces.push_back(storage->contents);
+                    }
+                    write.storage = std::move(storage);
+                    if (cache) write.copyPath = job->cacheEntries[g];
+                }
+                write.stats = job->stats;
+                if (!writer.submit(std::move(write))) {
+                    return settle(0, std::string());
                 }
 
                 result.outputPaths.push_back(finalPath);
             }
         }
 
-        result.exitCode = 0;
-        return result;
+        return settle(0, std::string());
     } catch (const std::exception& e) {
         result.exitCode = 1;
         result.error = std::string("Error: ") + e.what();
         return result;
     }
 }
+
+CliRenderResult CliHandler::renderModel(const std::shared_ptr<const NamModel>& model, const CliArgs& args) {
+    CliRenderResult result;
+    const auto& gains = args.useDb ? args.gainDbs : args.gainLinears;
+    if (gains.empty()) {
+        result.exitCode = 2;
+        result.error = "Error: One of --gain-db, --gain-linear or --gain-sweep is required.";
+        return result;
+    }
+    if (!checkGainLimits(args, result.error)) {
+        result.exitCode = 2;
+        return result;
+    }
+    for (float gain : gains) {
+        RenderedOutput rendered = renderOutput(model, gain, args.useDb, args.format,
+                                               args.container == NamContainer::Binary, args.convertOnly, nullptr);
+        if (rendered.exitCode != 0) {
+            result.exitCode = rendered.exitCode;
+            result.error = std::move(rendered.error);
+            result.outputs.clear();
+            return result;
+        }
+        if (!rendered.serializeError.empty()) {
+            result.exitCode = 4;
+            result.error = "Error: Failed to serialize JSON: " + rendered.serializeError;
+            result.outputs.clear();
+            return result;
+        }
+        result.outputs.push_back(std::move(rendered.contents));
+    }
+    return result;
+}
+
+CliRunResult CliHandler::runGainSweep(const CliArgs& args, const GainSweep& sweep) {
+    CliRunResult result;
+    CliArgs sweepArgs = args;
+    sweepArgs.gainLinears.clear();
+    sweepArgs.useDb = true;
+    sweepArgs.gainSweep = true;
+    std::string err;
+    if (!sweep.tryExpand(sweepArgs.gainDbs, err) || !checkGainLimits(sweepArgs, err)) {
+        result.exitCode = 2;
+        result.error = err.rfind("Error: ", 0) == 0 ? err : "Error: Invalid gain sweep: " + err;
+        return result;
+    }
+    return run(sweepArgs);
+}
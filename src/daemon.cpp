@@ -0,0 +1,680 @@
+#include "daemon.h"
+#include "nam_parser.h"
+#include "validator.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(__EMSCRIPTEN__)
+#define NAM_DAEMON_HAVE_SOCKETS 1
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using json = nlohmann::json;
+
+static constexpr size_t kMaxDaemonJobs = 256;
+static constexpr size_t kMaxModels = 1 << 16;
+static constexpr long kSendTimeoutSeconds = 30;
+
+namespace DaemonProtocol {
+
+json argsToJson(const CliArgs& args) {
+    json out;
+    out["inputs"] = args.inputPaths;
+    out["output"] = args.outputPath;
+    out["outputDir"] = args.outputDir;
+    out[args.useDb ? "gainsDb" : "gainsLinear"] = args.useDb ? args.gainDbs : args.gainLinears;
+    out["gainSweep"] = args.gainSweep;
+    if (args.hasTargetLufs) out["targetLufs"] = args.targetLufs;
+    out["matchTo"] = args.matchToPath;
+    out["jobs"] = args.jobs;
+    out["surgical"] = args.surgical;
+    out["format"] = args.format == NamOutputFormat::Compact ? "compact" : "pretty";
+    out["container"] = args.container == NamContainer::Binary ? "binary" : args.container == NamContainer::Json ? "json" : "auto";
+    out["convertOnly"] = args.convertOnly;
+    out["sync"] = args.sync == SyncMode::File ? "file" : args.sync == SyncMode::Batch ? "batch" : "none";
+    out["cacheDir"] = args.cacheDir;
+    out["cacheMaxBytes"] = args.cacheMaxBytes;
+    out["stats"] = args.stats || !args.statsJsonPath.empty();
+    return out;
+}
+
+CliArgs argsFromJson(const json& in) {
+    CliArgs args;
+    args.inputPaths = in.value("inputs", std::vector<std::string>());
+    args.outputPath = in.value("output", std::string());
+    args.outputDir = in.value("outputDir", std::string());
+    args.useDb = !in.contains("gainsLinear");
+    if (args.useDb) {
+        args.gainDbs = in.value("gainsDb", std::vector<float>());
+    } else {
+        args.gainLinears = in.at("gainsLinear").get<std::vector<float>>();
+    }
+    args.gainSweep = args.useDb && in.value("gainSweep", false);
+    args.hasTargetLufs = in.contains("targetLufs");
+    if (args.hasTargetLufs) args.targetLufs = in.at("targetLufs").get<float>();
+    args.matchToPath = in.value("matchTo", std::string());
+    args.jobs = std::min(in.value("jobs", size_t(1)), kMaxDaemonJobs);
+    args.surgical = in.value("surgical", false);
+    if (!NamWriter::tryParseFormat(in.value("format", std::string("pretty")), args.format)) {
+        throw std::invalid_argument("format must be \"compact\" or \"pretty\"");
+    }
+    const std::string container = in.value("container", std::string("auto"));
+    if (container != "auto" && container != "json" && container != "binary") {
+        throw std::invalid_argument("container must be \"auto\", \"json\" or \"binary\"");
+    }
+    args.container = container == "binary" ? NamContainer::Binary : container == "json" ? NamContainer::Json : NamContainer::Auto;
+    args.convertOnly = in.value("convertOnly", false);
+    if (!OutputWriter::tryParseSyncMode(in.value("sync", std::string("none")), args.sync)) {
+        throw std::invalid_argument("sync must be \"none\", \"file\" or \"batch\"");
+    }
+    args.cacheDir = in.value("cacheDir", std::string());
+    args.cacheMaxBytes = in.value("cacheMaxBytes", ResultCache::kDefaultMaxBytes);
+    args.stats = in.value("stats", false);
+    return args;
+}
+
+} // namespace DaemonProtocol
+
+static bool parseCount(const std::string& raw, size_t maxValue, size_t& out) {
+    if (raw.empty() || raw.size() > 9 || !std::all_of(raw.begin(), raw.end(), [](unsigned char c) { return std::isdigit(c); })) {
+        return false;
+    }
+    out = static_cast<size_t>(std::stoul(raw));
+    return out <= maxValue;
+}
+
+std::string DaemonServer::usage() {
+    return "Usage: nam-volume-knob serve --socket <path> [--jobs <N>] [--max-models <N>]";
+}
+
+bool DaemonServer::tryParseArgs(int argc, char* argv[], DaemonOptions& options, std::string& error) {
+    for (int i = 2; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg != "--socket" && arg != "--jobs" && arg != "--max-models") {
+            error = "Error: Unknown option: " + arg + "\n" + usage();
+            return false;
+        }
+        if (i + 1 >= argc) {
+            error = "Error: Missing value for " + arg + ".\n" + usage();
+            return false;
+        }
+        const std::string raw = argv[++i];
+        if (arg == "--socket") {
+            options.socketPath = raw;
+        } else if (arg == "--jobs") {
+            if (!parseCount(raw, kMaxDaemonJobs, options.jobs)) {
+                error = "Error: Invalid value for --jobs: expected an integer from 0 to "
+                    + std::to_string(kMaxDaemonJobs) + ", got " + raw + "\n" + usage();
+                return false;
+            }
+        } else if (!parseCount(raw, kMaxModels, options.maxModels) || options.maxModels == 0) {
+            error = "Error: Invalid value for --max-models: expected an integer from 1 to "
+                + std::to_string(kMaxModels) + ", got " + raw + "\n" + usage();
+            return false;
+        }
+    }
+    if (options.socketPath.empty()) {
+        error = "Error: --socket is required.\n" + usage();
+        return false;
+    }
+    return true;
+}
+
+DaemonServer::DaemonServer(DaemonOptions options) : options_(std::move(options)), models_(options_.maxModels) {}
+
+static bool isAbsolutePath(const std::string& path) {
+    return path.empty() || std::filesystem::path(path).is_absolute();
+}
+
+#if defined(NAM_DAEMON_HAVE_SOCKETS)
+
+static json errorReply(int exitCode, const std::string& error) {
+    json reply;
+    reply["exitCode"] = exitCode;
+    reply["error"] = error;
+    return reply;
+}
+
+// Parses and validates a render payload, or takes it from models.
+static std::shared_ptr<const NamModel> loadModelBytes(std::string_view bytes, ModelCache& models, CliRenderResult& result) {
+    const std::string key = ModelCache::bytesKey(bytes);
+    if (auto cached = models.find(key)) return cached;
+    auto model = std::make_shared<NamModel>();
+    std::string err;
+    if (!NamParser::tryParseNamModel(bytes, *model, err)) {
+        result.exitCode = 1;
+        result.error = "Error: JSON parsing failed: " + err;
+        return nullptr;
+    }
+    if (!Validator::validateNam(*model, err)) {
+        result.exitCode = 3;
+        result.error = "Error: Invalid .nam file format (missing required fields or corrupted)";
+        if (!err.empty()) result.error += ": " + err;
+        return nullptr;
+    }
+    std::shared_ptr<const NamModel> shared = std::move(model);
+    models.insert(key, shared);
+    return shared;
+}
+
+#if defined(MSG_NOSIGNAL)
+static constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+static constexpr int kSendFlags = 0;  // callers ignore SIGPIPE instead
+#endif
+
+static bool readExact(int fd, char* data, size_t size) {
+    while (size > 0) {
+        const ssize_t n = ::recv(fd, data, size, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+static bool writeExact(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        const ssize_t n = ::send(fd, data, size, kSendFlags);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Returns false at end of stream, on a read error or if the frame is larger than maxSize.
+static bool readFrame(int fd, std::string& frame, size_t maxSize) {
+    unsigned char prefix[4];
+    if (!readExact(fd, reinterpret_cast<char*>(prefix), sizeof(prefix))) return false;
+    const uint32_t size = uint32_t(prefix[0]) | (uint32_t(prefix[1]) << 8) | (uint32_t(prefix[2]) << 16)
+        | (uint32_t(prefix[3]) << 24);
+    if (size > maxSize) return false;
+    frame.resize(size);
+    return readExact(fd, frame.data(), frame.size());
+}
+
+static bool writeFrame(int fd, std::string_view frame) {
+    if (frame.size() > UINT32_MAX) return false;
+    const auto size = static_cast<uint32_t>(frame.size());
+    const unsigned char prefix[4] = {static_cast<unsigned char>(size), static_cast<unsigned char>(size >> 8),
+                                     static_cast<unsigned char>(size >> 16), static_cast<unsigned char>(size >> 24)};
+    return writeExact(fd, reinterpret_cast<const char*>(prefix), sizeof(prefix)) && writeExact(fd, frame.data(), frame.size());
+}
+
+static void setCloseOnExec(int fd) {
+    const int flags = ::fcntl(fd, F_GETFD);
+    if (flags >= 0) ::fcntl(fd, F_SETFD, flags | FD_CLOEXEC);
+}
+
+static bool fillAddress(const std::string& path, sockaddr_un& address, std::string& error) {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        error = "Error: Socket path is too long: " + path;
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+static int connectTo(const std::string& path, std::string& error) {
+    sockaddr_un address;
+    if (!fillAddress(path, address, error)) return -1;
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        error = "Error: Cannot create socket: " + std::string(std::strerror(errno));
+        return -1;
+    }
+    setCloseOnExec(fd);
+    while (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        if (errno == EINTR) continue;
+        error = "Error: Cannot connect to server at " + path + ": " + std::strerror(errno);
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+DaemonServer::~DaemonServer() {
+    if (listenFd_ >= 0) ::close(listenFd_);
+    if (bound_) ::unlink(options_.socketPath.c_str());
+    for (int fd : wakeFds_) {
+        if (fd >= 0) ::close(fd);
+    }
+}
+
+bool DaemonServer::tryStart(std::string& error) {
+    sockaddr_un address;
+    if (!fillAddress(options_.socketPath, address, error)) return false;
+    if (::pipe(wakeFds_) != 0) {
+        error = "Error: Cannot create pipe: " + std::string(std::strerror(errno));
+        return false;
+    }
+    setCloseOnExec(wakeFds_[0]);
+    setCloseOnExec(wakeFds_[1]);
+    ::fcntl(wakeFds_[1], F_SETFL, ::fcntl(wakeFds_[1], F_GETFL) | O_NONBLOCK);
+
+    listenFd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd_ < 0) {
+        error = "Error: Cannot create socket: " + std::string(std::strerror(errno));
+        return false;
+    }
+    setCloseOnExec(listenFd_);
+    const auto* addr = reinterpret_cast<const sockaddr*>(&address);
+    if (::bind(listenFd_, addr, sizeof(address)) != 0) {
+        struct stat st;
+        std::string ignored;
+        if (errno != EADDRINUSE || ::lstat(options_.socketPath.c_str(), &st) != 0 || !S_ISSOCK(st.st_mode)) {
+            error = "Error: Cannot bind socket " + options_.socketPath + ": " + std::strerror(errno);
+            return false;
+        }
+        const int probe = connectTo(options_.socketPath, ignored);
+        if (probe >= 0) {
+            ::close(probe);
+            error = "Error: A server is already listening on " + options_.socketPath;
+            return false;
+        }
+        // Left behind by a daemon that did not exit cleanly.
+        ::unlink(options_.socketPath.c_str());
+        if (::bind(listenFd_, addr, sizeof(address)) != 0) {
+            error = "Error: Cannot bind socket " + options_.socketPath + ": " + std::strerror(errno);
+            return false;
+        }
+    }
+    bound_ = true;
+    if (::chmod(options_.socketPath.c_str(), S_IRUSR | S_IWUSR) != 0 || ::listen(listenFd_, SOMAXCONN) != 0) {
+        error = "Error: Cannot listen on socket " + options_.socketPath + ": " + std::strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+void DaemonServer::stop() {
+    stopRequested_ = true;
+    if (wakeFds_[1] >= 0) {
+        const char byte = 1;
+        [[maybe_unused]] const ssize_t n = ::write(wakeFds_[1], &byte, 1);
+    }
+}
+
+struct DaemonServer::Connection {
+    int fd = -1;
+    std::string buffer;  // received bytes not yet handed to the pool
+    json request;        // header of a render request whose payload is still arriving
+    size_t headerBytes = 0;
+    bool busy = false;  // a request from it is being answered
+};
+
+enum class FrameState { Complete, Incomplete, Invalid };
+
+static FrameState peekFrame(std::string_view bytes, size_t maxSize, std::string_view& frame) {
+    if (bytes.size() < 4) return FrameState::Incomplete;
+    const auto* prefix = reinterpret_cast<const unsigned char*>(bytes.data());
+    const uint32_t size = uint32_t(prefix[0]) | (uint32_t(prefix[1]) << 8) | (uint32_t(prefix[2]) << 16)
+        | (uint32_t(prefix[3]) << 24);
+    if (size > maxSize) return FrameState::Invalid;
+    if (bytes.size() - 4 < size) return FrameState::Incomplete;
+    frame = bytes.substr(4, size);
+    return FrameState::Complete;
+}
+
+static std::string requestOp(const json& request) {
+    return request.is_object() && request.contains("op") && request["op"].is_string() ? request["op"].get<std::string>()
+                                                                                       : std::string();
+}
+
+void DaemonServer::run() {
+    const size_t workers = options_.jobs == 0 ? ThreadPool::hardwareThreads() : options_.jobs;
+    std::unordered_map<int, Connection> connections;
+    auto closeConnection = [&connections](int fd) {
+        ::close(fd);
+        connections.erase(fd);
+    };
+    {
+        ThreadPool pool(workers);
+        std::vector<pollfd> fds;
+        std::vector<std::pair<int, bool>> finished;
+        char chunk[1 << 16];
+        while (!stopRequested_) {
+            fds.assign({{listenFd_, POLLIN, 0}, {wakeFds_[0], POLLIN, 0}});
+            for (const auto& [fd, connection] : connections) {
+                if (!connection.busy) fds.push_back({fd, POLLIN, 0});
+            }
+            if (::poll(fds.data(), fds.size(), -1) < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            if (fds[1].revents != 0) {
+                [[maybe_unused]] const ssize_t n = ::read(wakeFds_[0], chunk, sizeof(chunk));
+                if (stopRequested_) break;
+                {
+                    std::lock_guard<std::mutex> lock(finishedMutex_);
+                    finished.swap(finished_);
+                }
+                for (const auto& [fd, keepOpen] : finished) {
+                    Connection& connection = connections.at(fd);
+                    connection.busy = false;
+                    // A request that arrived behind the answered one goes out right away.
+                    if (!keepOpen || !dispatchNext(connection, pool)) closeConnection(fd);
+                }
+                finished.clear();
+            }
+            for (size_t i = 2; i < fds.size(); ++i) {
+                if (fds[i].revents == 0) continue;
+                const int fd = fds[i].fd;
+                Connection& connection = connections.at(fd);
+                const ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) {
+                    closeConnection(fd);  // end of stream, also in the middle of a request
+                    continue;
+                }
+                connection.buffer.append(chunk, static_cast<size_t>(n));
+                if (!dispatchNext(connection, pool)) closeConnection(fd);
+            }
+            if ((fds[0].revents & POLLIN) != 0) {
+                const int fd = ::accept(listenFd_, nullptr, nullptr);
+                if (fd >= 0) {
+                    setCloseOnExec(fd);
+                    // A client that stops reading its reply cannot hold a worker for long.
+                    const timeval timeout{kSendTimeoutSeconds, 0};
+                    ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+                    connections[fd].fd = fd;
+                }
+            }
+        }
+
+        // Idle connections are closed; requests in progress still get their reply.
+        for (auto it = connections.begin(); it != connections.end();) {
+            if (it->second.busy) {
+                ++it;
+            } else {
+                ::close(it->first);
+                it = connections.erase(it);
+            }
+        }
+    }
+    for (const auto& entry : connections) ::close(entry.first);
+    ::close(listenFd_);
+    listenFd_ = -1;
+    ::unlink(options_.socketPath.c_str());
+    bound_ = false;
+}
+
+// Hands the next complete request in connection's buffer to the pool, if there is one.
+// Returns false if the client sent an oversized frame and must be dropped.
+bool DaemonServer::dispatchNext(Connection& connection, ThreadPool& pool) {
+    std::string_view bytes(connection.buffer);
+    if (connection.headerBytes == 0) {
+        std::string_view header;
+        const FrameState state = peekFrame(bytes, DaemonProtocol::kMaxHeaderBytes, header);
+        if (state != FrameState::Complete) return state == FrameState::Incomplete;
+        connection.request = json::parse(header, nullptr, false);
+        connection.headerBytes = 4 + header.size();
+    }
+    size_t used = connection.headerBytes;
+    std::string_view payload;
+    if (requestOp(connection.request) == "render") {
+        const FrameState state = peekFrame(bytes.substr(used), DaemonProtocol::kMaxPayloadBytes, payload);
+        if (state != FrameState::Complete) return state == FrameState::Incomplete;
+        used += 4 + payload.size();
+    }
+
+    // The task takes the buffer (payloads can be large); bytes past the request stay here.
+    auto received = std::make_shared<std::string>(std::move(connection.buffer));
+    connection.buffer.assign(*received, used, std::string::npos);
+    const size_t payloadOffset = payload.empty() ? 0 : static_cast<size_t>(payload.data() - received->data());
+    const size_t payloadSize = payload.size();
+    auto request = std::make_shared<json>(std::move(connection.request));
+    connection.request = json();
+    connection.headerBytes = 0;
+    connection.busy = true;
+
+    pool.submit([this, &pool, fd = connection.fd, received, payloadOffset, payloadSize, request] {
+        bool keepOpen = true;
+        const std::string_view payloadBytes(received->data() + payloadOffset, payloadSize);
+        const bool answered = handleRequest(fd, *request, payloadBytes, pool, keepOpen);
+        finishRequest(fd, answered && keepOpen);
+    });
+    return true;
+}
+
+// Gives the connection back to the thread in run().
+void DaemonServer::finishRequest(int fd, bool keepOpen) {
+    {
+        std::lock_guard<std::mutex> lock(finishedMutex_);
+        finished_.emplace_back(fd, keepOpen);
+    }
+    const char byte = 0;
+    [[maybe_unused]] const ssize_t n = ::write(wakeFds_[1], &byte, 1);
+}
+
+// Answers one request. Returns false if the connection broke.
+bool DaemonServer::handleRequest(int fd, const json& request, std::string_view payload, ThreadPool& pool,
+                                 bool& keepOpen) {
+    ++requests_;
+    const std::string op = requestOp(request);
+
+    json reply;
+    std::vector<std::string> outputs;
+    try {
+        if (op == "run" || op == "render") {
+            CliArgs args = DaemonProtocol::argsFromJson(request.at("args"));
+            if (op == "run") {
+                std::string error;
+                const auto paths = {&args.outputPath, &args.outputDir, &args.cacheDir, &args.matchToPath};
+                const bool absolute = std::all_of(args.inputPaths.begin(), args.inputPaths.end(), isAbsolutePath)
+                    && std::all_of(paths.begin(), paths.end(), [](const std::string* p) { return isAbsolutePath(*p); });
+                if (!absolute) {
+                    reply = errorReply(2, "Error: Paths sent to the server must be absolute.");
+                } else if (!CliHandler::validateArgs(args, error)) {
+                    reply = errorReply(2, error);
+                } else {
+                    CliRunResult result = CliHandler::run(args, &models_, &pool);
+                    reply = errorReply(result.exitCode, result.error);
+                    reply["outputPaths"] = result.outputPaths;
+                    reply["cache"] = {{"hits", result.cache.hits}, {"misses", result.cache.misses},
+                                      {"evicted", result.cache.evicted}};
+                    if (result.stats.collected) reply["stats"] = result.stats.toJson();
+                    reply["loudness"] = json::array();
+                    for (const auto& loudness : result.loudness) {
+                        reply["loudness"].push_back({{"lufs", loudness.measuredLufs}, {"gainDb", loudness.gainDb}});
+                    }
+                }
+            } else {
+                CliRenderResult result;
+                if (auto model = loadModelBytes(payload, models_, result)) result = CliHandler::renderModel(model, args);
+                reply = errorReply(result.exitCode, result.error);
+                reply["outputs"] = result.outputs.size();
+                outputs = std::move(result.outputs);
+            }
+        } else if (op == "status") {
+            const CacheStats stats = models_.stats();
+            reply = errorReply(0, std::string());
+            reply["models"] = models_.size();
+            reply["hits"] = stats.hits;
+            reply["misses"] = stats.misses;
+            reply["evicted"] = stats.evicted;
+            reply["requests"] = requests_.load();
+        } else if (op == "shutdown") {
+            reply = errorReply(0, std::string());
+            keepOpen = false;
+            stop();
+        } else {
+            reply = errorReply(2, "Error: Unknown request: " + (op.empty() ? std::string("(no op)") : op));
+        }
+    } catch (const std::exception& e) {
+        reply = errorReply(2, std::string("Error: Invalid request: ") + e.what());
+        outputs.clear();
+    }
+
+    if (!writeFrame(fd, reply.dump())) return false;
+    for (const auto& output : outputs) {
+        if (!writeFrame(fd, output)) return false;
+    }
+    return true;
+}
+
+bool DaemonClient::tryCall(const std::string& socketPath, const json& request, const std::string_view* payload,
+                           json& reply, std::vector<std::string>& outputs, std::string& error, bool* connected) {
+    if (connected != nullptr) *connected = false;
+    const int fd = connectTo(socketPath, error);
+    if (fd < 0) return false;
+    if (connected != nullptr) *connected = true;
+
+    std::string frame;
+    bool ok = writeFrame(fd, request.dump()) && (payload == nullptr || writeFrame(fd, *payload))
+        && readFrame(fd, frame, DaemonProtocol::kMaxHeaderBytes);
+    if (ok) {
+        reply = json::parse(frame, nullptr, false);
+        ok = reply.is_object() && reply.contains("exitCode") && reply["exitCode"].is_number_integer();
+    }
+    outputs.clear();
+    if (ok) {
+        const size_t count = reply.value("outputs", size_t(0));
+        outputs.resize(count);
+        for (size_t i = 0; ok && i < count; ++i) ok = readFrame(fd, outputs[i], DaemonProtocol::kMaxPayloadBytes);
+    }
+    ::close(fd);
+    if (!ok) error = "Error: Lost connection to server at " + socketPath;
+    return ok;
+}
+
+#else
+
+DaemonServer::~DaemonServer() = default;
+
+bool DaemonServer::tryStart(std::string& error) {
+    error = "Error: serve is not supported on this platform.";
+    return false;
+}
+
+void DaemonServer::stop() {
+    stopRequested_ = true;
+}
+
+void DaemonServer::run() {}
+
+bool DaemonClient::tryCall(const std::string&, const json&, const std::string_view*, json&, std::vector<std::string>&,
+                           std::string& error, bool* connected) {
+    if (connected != nullptr) *connected = false;
+    error = "Error: --server is not supported on this platform.";
+    return false;
+}
+
+#endif
+
+bool DaemonClient::tryRun(const std::string& socketPath, const CliArgs& args, CliRunResult& result, std::string& error,
+                          bool* connected) {
+    // Relative paths become prefix + path, so everything the daemon derives from them can be
+    // turned back into what a local run would report by dropping the prefix again.
+    std::string prefix;
+    try {
+        prefix = std::filesystem::current_path().string();
+    } catch (const std::exception& e) {
+        if (connected != nullptr) *connected = false;
+        error = std::string("Error: ") + e.what();
+        return false;
+    }
+    if (prefix.empty() || prefix.back() != '/') prefix += '/';
+    std::vector<std::string> relative;
+    auto absolute = [&](const std::string& path) {
+        if (isAbsolutePath(path)) return path;
+        relative.push_back(path);
+        return prefix + path;
+    };
+    CliArgs sent = args;
+    sent.server.clear();
+    for (auto& input : sent.inputPaths) input = absolute(input);
+    sent.outputPath = absolute(sent.outputPath);
+    sent.outputDir = absolute(sent.outputDir);
+    sent.cacheDir = absolute(sent.cacheDir);
+    sent.matchToPath = absolute(sent.matchToPath);
+
+    json request;
+    request["op"] = "run";
+    request["args"] = DaemonProtocol::argsToJson(sent);
+    json reply;
+    std::vector<std::string> outputs;
+    if (!tryCall(socketPath, request, nullptr, reply, outputs, error, connected)) return false;
+
+    auto localize = [&](std::string text) {
+        for (const auto& path : relative) {
+            const std::string resolved = prefix + path;
+            for (size_t at = text.find(resolved); at != std::string::npos; at = text.find(resolved, at + path.size())) {
+                text.erase(at, prefix.size());
+            }
+        }
+        return text;
+    };
+    const size_t gainCount = std::max<size_t>((args.useDb ? args.gainDbs : args.gainLinears).size(), 1);
+    try {
+        result.exitCode = reply["exitCode"].get<int>();
+        result.error = localize(reply.value("error", std::string()));
+        result.outputPaths.clear();
+        const auto paths = reply.value("outputPaths", std::vector<std::string>());
+        for (size_t i = 0; i < paths.size(); ++i) {
+            const std::string& base = !args.outputPath.empty() ? args.outputPath
+                : !args.outputDir.empty() ? args.outputDir : args.inputPaths[std::min(i / gainCount, args.inputPaths.size() - 1)];
+            const bool strip = !isAbsolutePath(base) && paths[i].compare(0, prefix.size(), prefix) == 0;
+            result.outputPaths.push_back(strip ? paths[i].substr(prefix.size()) : paths[i]);
+        }
+        const json cache = reply.value("cache", json::object());
+        result.cache.hits = cache.value("hits", size_t(0));
+        result.cache.misses = cache.value("misses", size_t(0));
+        result.cache.evicted = cache.value("evicted", size_t(0));
+        // One entry per input, in order.
+        const json loudness = reply.value("loudness", json::array());
+        result.loudness.clear();
+        for (size_t i = 0; i < loudness.size() && i < args.inputPaths.size(); ++i) {
+            LoudnessGain gain;
+            gain.inputPath = args.inputPaths[i];
+            gain.measuredLufs = loudness[i].at("lufs").get<double>();
+            gain.gainDb = loudness[i].at("gainDb").get<float>();
+            result.loudness.push_back(std::move(gain));
+        }
+        if (reply.contains("stats")) {
+            result.stats = RunStats::fromJson(reply["stats"]);
+            for (size_t i = 0; i < result.stats.files.size() && i < args.inputPaths.size(); ++i) {
+                result.stats.files[i].inputPath = args.inputPaths[i];
+            }
+        }
+    } catch (const std::exception& e) {
+        error = "Error: Invalid reply from server at " + socketPath + ": " + e.what();
+        return false;
+    }
+    return true;
+}
+
+bool DaemonClient::tryRender(const std::string& socketPath, std::string_view namBytes, const CliArgs& args,
+                             CliRenderResult& result, std::string& error) {
+    json request;
+    request["op"] = "render";
+    request["args"] = DaemonProtocol::argsToJson(args);
+    json reply;
+    if (!tryCall(socketPath, request, &namBytes, reply, result.outputs, error)) return false;
+    try {
+        result.exitCode = reply["exitCode"].get<int>();
+        result.error = reply.value("error", std::string());
+    } catch (const std::exception& e) {
+        error = "Error: Invalid reply from server at " + socketPath + ": " + e.what();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,172 @@
+#include "loudness.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <sstream>
+
+static constexpr double kPi = 3.14159265358979323846;
+
+static double blockLoudness(double power) {
+    return -0.691 + 10.0 * std::log10(power);
+}
+
+// K-weighting as two biquads (high shelf, then high pass), from the analog prototype of
+// BS.1770 so any sample rate gets the same response as the published 48 kHz coefficients.
+LoudnessMeter::LoudnessMeter(double sampleRate)
+    : hopSize_(static_cast<size_t>(std::lround(sampleRate * 0.1))) {
+    if (hopSize_ == 0) hopSize_ = 1;
+    {
+        const double f0 = 1681.974450955533;
+        const double gainDb = 3.999843853973347;
+        const double q = 0.7071752369554196;
+        const double k = std::tan(kPi * f0 / sampleRate);
+        const double vh = std::pow(10.0, gainDb / 20.0);
+        const double vb = std::pow(vh, 0.4996667741545416);
+        const double a0 = 1.0 + k / q + k * k;
+        shelf_.b0 = (vh + vb * k / q + k * k) / a0;
+        shelf_.b1 = 2.0 * (k * k - vh) / a0;
+        shelf_.b2 = (vh - vb * k / q + k * k) / a0;
+        shelf_.a1 = 2.0 * (k * k - 1.0) / a0;
+        shelf_.a2 = (1.0 - k / q + k * k) / a0;
+    }
+    {
+        const double f0 = 38.13547087602444;
+        const double q = 0.5003270373238773;
+        const double k = std::tan(kPi * f0 / sampleRate);
+        const double a0 = 1.0 + k / q + k * k;
+        highPass_.b0 = 1.0;
+        highPass_.b1 = -2.0;
+        highPass_.b2 = 1.0;
+        highPass_.a1 = 2.0 * (k * k - 1.0) / a0;
+        highPass_.a2 = (1.0 - k / q + k * k) / a0;
+    }
+}
+
+void LoudnessMeter::push(const double* samples, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        const double x = samples[i];
+        peak_ = std::max(peak_, std::fabs(x));
+        sumSquares_ += x * x;
+        hopSquares_ += x * x;
+
+        const double weighted = highPass_.process(shelf_.process(x));
+        hopSum_ += weighted * weighted;
+        if (++hopFill_ < hopSize_) continue;
+
+        recentHops_[hopCount_ % 4] = hopSum_;
+        ++hopCount_;
+        envelope_.push_back(static_cast<float>(std::sqrt(hopSquares_ / static_cast<double>(hopSize_))));
+        hopSum_ = 0.0;
+        hopSquares_ = 0.0;
+        hopFill_ = 0;
+        if (hopCount_ >= 4) {
+            const double sum = recentHops_[0] + recentHops_[1] + recentHops_[2] + recentHops_[3];
+            blockPowers_.push_back(sum / static_cast<double>(4 * hopSize_));
+        }
+    }
+    sampleCount_ += count;
+}
+
+AudioLevels LoudnessMeter::levels() const {
+    AudioLevels levels;
+    levels.peak = peak_;
+    levels.rms = sampleCount_ == 0 ? 0.0 : std::sqrt(sumSquares_ / static_cast<double>(sampleCount_));
+    levels.lufs = -std::numeric_limits<double>::infinity();
+    levels.envelope = envelope_;
+
+    // Mean power of the blocks louder than threshold.
+    auto gatedPower = [this](double threshold, size_t& count) {
+        double sum = 0.0;
+        count = 0;
+        for (double power : blockPowers_) {
+            if (power > 0.0 && blockLoudness(power) > threshold) {
+                sum += power;
+                ++count;
+            }
+        }
+        return count == 0 ? 0.0 : sum / static_cast<double>(count);
+    };
+
+    size_t count = 0;
+    const double absolute = gatedPower(-70.0, count);
+    if (count == 0) return levels;
+    const double relativeGate = std::max(blockLoudness(absolute) - 10.0, -70.0);
+    const double gated = gatedPower(relativeGate, count);
+    if (count != 0) levels.lufs = blockLoudness(gated);
+    return levels;
+}
+
+std::string StimulusSpec::id() const {
+    std::ostringstream oss;
+    oss << (kind == Kind::Noise ? "noise" : "multitone") << ':' << levelDb << ':' << seconds;
+    return oss.str();
+}
+
+std::vector<double> TestSignal::standard(double sampleRate, double seconds) {
+    StimulusSpec spec;
+    spec.seconds = seconds;
+    return generate(spec, sampleRate);
+}
+
+std::vector<double> TestSignal::generate(const StimulusSpec& spec, double sampleRate) {
+    static constexpr double kFrequencies[] = {110.0, 220.0, 440.0, 880.0, 1760.0, 3520.0};
+    static constexpr size_t kTones = sizeof(kFrequencies) / sizeof(kFrequencies[0]);
+    const double rms = std::pow(10.0, spec.levelDb / 20.0);
+
+    std::vector<double> samples(static_cast<size_t>(std::lround(sampleRate * spec.seconds)));
+    if (spec.kind == StimulusSpec::Kind::Noise) {
+        // Uniform in [-a, a] has RMS a / sqrt(3). mt19937's output is fixed by the standard,
+        // unlike the distributions, so the noise is the same on every platform.
+        std::mt19937 rng(0x4e414d31u);
+        const double amplitude = rms * std::sqrt(3.0);
+        for (double& sample : samples) {
+            sample = amplitude * (static_cast<double>(rng()) / 2147483647.5 - 1.0);
+        }
+        return samples;
+    }
+
+    // Each tone contributes amplitude^2 / 2 of power.
+    const double amplitude = rms * std::sqrt(2.0 / static_cast<double>(kTones));
+    for (size_t i = 0; i < samples.size(); ++i) {
+        const double t = static_cast<double>(i) / sampleRate;
+        double sum = 0.0;
+        for (size_t k = 0; k < kTones; ++k) {
+            // Schroeder phases keep the crest factor low.
+            const double phase = -kPi * static_cast<double>(k * (k + 1)) / static_cast<double>(kTones);
+            sum += std::sin(2.0 * kPi * kFrequencies[k] * t + phase);
+        }
+        samples[i] = amplitude * sum;
+    }
+    return samples;
+}
+
+bool TestSignal::tryParse(const std::string& text, StimulusSpec& spec, std::string& error) {
+    std::vector<std::string> parts;
+    size_t start = 0;
+    for (size_t colon; (colon = text.find(':', start)) != std::string::npos; start = colon + 1) {
+        parts.push_back(text.substr(start, colon - start));
+    }
+    parts.push_back(text.substr(start));
+
+    StimulusSpec parsed;
+    if (parts[0] == "noise") {
+        parsed.kind = StimulusSpec::Kind::Noise;
+    } else if (parts[0] != "multitone") {
+        error = "Stimulus must be \"multitone\" or \"noise\", optionally followed by :<dBFS>[:<seconds>]. Got: " + text;
+        return false;
+    }
+    auto number = [](const std::string& raw, double& out) {
+        char* end = nullptr;
+        out = std::strtod(raw.c_str(), &end);
+        return !raw.empty() && end == raw.c_str() + raw.size() && std::isfinite(out);
+    };
+    if (parts.size() > 3 || (parts.size() > 1 && (!number(parts[1], parsed.levelDb) || parsed.levelDb > 0.0))
+        || (parts.size() > 2 && (!number(parts[2], parsed.seconds) || parsed.seconds < 0.5 || parsed.seconds > 600.0))) {
+        error = "Invalid stimulus " + text + ": the level must be <= 0 dBFS and the length from 0.5 to 600 seconds.";
+        return false;
+    }
+    spec = parsed;
+    return true;
+}
@@ -1,7 +1,160 @@
 #include "cli.h"
+#include "daemon.h"
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <new>
+#include "run_stats.h"
+#include "verifier.h"
+#include "watcher.h"
+
+// Counted so --stats can report the allocations of each stage.
+void* operator new(std::size_t size) {
+    Stats::noteAllocation();
+    if (void* p = std::malloc(size == 0 ? 1 : size)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+static DaemonServer* g_server = nullptr;
+
+extern "C" void stopServer(int) {
+    if (g_server != nullptr) g_server->stop();
+}
+
+static int serve(int argc, char* argv[]) {
+    DaemonOptions options;
+    std::string error;
+    if (argc == 3 && (std::strcmp(argv[2], "--help") == 0 || std::strcmp(argv[2], "-h") == 0)) {
+        std::cout << DaemonServer::usage() << std::endl;
+        return 0;
+    }
+    if (!DaemonServer::tryParseArgs(argc, argv, options, error)) {
+        std::cerr << error << std::endl;
+        return 2;
+    }
+
+    DaemonServer server(options);
+    if (!server.tryStart(error)) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    g_server = &server;
+    std::signal(SIGINT, stopServer);
+    std::signal(SIGTERM, stopServer);
+#ifdef SIGPIPE
+    std::signal(SIGPIPE, SIG_IGN);
+#endif
+    std::cout << "Listening on " << options.socketPath << std::endl;
+    server.run();
+    g_server = nullptr;
+    return 0;
+}
+
+static int verify(int argc, char* argv[]) {
+    VerifyOptions options;
+    std::string error;
+    if (!Verifier::tryParseArgs(argc, argv, options, error)) {
+        std::cerr << error << std::endl;
+        return 2;
+    }
+    if (options.showHelp) {
+        std::cout << Verifier::usage() << std::endl;
+        return 0;
+    }
+    const VerifyResult result = Verifier::run(options);
+    if (!result.warning.empty()) std::cerr << result.warning << std::endl;
+    if (!result.error.empty()) {
+        std::cerr << result.error << std::endl;
+        return result.exitCode;
+    }
+    std::cout << Verifier::report(options, result) << std::flush;
+    return result.exitCode;
+}
+
+static FolderWatcher* g_watcher = nullptr;
+
+extern "C" void stopWatcher(int) {
+    if (g_watcher != nullptr) g_watcher->stop();
+}
+
+static int watch(int argc, char* argv[]) {
+    WatchOptions options;
+    std::string error;
+    if (!FolderWatcher::tryParseArgs(argc, argv, options, error)) {
+        std::cerr << error << std::endl;
+        return 2;
+    }
+    if (options.showHelp) {
+        std::cout << FolderWatcher::usage() << std::endl;
+        return 0;
+    }
+
+    FolderWatcher watcher(options);
+    if (!watcher.tryStart(error)) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    g_watcher = &watcher;
+    std::signal(SIGINT, stopWatcher);
+    std::signal(SIGTERM, stopWatcher);
+    if (!options.once) std::cout << "Watching " << options.inputDir << std::endl;
+
+    bool failed = false;
+    const bool ok = watcher.run([&failed](const WatchedFile& file) {
+        if (file.exitCode != 0) {
+            failed = true;
+            std::cerr << file.inputPath << ": " << file.error << std::endl;
+            return;
+        }
+        std::cout << file.inputPath << ": wrote " << file.outputPaths.size() << " file(s)." << std::endl;
+        if (!file.warning.empty()) {
+            failed = true;
+            std::cerr << file.inputPath << ": " << file.warning << std::endl;
+        }
+    }, error);
+    g_watcher = nullptr;
+    if (!ok) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    // A watcher keeps going past failed files; --once reports them in its status.
+    return options.once && failed ? 1 : 0;
+}
+
+// --stats goes to stderr so stdout keeps its usual lines; --stats-json to its file or stdout.
+static bool emitStats(const CliArgs& args, const RunStats& stats) {
+    if (!stats.collected) return true;
+    if (args.stats) std::cerr << stats.summary();
+    if (args.statsJsonPath.empty()) return true;
+    if (args.statsJsonPath == "-") {
+        std::cout << stats.jsonLines() << std::flush;
+        return true;
+    }
+    std::ofstream out(args.statsJsonPath, std::ios::binary);
+    out << stats.jsonLines();
+    if (!out) {
+        std::cerr << "Error: Cannot write stats to " << args.statsJsonPath << std::endl;
+        return false;
+    }
+    return true;
+}
 
 int main(int argc, char* argv[]) {
+    if (argc >= 2 && std::strcmp(argv[1], "serve") == 0) {
+        return serve(argc, argv);
+    }
+    if (argc >= 2 && std::strcmp(argv[1], "verify") == 0) {
+        return verify(argc, argv);
+    }
+    if (argc >= 2 && std::strcmp(argv[1], "watch") == 0) {
+        return watch(argc, argv);
+    }
+
     auto parsed = CliHandler::parseArgs(argc, argv);
     if (!parsed.ok) {
         std::cerr << parsed.error << std::endl;
@@ -13,12 +166,38 @@ int main(int argc, char* argv[]) {
         return 0;
     }
 
-    auto runResult = CliHandler::run(parsed.args);
+    // --server, or NAM_VOLUME_KNOB_SERVER for existing scripts; only the latter falls back to a
+    // local run when no daemon is listening.
+    std::string server = parsed.args.server;
+    const char* serverEnv = std::getenv("NAM_VOLUME_KNOB_SERVER");
+    const bool fromEnv = server.empty() && serverEnv != nullptr && *serverEnv != '\0';
+    if (fromEnv) server = serverEnv;
+
+    CliRunResult runResult;
+    bool handled = false;
+    if (!server.empty()) {
+        std::string error;
+        bool connected = false;
+        handled = DaemonClient::tryRun(server, parsed.args, runResult, error, &connected);
+        if (!handled && (connected || !fromEnv)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+    }
+    if (!handled) runResult = CliHandler::run(parsed.args);
+
     if (runResult.exitCode != 0) {
         std::cerr << runResult.error << std::endl;
+        emitStats(parsed.args, runResult.stats);
         return runResult.exitCode;
     }
 
+    for (const auto& loudness : runResult.loudness) {
+        std::cout << "Loudness: " << loudness.inputPath << ": " << std::fixed << std::setprecision(2)
+                  << loudness.measuredLufs << " LUFS, gain " << std::showpos << loudness.gainDb << std::noshowpos
+                  << " dB" << std::defaultfloat << std::endl;
+    }
+
     if (!runResult.outputPaths.empty()) {
         if (runResult.outputPaths.size() == 1) {
             std::cout << "Wrote: " << runResult.outputPaths[0] << std::endl;
@@ -27,5 +206,10 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    return 0;
-}
\ No newline at end of file
+    if (!parsed.args.cacheDir.empty()) {
+        std::cout << "Cache: " << runResult.cache.hits << " hit(s), " << runResult.cache.misses << " miss(es), "
+                  << runResult.cache.evicted << " evicted." << std::endl;
+    }
+
+    return emitStats(parsed.args, runResult.stats) ? 0 : 1;
+}
@@ -0,0 +1,89 @@
+#include "mapped_file.h"
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(__EMSCRIPTEN__)
+#define NAM_HAVE_MMAP 1
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& path, bool allowMap) {
+#if defined(NAM_HAVE_MMAP)
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("File does not exist or is not readable: " + path);
+    }
+    struct stat st {};
+    if (allowMap && ::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        const size_t size = static_cast<size_t>(st.st_size);
+        void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            // Only a hint: readahead more aggressively and drop pages behind the parser.
+            ::madvise(mapping, size, MADV_SEQUENTIAL);
+            ::close(fd);
+            mapping_ = mapping;
+            mappedSize_ = size;
+            return;
+        }
+    }
+    // Read through the descriptor already open: reopening a pipe would wait for a new writer.
+    char buffer[64 * 1024];
+    for (;;) {
+        const ssize_t n = ::read(fd, buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            ::close(fd);
+            throw std::runtime_error("Failed to read file: " + path);
+        }
+        if (n == 0) break;
+        buffer_.append(buffer, static_cast<size_t>(n));
+    }
+    ::close(fd);
+#else
+    (void)allowMap;
+    // Fallback for platforms without mmap.
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("File does not exist or is not readable: " + path);
+    }
+    char chunk[64 * 1024];
+    while (file.read(chunk, sizeof(chunk)) || file.gcount() > 0) {
+        buffer_.append(chunk, static_cast<size_t>(file.gcount()));
+    }
+    if (file.bad()) {
+        throw std::runtime_error("Failed to read file: " + path);
+    }
+#endif
+}
+
+MappedFile::~MappedFile() {
+    release();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : mapping_(std::exchange(other.mapping_, nullptr)),
+      mappedSize_(std::exchange(other.mappedSize_, 0)),
+      buffer_(std::move(other.buffer_)) {}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        release();
+        mapping_ = std::exchange(other.mapping_, nullptr);
+        mappedSize_ = std::exchange(other.mappedSize_, 0);
+        buffer_ = std::move(other.buffer_);
+    }
+    return *this;
+}
+
+void MappedFile::release() {
+#if defined(NAM_HAVE_MMAP)
+    if (mapping_ != nullptr) ::munmap(mapping_, mappedSize_);
+#endif
+    mapping_ = nullptr;
+    mappedSize_ = 0;
+}
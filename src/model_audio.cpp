@@ -0,0 +1,80 @@
+#include "model_audio.h"
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <memory>
+
+#if defined(NAM_VOLUME_KNOB_HAVE_NAM_CORE)
+#include "NAM/dsp.h"
+#include "NAM/get_dsp.h"
+#endif
+
+bool ModelAudio::available() {
+#if defined(NAM_VOLUME_KNOB_HAVE_NAM_CORE)
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool ModelAudio::tryMeasure(const std::string& modelPath, const std::vector<double>& input, double sampleRate,
+                            size_t blockSize, AudioLevels& levels, std::string& error, double* processSeconds) {
+#if defined(NAM_VOLUME_KNOB_HAVE_NAM_CORE)
+    if (blockSize == 0) {
+        error = "Block size must be > 0.";
+        return false;
+    }
+    std::unique_ptr<nam::DSP> dsp;
+    try {
+        dsp = nam::get_dsp(std::filesystem::path(modelPath));
+    } catch (const std::exception& e) {
+        error = "Failed to load " + modelPath + " for audio: " + e.what();
+        return false;
+    }
+    if (!dsp) {
+        error = "Failed to load " + modelPath + " for audio.";
+        return false;
+    }
+    thread_local std::vector<NAM_SAMPLE> in;
+    thread_local std::vector<NAM_SAMPLE> out;
+    thread_local std::vector<double> metered;
+    in.resize(blockSize);
+    out.resize(blockSize);
+    metered.resize(blockSize);
+
+    LoudnessMeter meter(sampleRate);
+    std::chrono::steady_clock::duration processing{};
+    try {
+        dsp->Reset(sampleRate, static_cast<int>(blockSize));
+        dsp->prewarm();
+        for (size_t offset = 0; offset < input.size(); offset += blockSize) {
+            const size_t frames = std::min(blockSize, input.size() - offset);
+            std::copy_n(input.begin() + static_cast<std::ptrdiff_t>(offset), frames, in.begin());
+            NAM_SAMPLE* inputs[] = {in.data()};
+            NAM_SAMPLE* outputs[] = {out.data()};
+            const auto start = std::chrono::steady_clock::now();
+            dsp->process(inputs, outputs, static_cast<int>(frames));
+            processing += std::chrono::steady_clock::now() - start;
+            std::copy_n(out.begin(), frames, metered.begin());
+            meter.push(metered.data(), frames);
+        }
+    } catch (const std::exception& e) {
+        error = "Failed to run " + modelPath + ": " + e.what();
+        return false;
+    }
+    levels = meter.levels();
+    if (processSeconds != nullptr) *processSeconds = std::chrono::duration<double>(processing).count();
+    return true;
+#else
+    (void)modelPath;
+    (void)input;
+    (void)sampleRate;
+    (void)blockSize;
+    (void)levels;
+    (void)processSeconds;
+    error = "This build cannot run models: configure with NeuralAmpModelerCore in third_party/ "
+            "(NAM_VOLUME_KNOB_WITH_NAM_CORE=ON).";
+    return false;
+#endif
+}
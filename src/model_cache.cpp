@@ -0,0 +1,62 @@
+#include "model_cache.h"
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
+#include <utility>
+
+ModelCache::ModelCache(size_t capacity) : capacity_(std::max<size_t>(capacity, 1)) {}
+
+std::shared_ptr<const NamModel> ModelCache::find(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        ++stats_.misses;
+        return nullptr;
+    }
+    entries_.splice(entries_.begin(), entries_, it->second);
+    ++stats_.hits;
+    return it->second->second;
+}
+
+void ModelCache::insert(const std::string& key, std::shared_ptr<const NamModel> model) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        it->second->second = std::move(model);
+        entries_.splice(entries_.begin(), entries_, it->second);
+        return;
+    }
+    entries_.emplace_front(key, std::move(model));
+    index_[key] = entries_.begin();
+    while (entries_.size() > capacity_) {
+        index_.erase(entries_.back().first);
+        entries_.pop_back();
+        ++stats_.evicted;
+    }
+}
+
+std::string ModelCache::fileKey(const std::string& path) {
+    std::error_code ec;
+    const auto canonical = std::filesystem::canonical(path, ec);
+    if (ec) return std::string();
+    const auto size = std::filesystem::file_size(canonical, ec);
+    if (ec) return std::string();
+    const auto modified = std::filesystem::last_write_time(canonical, ec);
+    if (ec) return std::string();
+    const auto ticks = modified.time_since_epoch().count();
+    return "file:" + canonical.string() + "\n" + std::to_string(size) + "\n" + std::to_string(ticks);
+}
+
+std::string ModelCache::bytesKey(std::string_view bytes) {
+    return "bytes:" + std::to_string(ResultCache::hash(bytes)) + "\n" + std::to_string(bytes.size());
+}
+
+size_t ModelCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+CacheStats ModelCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
@@ -0,0 +1,86 @@
+#include "nam_model.h"
+#include <algorithm>
+
+NamWeightArray* NamModel::findWeights(const std::string& ownerPointer) {
+    // Search from the back: with duplicate keys the last array wins, as in the DOM parser.
+    for (auto it = weightArrays.rbegin(); it != weightArrays.rend(); ++it) {
+        if (it->ownerPointer == ownerPointer) return &*it;
+    }
+    return nullptr;
+}
+
+const NamWeightArray* NamModel::findWeights(const std::string& ownerPointer) const {
+    for (auto it = weightArrays.rbegin(); it != weightArrays.rend(); ++it) {
+        if (it->ownerPointer == ownerPointer) return &*it;
+    }
+    return nullptr;
+}
+
+nlohmann::json NamModel::toJson() const {
+    nlohmann::json j = document;
+    for (const auto& weights : weightArrays) {
+        j.at(nlohmann::json::json_pointer(weights.ownerPointer))["weights"] = weights.values;
+    }
+    return j;
+}
+
+void NamModel::appendPointerToken(std::string& pointer, const std::string& token) {
+    pointer.push_back('/');
+    for (char c : token) {
+        if (c == '~') {
+            pointer += "~0";
+        } else if (c == '/') {
+            pointer += "~1";
+        } else {
+            pointer.push_back(c);
+        }
+    }
+}
+
+NamModelVariant::NamModelVariant(std::shared_ptr<const NamModel> baseModel)
+    : base(std::move(baseModel)), document(base->document) {}
+
+NamWeightOverlay* NamModelVariant::overlay(const std::string& ownerPointer, size_t start, size_t end) {
+    const NamWeightArray* weights = base->findWeights(ownerPointer);
+    if (weights == nullptr || start > end || end > weights->values.size()) return nullptr;
+    const size_t arrayIndex = static_cast<size_t>(weights - base->weightArrays.data());
+
+    for (auto& existing : overlays) {
+        if (existing.arrayIndex != arrayIndex) continue;
+        const bool sameRange = existing.start == start && existing.values.size() == end - start;
+        return sameRange ? &existing : nullptr;
+    }
+
+    NamWeightOverlay added;
+    added.arrayIndex = arrayIndex;
+    added.start = start;
+    added.values.assign(weights->values.begin() + static_cast<std::ptrdiff_t>(start),
+                        weights->values.begin() + static_cast<std::ptrdiff_t>(end));
+    overlays.push_back(std::move(added));
+    return &overlays.back();
+}
+
+const NamWeightOverlay* NamModelVariant::findOverlay(size_t arrayIndex) const {
+    for (const auto& existing : overlays) {
+        if (existing.arrayIndex == arrayIndex) return &existing;
+    }
+    return nullptr;
+}
+
+bool NamModelVariant::tryGetWeightCount(const std::string& ownerPointer, size_t& count) const {
+    const NamWeightArray* weights = base->findWeights(ownerPointer);
+    if (weights == nullptr) return false;
+    count = weights->values.size();
+    return true;
+}
+
+NamModel NamModelVariant::materialize() const {
+    NamModel model;
+    model.document = document;
+    model.weightArrays = base->weightArrays;
+    for (const auto& replaced : overlays) {
+        std::copy(replaced.values.begin(), replaced.values.end(),
+                  model.weightArrays[replaced.arrayIndex].values.begin() + static_cast<std::ptrdiff_t>(replaced.start));
+    }
+    return model;
+}
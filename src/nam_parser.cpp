@@ -1,25 +1,401 @@
 #include "nam_parser.h"
-#include <fstream>
-#include <iostream>
+#include "mapped_file.h"
+#include "nam_binary.h"
+#include "run_stats.h"
+#include "weight_kernels.h"
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
 
 nlohmann::json NamParser::parseNamFile(const std::string& path) {
-    std::ifstream file(path);
-    if (!file.is_open()) {
-        throw std::runtime_error("File does not exist or is not readable: " + path);
-    }
+    StatsTimer timer(StatsStage::Parse);
+    const MappedFile file(path);
+    Stats::count(StatsCounter::BytesRead, file.size());
 
     nlohmann::json j;
     try {
-        file >> j;
+        // Non-strict, like operator>>: trailing bytes after the document are ignored.
+        nlohmann::detail::json_sax_dom_parser<nlohmann::json> sax(j);
+        nlohmann::json::sax_parse(file.data(), file.data() + file.size(), &sax, nlohmann::json::input_format_t::json, false);
     } catch (const nlohmann::json::parse_error& e) {
         throw std::runtime_error("JSON parsing failed in " + path + ": " + e.what());
     } catch (const nlohmann::json::exception& e) {
         throw std::runtime_error("JSON error in " + path + ": " + e.what());
     }
 
-    if (file.fail() && !file.eof()) {
-        throw std::runtime_error("Failed to read file: " + path);
+    return j;
+}
+
+namespace {
+
+// SAX handler that builds a DOM for everything except "weights" arrays, which are
+// streamed straight into NamModel::weightArrays as floats.
+class NamModelSaxHandler {
+public:
+    using json = nlohmann::json;
+
+    NamModelSaxHandler(NamModel& model, bool allowExceptions)
+        : model_(model), dom_(model.document, allowExceptions) {}
+
+    bool null() {
+        if (capturing_) return captureNonNumber();
+        onValue();
+        return dom_.null();
+    }
+    bool boolean(bool val) {
+        if (capturing_) return captureNonNumber();
+        onValue();
+        return dom_.boolean(val);
+    }
+    bool number_integer(json::number_integer_t val) {
+        if (capturing_) return captureNumber(static_cast<float>(val));
+        onValue();
+        return dom_.number_integer(val);
+    }
+    bool number_unsigned(json::number_unsigned_t val) {
+        if (capturing_) return captureNumber(static_cast<float>(val));
+        onValue();
+        return dom_.number_unsigned(val);
+    }
+    bool number_float(json::number_float_t val, const json::string_t& s) {
+        if (capturing_) return captureNumber(static_cast<float>(val));
+        onValue();
+        return dom_.number_float(val, s);
+    }
+    bool string(json::string_t& val) {
+        if (capturing_) return captureNonNumber();
+        onValue();
+        return dom_.string(val);
+    }
+    bool binary(json::binary_t& val) {
+        if (capturing_) return captureNonNumber();
+        onValue();
+        return dom_.binary(val);
+    }
+
+    bool start_object(std::size_t len) {
+        if (capturing_) {
+            captureNonNumber();
+            ++captureDepth_;
+            return true;
+        }
+        pushFrame(false);
+        return dom_.start_object(len);
+    }
+    bool key(json::string_t& val) {
+        if (capturing_) return true;
+        frames_.back().key = val;
+        pendingWeights_ = (val == "weights");
+        return dom_.key(val);
+    }
+    bool end_object() {
+        if (capturing_) {
+            --captureDepth_;
+            return true;
+        }
+        frames_.pop_back();
+        return dom_.end_object();
     }
 
-    return j;
-}
\ No newline at end of file
+    bool start_array(std::size_t len) {
+        if (capturing_) {
+            captureNonNumber();
+            ++captureDepth_;
+            return true;
+        }
+        if (pendingWeights_) {
+            pendingWeights_ = false;
+            NamWeightArray weights;
+            weights.ownerPointer = currentPointer();
+            model_.weightArrays.push_back(std::move(weights));
+            capturing_ = true;
+            captureDepth_ = 0;
+            captureIndex_ = 0;
+            // Leave a placeholder so the DOM still has the "weights" key.
+            return dom_.null();
+        }
+        pushFrame(true);
+        return dom_.start_array(len);
+    }
+    bool end_array() {
+        if (capturing_) {
+            if (captureDepth_ == 0) {
+                capturing_ = false;
+            } else {
+                --captureDepth_;
+            }
+            return true;
+        }
+        frames_.pop_back();
+        return dom_.end_array();
+    }
+
+    template <class Exception>
+    bool parse_error(std::size_t position, const std::string& lastToken, const Exception& ex) {
+        return dom_.parse_error(position, lastToken, ex);
+    }
+
+private:
+    struct Frame {
+        bool isArray = false;
+        size_t nextIndex = 0;
+        std::string key;    // most recent key, for objects
+        std::string token;  // reference token of this container within its parent
+    };
+
+    // Called for each scalar outside a captured array, to keep array indices current.
+    void onValue() {
+        pendingWeights_ = false;
+        if (!frames_.empty() && frames_.back().isArray) ++frames_.back().nextIndex;
+    }
+
+    void pushFrame(bool isArray) {
+        Frame frame;
+        frame.isArray = isArray;
+        if (!frames_.empty()) {
+            Frame& parent = frames_.back();
+            frame.token = parent.isArray ? std::to_string(parent.nextIndex++) : parent.key;
+        }
+        pendingWeights_ = false;
+        frames_.push_back(std::move(frame));
+    }
+
+    std::string currentPointer() const {
+        std::string pointer;
+        for (size_t i = 1; i < frames_.size(); ++i) {
+            NamModel::appendPointerToken(pointer, frames_[i].token);
+        }
+        return pointer;
+    }
+
+    // Conversion and the finite check happen here, in the same pass that stores the value.
+    bool captureNumber(float value) {
+        if (captureDepth_ == 0) {
+            NamWeightArray& weights = model_.weightArrays.back();
+            if (!std::isfinite(value) && weights.firstInvalid == NamWeightArray::npos) {
+                weights.firstInvalid = captureIndex_;
+            }
+            weights.values.push_back(value);
+            ++captureIndex_;
+        }
+        return true;
+    }
+
+    bool captureNonNumber() {
+        if (captureDepth_ == 0) {
+            NamWeightArray& weights = model_.weightArrays.back();
+            if (weights.firstInvalid == NamWeightArray::npos) weights.firstInvalid = captureIndex_;
+            ++captureIndex_;
+        }
+        return true;
+    }
+
+    NamModel& model_;
+    nlohmann::detail::json_sax_dom_parser<json> dom_;
+    std::vector<Frame> frames_;
+    bool pendingWeights_ = false;
+    bool capturing_ = false;
+    size_t captureDepth_ = 0;
+    size_t captureIndex_ = 0;  // element index within the captured array
+};
+
+} // namespace
+
+static void countWeights(const NamModel& model) {
+    if (Stats::current() == nullptr) return;
+    for (const auto& weights : model.weightArrays) Stats::count(StatsCounter::WeightsVisited, weights.values.size());
+}
+
+NamModel NamParser::parseNamModel(const std::string& path) {
+    StatsTimer timer(StatsStage::Parse);
+    const MappedFile file(path);
+    Stats::count(StatsCounter::BytesRead, file.size());
+    return parseNamModel(file, path);
+}
+
+NamModel NamParser::parseNamModel(const MappedFile& file, const std::string& path) {
+    StatsTimer timer(StatsStage::Parse);
+    NamModel model;
+    if (NamBinary::matches(file.view())) {
+        std::string err;
+        if (!tryParseNamBinary(file.view(), model, err)) {
+            throw std::runtime_error("Invalid .namb file " + path + ": " + err);
+        }
+        countWeights(model);
+        return model;
+    }
+    try {
+        NamModelSaxHandler handler(model, true);
+        nlohmann::json::sax_parse(file.data(), file.data() + file.size(), &handler);
+    } catch (const nlohmann::json::parse_error& e) {
+        throw std::runtime_error("JSON parsing failed in " + path + ": " + e.what());
+    } catch (const nlohmann::json::exception& e) {
+        throw std::runtime_error("JSON error in " + path + ": " + e.what());
+    }
+
+    countWeights(model);
+    return model;
+}
+
+bool NamParser::tryParseNamModel(std::string_view text, NamModel& model, std::string& error) {
+    StatsTimer timer(StatsStage::Parse);
+    if (NamBinary::matches(text)) return tryParseNamBinary(text, model, error);
+    model = NamModel();
+    NamModelSaxHandler handler(model, false);
+    if (!nlohmann::json::sax_parse(text.data(), text.data() + text.size(), &handler)) {
+        model = NamModel();
+        error = "Failed to parse JSON.";
+        return false;
+    }
+    return true;
+}
+
+static uint64_t readLittleEndian(const char* p, size_t size) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; ++i) value |= uint64_t(static_cast<unsigned char>(p[i])) << (8 * i);
+    return value;
+}
+
+bool NamParser::tryParseNamBinary(std::string_view bytes, NamModel& model, std::string& error) {
+    model = NamModel();
+    if (bytes.size() < NamBinary::kPrefixSize || !NamBinary::matches(bytes)) {
+        error = "Missing .namb header.";
+        return false;
+    }
+    const uint64_t version = readLittleEndian(bytes.data() + 4, 4);
+    if (version != NamBinary::kVersion) {
+        error = "Unsupported .namb version " + std::to_string(version) + ".";
+        return false;
+    }
+    const uint64_t headerSize = readLittleEndian(bytes.data() + 8, 8);
+    if (headerSize > bytes.size() - NamBinary::kPrefixSize) {
+        error = "Truncated .namb header.";
+        return false;
+    }
+    const std::string_view headerText = bytes.substr(NamBinary::kPrefixSize, headerSize);
+    nlohmann::json header = nlohmann::json::parse(headerText.begin(), headerText.end(), nullptr, false);
+    if (!header.is_object() || !header.contains("document") || !header["document"].is_object()
+        || !header.contains("weights") || !header["weights"].is_array()) {
+        error = "Invalid .namb header.";
+        return false;
+    }
+
+    // Every blob must lie inside the data section, which starts at the first aligned offset
+    // after the header.
+    const size_t dataStart = NamBinary::alignUp(NamBinary::kPrefixSize + headerSize);
+    const size_t dataSize = bytes.size() >= dataStart ? bytes.size() - dataStart : 0;
+    for (const auto& entry : header["weights"]) {
+        if (!entry.is_object() || !entry.contains("owner") || !entry["owner"].is_string()
+            || !entry.contains("offset") || !entry["offset"].is_number_unsigned()
+            || !entry.contains("count") || !entry["count"].is_number_unsigned()) {
+            error = "Invalid .namb weight table.";
+            model = NamModel();
+            return false;
+        }
+        const uint64_t offset = entry["offset"].get<uint64_t>();
+        const uint64_t count = entry["count"].get<uint64_t>();
+        if (offset > dataSize || count > (dataSize - offset) / sizeof(float)) {
+            error = "Weights of \"" + entry["owner"].get<std::string>() + "\" lie outside the file.";
+            model = NamModel();
+            return false;
+        }
+        NamWeightArray weights;
+        weights.ownerPointer = entry["owner"].get<std::string>();
+        weights.values.resize(static_cast<size_t>(count));
+        // Little-endian float32 on disk, as on every supported target.
+        if (count != 0) std::memcpy(weights.values.data(), bytes.data() + dataStart + offset, count * sizeof(float));
+        const size_t nonFinite = WeightKernels::findNonFinite(weights.values.data(), weights.values.size());
+        if (nonFinite != weights.values.size()) weights.firstInvalid = nonFinite;
+        model.weightArrays.push_back(std::move(weights));
+    }
+    model.document = std::move(header["document"]);
+    return true;
+}
+
+namespace {
+
+// SAX handler that only looks at string values of top-level keys and stops once it has
+// both fields.
+class NamProbeSaxHandler {
+public:
+    using json = nlohmann::json;
+
+    explicit NamProbeSaxHandler(NamProbe& probe) : probe_(probe) {}
+
+    bool null() { return true; }
+    bool boolean(bool) { return true; }
+    bool number_integer(json::number_integer_t) { return true; }
+    bool number_unsigned(json::number_unsigned_t) { return true; }
+    bool number_float(json::number_float_t, const json::string_t&) { return true; }
+    bool binary(json::binary_t&) { return true; }
+    bool string(json::string_t& val) {
+        if (depth_ == 1 && key_ == "architecture") {
+            probe_.architecture = val;
+            seenArchitecture_ = true;
+        } else if (depth_ == 1 && key_ == "version") {
+            probe_.version = val;
+            seenVersion_ = true;
+        }
+        return !done();
+    }
+    bool key(json::string_t& val) {
+        if (depth_ == 1) key_ = val;
+        return true;
+    }
+    bool start_object(std::size_t) { return ++depth_, true; }
+    bool end_object() { return --depth_, true; }
+    bool start_array(std::size_t) { return ++depth_, true; }
+    bool end_array() { return --depth_, true; }
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& ex) {
+        error_ = ex.what();
+        return false;
+    }
+
+    bool done() const { return seenArchitecture_ && seenVersion_; }
+    const std::string& error() const { return error_; }
+
+private:
+    NamProbe& probe_;
+    size_t depth_ = 0;
+    std::string key_;
+    bool seenArchitecture_ = false;
+    bool seenVersion_ = false;
+    std::string error_;
+};
+
+} // namespace
+
+bool NamParser::tryProbeNam(std::string_view bytes, NamProbe& probe, std::string& error) {
+    probe = NamProbe();
+    if (NamBinary::matches(bytes)) {
+        // The document is in the header; the weights after it are never touched.
+        const uint64_t headerSize = bytes.size() >= NamBinary::kPrefixSize ? readLittleEndian(bytes.data() + 8, 8) : 0;
+        if (bytes.size() < NamBinary::kPrefixSize || headerSize > bytes.size() - NamBinary::kPrefixSize) {
+            error = "Truncated .namb header.";
+            return false;
+        }
+        const std::string_view headerText = bytes.substr(NamBinary::kPrefixSize, headerSize);
+        const nlohmann::json header = nlohmann::json::parse(headerText.begin(), headerText.end(), nullptr, false);
+        if (!header.is_object() || !header.contains("document") || !header["document"].is_object()) {
+            error = "Invalid .namb header.";
+            return false;
+        }
+        const auto& document = header["document"];
+        if (document.contains("architecture") && document["architecture"].is_string()) {
+            probe.architecture = document["architecture"].get<std::string>();
+        }
+        if (document.contains("version") && document["version"].is_string()) {
+            probe.version = document["version"].get<std::string>();
+        }
+        return true;
+    }
+
+    NamProbeSaxHandler handler(probe);
+    nlohmann::json::sax_parse(bytes.data(), bytes.data() + bytes.size(), &handler);
+    if (!handler.done() && !handler.error().empty()) {
+        probe = NamProbe();
+        error = "Failed to parse JSON.";
+        return false;
+    }
+    return true;
+}
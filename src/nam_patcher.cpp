@@ -0,0 +1,569 @@
+#include "nam_patcher.h"
+#include "nam_model.h"
+#include "nam_writer.h"
+#include "run_stats.h"
+#include "validator.h"
+#include "weight_scaler.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+
+namespace {
+
+bool isJsonSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+void appendUtf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out.push_back(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+}
+
+// Single-pass JSON lexer that records byte offsets instead of building values. Weights
+// array contents are checked for number syntax and skipped; everything else is copied to
+// a skeleton text that nlohmann then parses into the (small) index document.
+class TextIndexer {
+public:
+    TextIndexer(std::string_view text, NamTextIndex& index) : text_(text), index_(index) {}
+
+    bool run(std::string& error) {
+        if (text_.substr(0, 3) == "\xEF\xBB\xBF") pos_ = 3;  // UTF-8 BOM, as accepted by nlohmann
+        skipSpace();
+        if (!parseValue()) {
+            error = error_.empty() ? "Unexpected end of input." : error_;
+            return false;
+        }
+        skipSpace();
+        if (pos_ != text_.size()) {
+            error = "Unexpected trailing characters at byte " + std::to_string(pos_) + ".";
+            return false;
+        }
+        skeleton_.append(text_.data() + copied_, text_.size() - copied_);
+        return true;
+    }
+
+    const std::string& skeleton() const { return skeleton_; }
+
+private:
+    bool fail(const std::string& message) {
+        if (error_.empty()) error_ = message + " (byte " + std::to_string(pos_) + ")";
+        return false;
+    }
+
+    void skipSpace() {
+        while (pos_ < text_.size() && isJsonSpace(text_[pos_])) ++pos_;
+    }
+
+    bool parseValue() {
+        if (pos_ >= text_.size()) return fail("Unexpected end of input");
+        const char c = text_[pos_];
+        if (c == '{') return parseObject();
+        if (c == '[') return parseArray();
+        if (c == '"') return parseString(nullptr);
+        if (c == 't') return parseLiteral("true");
+        if (c == 'f') return parseLiteral("false");
+        if (c == 'n') return parseLiteral("null");
+        const size_t begin = pos_;
+        if (!scanNumber()) return fail("Invalid value");
+        index_.numbers[pointer_] = {begin, pos_};
+        return true;
+    }
+
+    bool parseLiteral(std::string_view literal) {
+        if (text_.substr(pos_, literal.size()) != literal) return fail("Invalid literal");
+        pos_ += literal.size();
+        return true;
+    }
+
+    // -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+    bool scanNumber() {
+        const size_t start = pos_;
+        auto digits = [&] {
+            const size_t from = pos_;
+            while (pos_ < text_.size() && text_[pos_] >= '0' && text_[pos_] <= '9') ++pos_;
+            return pos_ > from;
+        };
+        if (pos_ < text_.size() && text_[pos_] == '-') ++pos_;
+        if (pos_ < text_.size() && text_[pos_] == '0') {
+            ++pos_;
+        } else if (!digits()) {
+            pos_ = start;
+            return false;
+        }
+        if (pos_ < text_.size() && text_[pos_] == '.') {
+            ++pos_;
+            if (!digits()) {
+                pos_ = start;
+                return false;
+            }
+        }
+        if (pos_ < text_.size() && (text_[pos_] == 'e' || text_[pos_] == 'E')) {
+            ++pos_;
+            if (pos_ < text_.size() && (text_[pos_] == '+' || text_[pos_] == '-')) ++pos_;
+            if (!digits()) {
+                pos_ = start;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool parseString(std::string* decoded) {
+        ++pos_;  // opening quote
+        while (pos_ < text_.size()) {
+            const char c = text_[pos_++];
+            if (c == '"') return true;
+            if (static_cast<unsigned char>(c) < 0x20) return fail("Control character in string");
+            if (c != '\\') {
+                if (decoded) decoded->push_back(c);
+                continue;
+            }
+            if (pos_ >= text_.size()) break;
+            const char e = text_[pos_++];
+            switch (e) {
+                case '"': case '\\': case '/':
+                    if (decoded) decoded->push_back(e);
+                    break;
+                case 'b': if (decoded) decoded->push_back('\b'); break;
+                case 'f': if (decoded) decoded->push_back('\f'); break;
+                case 'n': if (decoded) decoded->push_back('\n'); break;
+                case 'r': if (decoded) decoded->push_back('\r'); break;
+                case 't': if (decoded) decoded->push_back('\t'); break;
+                case 'u': {
+                    uint32_t cp = 0;
+                    if (!parseHex4(cp)) return fail("Invalid \\u escape");
+                    if (cp >= 0xD800 && cp <= 0xDBFF && text_.substr(pos_, 2) == "\\u") {
+                        pos_ += 2;
+                        uint32_t low = 0;
+                        if (!parseHex4(low)) return fail("Invalid \\u escape");
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    if (decoded) appendUtf8(*decoded, cp);
+                    break;
+                }
+                default:
+                    return fail("Invalid escape in string");
+            }
+        }
+        return fail("Unterminated string");
+    }
+
+    bool parseHex4(uint32_t& out) {
+        if (pos_ + 4 > text_.size()) return false;
+        out = 0;
+        for (int i = 0; i < 4; ++i) {
+            const char h = text_[pos_++];
+            out <<= 4;
+            if (h >= '0' && h <= '9') out |= static_cast<uint32_t>(h - '0');
+            else if (h >= 'a' && h <= 'f') out |= static_cast<uint32_t>(h - 'a' + 10);
+            else if (h >= 'A' && h <= 'F') out |= static_cast<uint32_t>(h - 'A' + 10);
+            else return false;
+        }
+        return true;
+    }
+
+    bool parseObject() {
+        ++pos_;
+        skipSpace();
+        if (pos_ < text_.size() && text_[pos_] == '}') {
+            ++pos_;
+            return true;
+        }
+        for (;;) {
+            skipSpace();
+            if (pos_ >= text_.size() || text_[pos_] != '"') return fail("Expected object key");
+            std::string key;
+            if (!parseString(&key)) return false;
+            skipSpace();
+            if (pos_ >= text_.size() || text_[pos_] != ':') return fail("Expected ':'");
+            ++pos_;
+            skipSpace();
+
+            bool ok;
+            if (key == "weights" && pos_ < text_.size() && text_[pos_] == '[') {
+                ok = parseWeights();
+            } else {
+                const size_t mark = pointer_.size();
+                NamModel::appendPointerToken(pointer_, key);
+                ok = parseValue();
+                pointer_.resize(mark);
+            }
+            if (!ok) return false;
+
+            skipSpace();
+            if (pos_ < text_.size() && text_[pos_] == ',') {
+                ++pos_;
+                continue;
+            }
+            if (pos_ < text_.size() && text_[pos_] == '}') {
+                ++pos_;
+                return true;
+            }
+            return fail("Expected ',' or '}'");
+        }
+    }
+
+    bool parseArray() {
+        ++pos_;
+        skipSpace();
+        if (pos_ < text_.size() && text_[pos_] == ']') {
+            ++pos_;
+            return true;
+        }
+        for (size_t i = 0;; ++i) {
+            skipSpace();
+            const size_t mark = pointer_.size();
+            NamModel::appendPointerToken(pointer_, std::to_string(i));
+            const bool ok = parseValue();
+            pointer_.resize(mark);
+            if (!ok) return false;
+            skipSpace();
+            if (pos_ < text_.size() && text_[pos_] == ',') {
+                ++pos_;
+                continue;
+            }
+            if (pos_ < text_.size() && text_[pos_] == ']') {
+                ++pos_;
+                return true;
+            }
+            return fail("Expected ',' or ']'");
+        }
+    }
+
+    static constexpr size_t kNoInvalid = static_cast<size_t>(-1);
+
+    // Whether a number literal is a finite float once read, like NamParser's values: the
+    // double is narrowed, so 1e39 fails as well as 1e999. Underflow reads as zero.
+    static bool isFiniteFloat(std::string_view literal) {
+        double value = 0.0;
+        const auto [end, ec] = std::from_chars(literal.data(), literal.data() + literal.size(), value);
+        if (ec == std::errc::result_out_of_range) {
+            value = std::strtod(std::string(literal).c_str(), nullptr);
+        } else if (ec != std::errc() || end != literal.data() + literal.size()) {
+            return false;
+        }
+        return std::isfinite(static_cast<float>(value));
+    }
+
+    // Skips a weights array, counting elements and checking that each is a number that
+    // converts to a finite float. The array is replaced by a null placeholder in the skeleton.
+    bool parseWeights() {
+        const size_t open = pos_;
+        NamWeightsSpan span;
+        span.ownerPointer = pointer_;
+        ++pos_;
+        span.begin = pos_;
+        skipSpace();
+        if (pos_ < text_.size() && text_[pos_] == ']') {
+            span.end = pos_;
+        } else {
+            for (;;) {
+                skipSpace();
+                const size_t start = pos_;
+                if (scanNumber()) {
+                    if (!isFiniteFloat(text_.substr(start, pos_ - start)) && span.firstInvalid == kNoInvalid) {
+                        span.firstInvalid = span.count;
+                    }
+                } else {
+                    span.numeric = false;
+                    if (span.firstInvalid == kNoInvalid) span.firstInvalid = span.count;
+                    // Not a number: parse generically (into a throwaway pointer scope).
+                    const size_t mark = pointer_.size();
+                    pointer_ += "/weights/" + std::to_string(span.count);
+                    const bool ok = parseValue();
+                    pointer_.resize(mark);
+                    if (!ok) return false;
+                }
+                ++span.count;
+                skipSpace();
+                if (pos_ < text_.size() && text_[pos_] == ',') {
+                    ++pos_;
+                    continue;
+                }
+                if (pos_ < text_.size() && text_[pos_] == ']') {
+                    span.end = pos_;
+                    break;
+                }
+                return fail("Expected ',' or ']' in weights");
+            }
+        }
+        ++pos_;  // closing bracket
+
+        skeleton_.append(text_.data() + copied_, open - copied_);
+        skeleton_ += "null";
+        copied_ = pos_;
+        index_.weights.push_back(std::move(span));
+        return true;
+    }
+
+    std::string_view text_;
+    NamTextIndex& index_;
+    size_t pos_ = 0;
+    std::string pointer_;
+    std::string skeleton_;
+    size_t copied_ = 0;
+    std::string error_;
+};
+
+// Finds the byte ranges of weights elements [first, last) inside span.
+bool locateElements(std::string_view text, const NamWeightsSpan& span, size_t first, size_t last,
+                    std::vector<std::pair<size_t, size_t>>& ranges) {
+    ranges.clear();
+    if (first >= last) return true;
+    ranges.resize(last - first);
+
+    auto isDelimiter = [](char c) { return c == ',' || isJsonSpace(c); };
+
+    if (first >= span.count - last) {
+        // Head is near the tail (LSTM/WaveNet/ConvNet): walk backwards from the closing bracket.
+        size_t pos = span.end;
+        for (size_t i = span.count; i-- > first;) {
+            while (pos > span.begin && isDelimiter(text[pos - 1])) --pos;
+            const size_t tokenEnd = pos;
+            while (pos > span.begin && !isDelimiter(text[pos - 1])) --pos;
+            if (pos == tokenEnd) return false;
+            if (i < last) ranges[i - first] = {pos, tokenEnd};
+        }
+    } else {
+        size_t pos = span.begin;
+        for (size_t i = 0; i < last; ++i) {
+            while (pos < span.end && isDelimiter(text[pos])) ++pos;
+            const size_t tokenBegin = pos;
+            while (pos < span.end && !isDelimiter(text[pos])) ++pos;
+            if (pos == tokenBegin) return false;
+            if (i >= first) ranges[i - first] = {tokenBegin, pos};
+        }
+    }
+    return true;
+}
+
+double parseNumberText(std::string_view text) {
+    // Numbers are short; copy so strtod sees a terminated string.
+    std::string number(text);
+    return std::strtod(number.c_str(), nullptr);
+}
+
+class EditBuilder {
+public:
+    EditBuilder(std::string_view text, const NamTextIndex& index, NamOutputFormat format, std::vector<NamPatchEdit>& edits)
+        : text_(text), index_(index), format_(format), edits_(edits) {}
+
+    // Same walk as WeightScaler::tryScaleA2Model over the index document.
+    bool scaleA2Node(const nlohmann::json& node, std::string& pointer, float factor, std::string& error) {
+        if (!node.contains("architecture") || !node["architecture"].is_string()) {
+            error = "Missing or invalid architecture field in model.";
+            return false;
+        }
+        const std::string arch = node["architecture"].get<std::string>();
+
+        if (arch == "SlimmableContainer") {
+            if (!node.contains("config") || !node["config"].is_object()) {
+                error = "SlimmableContainer missing or invalid config.";
+                return false;
+            }
+            if (!node["config"].contains("submodels") || !node["config"]["submodels"].is_array()) {
+                error = "SlimmableContainer config missing or invalid submodels array.";
+                return false;
+            }
+            const auto& submodels = node["config"]["submodels"];
+            for (size_t i = 0; i < submodels.size(); ++i) {
+                if (!submodels[i].contains("model") || !submodels[i]["model"].is_object()) {
+                    error = "SlimmableContainer submodel entry missing or invalid model field.";
+                    return false;
+                }
+                const size_t mark = pointer.size();
+                pointer += "/config/submodels/" + std::to_string(i) + "/model";
+                const bool ok = scaleA2Node(submodels[i]["model"], pointer, factor, error);
+                pointer.resize(mark);
+                if (!ok) return false;
+            }
+            updateMetadata(node, pointer, 20.0f * std::log10(factor));
+            return true;
+        }
+
+        if (!node.contains("config") || !node["config"].is_object()) {
+            error = "Model missing or invalid config.";
+            return false;
+        }
+        if (!scaleHead(node, pointer, arch, factor, error)) return false;
+        updateMetadata(node, pointer, 20.0f * std::log10(factor));
+        return true;
+    }
+
+    bool scaleHead(const nlohmann::json& node, const std::string& pointer, const std::string& arch, float factor,
+                   std::string& error) {
+        const NamWeightsSpan* span = index_.findWeights(pointer);
+        if (span == nullptr || !span->numeric) {
+            error = "Model missing or invalid weights array.";
+            return false;
+        }
+        size_t start, end;
+        if (!WeightScaler::tryGetHeadWeightIndices(arch, node["config"], span->count, start, end, error)) {
+            return false;
+        }
+        if (!locateElements(text_, *span, start, end, ranges_)) {
+            error = "Malformed weights array.";
+            return false;
+        }
+        Stats::count(StatsCounter::WeightsScaled, ranges_.size());
+        // One edit for the whole head range keeps the separators between elements intact.
+        NamPatchEdit edit;
+        edit.begin = ranges_.empty() ? 0 : ranges_.front().first;
+        edit.end = ranges_.empty() ? 0 : ranges_.back().second;
+        for (size_t i = 0; i < ranges_.size(); ++i) {
+            if (i != 0) edit.text.append(text_.data() + ranges_[i - 1].second, ranges_[i].first - ranges_[i - 1].second);
+            const float value = static_cast<float>(parseNumberText(text_.substr(ranges_[i].first, ranges_[i].second - ranges_[i].first)));
+            const float scaled = value * factor;
+            if (!std::isfinite(scaled)) {
+                error = "Scaled weight at index " + std::to_string(start + i) + " is not a finite number.";
+                return false;
+            }
+            NamWriter::appendWeight(edit.text, scaled, format_);
+        }
+        if (!ranges_.empty()) edits_.push_back(std::move(edit));
+        return true;
+    }
+
+    // Same fields and arithmetic as WeightScaler::updateMetadata.
+    void updateMetadata(const nlohmann::json& node, const std::string& pointer, float dbGain) {
+        if (node.contains("metadata") && node["metadata"].is_object()) {
+            patchNumber(node["metadata"], "loudness", pointer + "/metadata", dbGain);
+            patchNumber(node["metadata"], "gain", pointer + "/metadata", dbGain);
+        }
+        if (node.contains("config") && node["config"].is_object()) {
+            patchNumber(node["config"], "output_level", pointer + "/config", dbGain);
+        }
+    }
+
+private:
+    void patchNumber(const nlohmann::json& parent, const std::string& key, const std::string& parentPointer, float dbGain) {
+        if (!parent.contains(key) || !parent[key].is_number()) return;
+        std::string pointer = parentPointer;
+        NamModel::appendPointerToken(pointer, key);
+        auto it = index_.numbers.find(pointer);
+        if (it == index_.numbers.end()) return;
+        const auto [begin, end] = it->second;
+        const float value = static_cast<float>(parseNumberText(text_.substr(begin, end - begin)));
+        NamPatchEdit edit;
+        edit.begin = begin;
+        edit.end = end;
+        NamWriter::appendFloat(edit.text, value + dbGain);
+        edits_.push_back(std::move(edit));
+    }
+
+    std::string_view text_;
+    const NamTextIndex& index_;
+    NamOutputFormat format_;
+    std::vector<NamPatchEdit>& edits_;
+    std::vector<std::pair<size_t, size_t>> ranges_;
+};
+
+} // namespace
+
+const NamWeightsSpan* NamTextIndex::findWeights(const std::string& ownerPointer) const {
+    for (auto it = weights.rbegin(); it != weights.rend(); ++it) {
+        if (it->ownerPointer == ownerPointer) return &*it;
+    }
+    return nullptr;
+}
+
+bool NamPatcher::tryIndex(std::string_view text, NamTextIndex& index, std::string& error) {
+    StatsTimer timer(StatsStage::Parse);
+    index = NamTextIndex();
+    TextIndexer indexer(text, index);
+    if (!indexer.run(error)) return false;
+
+    index.document = nlohmann::json::parse(indexer.skeleton(), nullptr, false);
+    if (index.document.is_discarded()) {
+        error = "Failed to parse JSON.";
+        return false;
+    }
+    return true;
+}
+
+bool NamPatcher::validate(const NamTextIndex& index) {
+    std::string error;
+    return validate(index, error);
+}
+
+bool NamPatcher::validate(const NamTextIndex& index, std::string& error) {
+    return Validator::validateNamStructure(index.document, [&index, &error](const std::string& modelPointer) {
+        // Element values were checked while indexing; same message as Validator::validateNam.
+        const NamWeightsSpan* span = index.findWeights(modelPointer);
+        if (span == nullptr) return false;
+        if (span->firstInvalid != static_cast<size_t>(-1)) {
+            error = "Weight at index " + std::to_string(span->firstInvalid);
+            if (!modelPointer.empty()) error += " of " + modelPointer;
+            error += " is not a finite number.";
+            return false;
+        }
+        return span->numeric && span->count > 0;
+    }, error);
+}
+
+bool NamPatcher::tryBuildEdits(std::string_view text, const NamTextIndex& index, float factor, float dbGain,
+                               std::vector<NamPatchEdit>& edits, std::string& error, NamOutputFormat weightFormat) {
+    StatsTimer timer(StatsStage::Scale);
+    edits.clear();
+    EditBuilder builder(text, index, weightFormat, edits);
+    const auto& doc = index.document;
+    if (!doc.contains("architecture") || !doc["architecture"].is_string()) {
+        error = "Missing or invalid architecture field in model.";
+        return false;
+    }
+
+    std::string pointer;
+    const std::string arch = doc["architecture"].get<std::string>();
+    if (arch == "SlimmableContainer") {
+        if (!builder.scaleA2Node(doc, pointer, factor, error)) return false;
+    } else {
+        if (!builder.scaleHead(doc, pointer, arch, factor, error)) return false;
+        builder.updateMetadata(doc, pointer, dbGain);
+    }
+
+    std::sort(edits.begin(), edits.end(), [](const NamPatchEdit& a, const NamPatchEdit& b) { return a.begin < b.begin; });
+    return true;
+}
+
+std::string NamPatcher::apply(std::string_view text, const std::vector<NamPatchEdit>& edits) {
+    size_t size = text.size();
+    for (const auto& edit : edits) size = size - (edit.end - edit.begin) + edit.text.size();
+
+    std::string out;
+    out.reserve(size);
+    size_t cursor = 0;
+    for (const auto& edit : edits) {
+        out.append(text.data() + cursor, edit.begin - cursor);
+        out += edit.text;
+        cursor = edit.end;
+    }
+    out.append(text.data() + cursor, text.size() - cursor);
+    return out;
+}
+
+std::vector<std::string_view> NamPatcher::pieces(std::string_view text, const std::vector<NamPatchEdit>& edits) {
+    std::vector<std::string_view> out;
+    out.reserve(edits.size() * 2 + 1);
+    size_t cursor = 0;
+    for (const auto& edit : edits) {
+        if (edit.begin > cursor) out.push_back(text.substr(cursor, edit.begin - cursor));
+        if (!edit.text.empty()) out.push_back(edit.text);
+        cursor = edit.end;
+    }
+    if (cursor < text.size()) out.push_back(text.substr(cursor));
+    return out;
+}
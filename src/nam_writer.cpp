@@ -0,0 +1,240 @@
+#include "nam_writer.h"
+#include "nam_binary.h"
+#include "run_stats.h"
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+constexpr int kIndentStep = 4;
+
+// Where weight values come from: the model's arrays, with an optional variant's overlays on
+// top, and how to lay them out.
+struct WeightSource {
+    const NamModel& model;
+    const NamModelVariant* variant;
+    NamOutputFormat format;
+};
+
+void appendWeights(std::string& out, const WeightSource& source, const NamWeightArray& weights,
+                   const NamWeightOverlay* overlay, int indent) {
+    if (weights.values.empty()) {
+        out += "[]";
+        return;
+    }
+    const size_t overlayBegin = overlay != nullptr ? overlay->start : 0;
+    const size_t overlayEnd = overlay != nullptr ? overlay->start + overlay->values.size() : 0;
+    if (source.format == NamOutputFormat::Compact) {
+        out += '[';
+        for (size_t i = 0; i < weights.values.size(); ++i) {
+            if (i != 0) out += ',';
+            const bool replaced = i >= overlayBegin && i < overlayEnd;
+            NamWriter::appendShortestFloat(out, replaced ? overlay->values[i - overlayBegin] : weights.values[i]);
+        }
+        out += ']';
+        return;
+    }
+    const std::string itemIndent(static_cast<size_t>(indent + kIndentStep), ' ');
+    out += "[\n";
+    for (size_t i = 0; i < weights.values.size(); ++i) {
+        if (i != 0) out += ",\n";
+        out += itemIndent;
+        const bool replaced = i >= overlayBegin && i < overlayEnd;
+        NamWriter::appendFloat(out, replaced ? overlay->values[i - overlayBegin] : weights.values[i]);
+    }
+    out += '\n';
+    out.append(static_cast<size_t>(indent), ' ');
+    out += ']';
+}
+
+// Pretty follows the layout rules of nlohmann::json::dump(4), compact those of dump();
+// pointer tracks the JSON pointer of value.
+void appendValue(std::string& out, const WeightSource& source, const nlohmann::json& value, std::string& pointer, int indent) {
+    const bool pretty = source.format == NamOutputFormat::Pretty;
+    if (value.is_object()) {
+        if (value.empty()) {
+            out += "{}";
+            return;
+        }
+        const std::string itemIndent(pretty ? static_cast<size_t>(indent + kIndentStep) : 0, ' ');
+        out += pretty ? "{\n" : "{";
+        bool first = true;
+        for (auto it = value.begin(); it != value.end(); ++it) {
+            if (!first) out += pretty ? ",\n" : ",";
+            first = false;
+            out += itemIndent;
+            out += nlohmann::json(it.key()).dump();
+            out += pretty ? ": " : ":";
+
+            if (it.key() == "weights" && it.value().is_null()) {
+                if (const NamWeightArray* weights = source.model.findWeights(pointer)) {
+                    const NamWeightOverlay* overlay = nullptr;
+                    if (source.variant != nullptr) {
+                        overlay = source.variant->findOverlay(static_cast<size_t>(weights - source.model.weightArrays.data()));
+                    }
+                    appendWeights(out, source, *weights, overlay, indent + kIndentStep);
+                    continue;
+                }
+            }
+            const size_t mark = pointer.size();
+            NamModel::appendPointerToken(pointer, it.key());
+            appendValue(out, source, it.value(), pointer, indent + kIndentStep);
+            pointer.resize(mark);
+        }
+        if (pretty) {
+            out += '\n';
+            out.append(static_cast<size_t>(indent), ' ');
+        }
+        out += '}';
+        return;
+    }
+
+    if (value.is_array()) {
+        if (value.empty()) {
+            out += "[]";
+            return;
+        }
+        const std::string itemIndent(pretty ? static_cast<size_t>(indent + kIndentStep) : 0, ' ');
+        out += pretty ? "[\n" : "[";
+        for (size_t i = 0; i < value.size(); ++i) {
+            if (i != 0) out += pretty ? ",\n" : ",";
+            out += itemIndent;
+            const size_t mark = pointer.size();
+            NamModel::appendPointerToken(pointer, std::to_string(i));
+            appendValue(out, source, value[i], pointer, indent + kIndentStep);
+            pointer.resize(mark);
+        }
+        if (pretty) {
+            out += '\n';
+            out.append(static_cast<size_t>(indent), ' ');
+        }
+        out += ']';
+        return;
+    }
+
+    out += value.dump();
+}
+
+} // namespace
+
+// Mirrors nlohmann's serializer for a float stored as a JSON number (i.e. widened to double).
+void NamWriter::appendFloat(std::string& out, float value) {
+    const double d = static_cast<double>(value);
+    if (!std::isfinite(d)) {
+        out += "null";
+        return;
+    }
+    std::array<char, 64> buffer{};
+    char* end = nlohmann::detail::to_chars(buffer.data(), buffer.data() + buffer.size(), d);
+    out.append(buffer.data(), static_cast<size_t>(end - buffer.data()));
+}
+
+// Shortest round-trip form (std::to_chars without a precision). At most 9 significant
+// digits, so reading it as a double first and narrowing still lands on the same float.
+void NamWriter::appendShortestFloat(std::string& out, float value) {
+    if (!std::isfinite(value)) {
+        out += "null";
+        return;
+    }
+    std::array<char, 32> buffer{};
+    const auto result = std::to_chars(buffer.data(), buffer.data() + buffer.size(), value);
+    out.append(buffer.data(), static_cast<size_t>(result.ptr - buffer.data()));
+}
+
+void NamWriter::appendWeight(std::string& out, float value, NamOutputFormat format) {
+    if (format == NamOutputFormat::Compact) {
+        appendShortestFloat(out, value);
+    } else {
+        appendFloat(out, value);
+    }
+}
+
+bool NamWriter::tryParseFormat(std::string_view name, NamOutputFormat& format) {
+    if (name == "pretty") {
+        format = NamOutputFormat::Pretty;
+        return true;
+    }
+    if (name == "compact") {
+        format = NamOutputFormat::Compact;
+        return true;
+    }
+    return false;
+}
+
+static std::string dumpDocument(const WeightSource& source, const nlohmann::json& document) {
+    StatsTimer timer(StatsStage::Serialize);
+    size_t weightCount = 0;
+    for (const auto& weights : source.model.weightArrays) weightCount += weights.values.size();
+    Stats::count(StatsCounter::WeightsVisited, weightCount);
+
+    std::string out;
+    // Roughly indentation + ~20 digits + separator per weight; compact needs ~12.
+    out.reserve(weightCount * (source.format == NamOutputFormat::Compact ? 12 : 32) + 4096);
+    std::string pointer;
+    appendValue(out, source, document, pointer, 0);
+    return out;
+}
+
+std::string NamWriter::dump(const NamModel& model, NamOutputFormat format) {
+    return dumpDocument(WeightSource{model, nullptr, format}, model.document);
+}
+
+std::string NamWriter::dump(const NamModelVariant& variant, NamOutputFormat format) {
+    return dumpDocument(WeightSource{*variant.base, &variant, format}, variant.document);
+}
+
+static void appendLittleEndian(std::string& out, uint64_t value, size_t size) {
+    for (size_t i = 0; i < size; ++i) out += static_cast<char>((value >> (8 * i)) & 0xff);
+}
+
+static std::string dumpBinaryDocument(const WeightSource& source, const nlohmann::json& document) {
+    StatsTimer timer(StatsStage::Serialize);
+    nlohmann::json header;
+    header["document"] = document;
+    nlohmann::json table = nlohmann::json::array();
+    size_t dataSize = 0;
+    for (const auto& weights : source.model.weightArrays) {
+        dataSize = NamBinary::alignUp(dataSize);
+        table.push_back({{"owner", weights.ownerPointer}, {"offset", dataSize}, {"count", weights.values.size()}});
+        dataSize += weights.values.size() * sizeof(float);
+    }
+    header["weights"] = std::move(table);
+    const std::string headerText = header.dump();
+
+    const size_t dataStart = NamBinary::alignUp(NamBinary::kPrefixSize + headerText.size());
+    std::string out;
+    out.reserve(dataStart + dataSize);
+    out.append(NamBinary::kMagic, sizeof(NamBinary::kMagic));
+    appendLittleEndian(out, NamBinary::kVersion, 4);
+    appendLittleEndian(out, headerText.size(), 8);
+    out += headerText;
+    out.resize(dataStart + dataSize, '\0');
+
+    // Little-endian float32, as on every supported target; overlays are copied over the
+    // base values they replace.
+    char* data = out.data() + dataStart;
+    size_t offset = 0;
+    for (size_t a = 0; a < source.model.weightArrays.size(); ++a) {
+        const auto& values = source.model.weightArrays[a].values;
+        offset = NamBinary::alignUp(offset);
+        if (!values.empty()) std::memcpy(data + offset, values.data(), values.size() * sizeof(float));
+        const NamWeightOverlay* overlay = source.variant != nullptr ? source.variant->findOverlay(a) : nullptr;
+        if (overlay != nullptr && !overlay->values.empty()) {
+            std::memcpy(data + offset + overlay->start * sizeof(float), overlay->values.data(),
+                        overlay->values.size() * sizeof(float));
+        }
+        offset += values.size() * sizeof(float);
+        Stats::count(StatsCounter::WeightsVisited, values.size());
+    }
+    return out;
+}
+
+std::string NamWriter::dumpBinary(const NamModel& model) {
+    return dumpBinaryDocument(WeightSource{model, nullptr, NamOutputFormat::Compact}, model.document);
+}
+
+std::string NamWriter::dumpBinary(const NamModelVariant& variant) {
+    return dumpBinaryDocument(WeightSource{*variant.base, &variant, NamOutputFormat::Compact}, variant.document);
+}
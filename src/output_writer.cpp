@@ -0,0 +1,840 @@
+#include "output_writer.h"
+#include "run_stats.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+#include <utility>
+
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(__EMSCRIPTEN__)
+#define NAM_OUTPUT_HAVE_POSIX 1
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+#endif
+
+// The raw interface is used (no liburing dependency). IORING_FEAT_NATIVE_WORKERS marks
+// 5.12+ headers, which define every opcode used here; the running kernel is probed too.
+#if defined(NAM_OUTPUT_HAVE_POSIX) && defined(__linux__)
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
+#if defined(NAM_OUTPUT_HAVE_POSIX) && defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#if defined(IORING_FEAT_NATIVE_WORKERS)
+#define NAM_OUTPUT_HAVE_IO_URING 1
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+namespace {
+
+struct PendingFile {
+    OutputWrite write;
+    std::string tempPath;
+    size_t size = 0;
+#if defined(NAM_OUTPUT_HAVE_POSIX)
+    int fd = -1;
+    bool created = false;
+    std::vector<iovec> iov;
+    size_t written = 0;
+    // Created from write.sourcePath instead of being written.
+    bool placed = false;
+#endif
+};
+
+std::string openError(const PendingFile& file) {
+    return "Error: Failed to open output file for writing: " + file.write.finalPath;
+}
+
+std::string writeError(const PendingFile& file) {
+    return "Error: Failed while writing output file: " + file.write.finalPath;
+}
+
+std::string renameError(const PendingFile& file, const std::string& detail) {
+    return "Error: Failed to save output file: " + file.write.finalPath + ": " + detail;
+}
+
+size_t totalSize(const std::vector<std::string_view>& pieces) {
+    size_t size = 0;
+    for (const auto& piece : pieces) size += piece.size();
+    return size;
+}
+
+#if defined(NAM_OUTPUT_HAVE_POSIX)
+
+// Drops the first bytes of iov starting at next: skips fully written buffers and trims a
+// partially written one. Returns the new next.
+size_t consumeIov(std::vector<iovec>& iov, size_t next, size_t bytes) {
+    while (bytes > 0 && next < iov.size()) {
+        if (bytes >= iov[next].iov_len) {
+            bytes -= iov[next].iov_len;
+            ++next;
+        } else {
+            iov[next].iov_base = static_cast<char*>(iov[next].iov_base) + bytes;
+            iov[next].iov_len -= bytes;
+            bytes = 0;
+        }
+    }
+    return next;
+}
+
+// Writes iov[next..] at the current file offset, in batches of at most IOV_MAX.
+bool writeIov(int fd, std::vector<iovec>& iov, size_t next) {
+    while (next < iov.size()) {
+        const int batch = static_cast<int>(std::min<size_t>(iov.size() - next, IOV_MAX));
+        const ssize_t written = ::writev(fd, iov.data() + next, batch);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        next = consumeIov(iov, next, static_cast<size_t>(written));
+    }
+    return true;
+}
+
+std::string parentDirectory(const std::string& path) {
+    const std::string parent = std::filesystem::path(path).parent_path().string();
+    return parent.empty() ? "." : parent;
+}
+
+// Copies all of in into out. Reads at explicit offsets from the start, so in's file offset
+// neither matters nor moves.
+bool copyContents(int in, int out) {
+    off_t offset = 0;
+#if defined(__linux__)
+    // In-kernel copy; falls through to read/write where unsupported (e.g. across filesystems).
+    for (;;) {
+        const ssize_t copied = ::copy_file_range(in, &offset, out, nullptr, size_t(1) << 30, 0);
+        if (copied == 0) return true;
+        if (copied < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EXDEV && errno != ENOSYS && errno != EINVAL && errno != EOPNOTSUPP) return false;
+            break;
+        }
+    }
+#endif
+    std::vector<char> buffer(size_t(1) << 20);
+    for (;;) {
+        const ssize_t got = ::pread(in, buffer.data(), buffer.size(), offset);
+        if (got == 0) return true;
+        if (got < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        offset += got;
+        for (ssize_t done = 0; done < got;) {
+            const ssize_t put = ::write(out, buffer.data() + done, static_cast<size_t>(got - done));
+            if (put < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            done += put;
+        }
+    }
+}
+
+// Creates target with the contents of the open file in: a reflink sharing its extents where
+// the filesystem supports it, else a byte copy. Never a hard link, so target gets its own
+// permissions and changing them leaves the source alone. Fails if target already exists.
+bool placeFile(int in, const std::string& target) {
+#if defined(FICLONE)
+    {
+        const int out = ::open(target.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+        if (out >= 0) {
+            if (::ioctl(out, FICLONE, in) == 0) return ::close(out) == 0;
+            ::close(out);
+            ::unlink(target.c_str());
+        }
+    }
+#endif
+    const int out = ::open(target.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+    if (out < 0) return false;
+    bool ok = copyContents(in, out);
+    ok = ::close(out) == 0 && ok;
+    if (!ok) ::unlink(target.c_str());
+    return ok;
+}
+
+bool placeFile(const std::string& source, const std::string& target) {
+    const int in = ::open(source.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) return false;
+    const bool ok = placeFile(in, target);
+    ::close(in);
+    return ok;
+}
+
+// Distinguishes the cache-copy temp files of writers in the same process.
+std::atomic<uint64_t> gCopySerial{0};
+
+// Makes renames in dir durable. Best effort: some filesystems refuse fsync on directories.
+void syncDirectory(const std::string& dir) {
+    const int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return;
+    ::fsync(fd);
+    ::close(fd);
+}
+
+#endif
+
+#if defined(NAM_OUTPUT_HAVE_IO_URING)
+
+// Minimal single-threaded io_uring: each call to run() submits the prepared entries and
+// waits for all of their completions.
+class Ring {
+public:
+    static constexpr unsigned kEntries = OutputWriter::kMaxBatchFiles;
+
+    bool init() {
+        io_uring_params params{};
+        fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, kEntries, &params));
+        if (fd_ < 0) return false;
+        if (!supportsOps() || (params.features & IORING_FEAT_SINGLE_MMAP) == 0) {
+            release();
+            return false;
+        }
+
+        ringSize_ = std::max(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                             params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+        ring_ = ::mmap(nullptr, ringSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+        if (ring_ == MAP_FAILED) {
+            ring_ = nullptr;
+            release();
+            return false;
+        }
+        sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = ::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            release();
+            return false;
+        }
+        sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+        char* base = static_cast<char*>(ring_);
+        sqTail_ = reinterpret_cast<unsigned*>(base + params.sq_off.tail);
+        sqMask_ = *reinterpret_cast<unsigned*>(base + params.sq_off.ring_mask);
+        sqArray_ = reinterpret_cast<unsigned*>(base + params.sq_off.array);
+        cqHead_ = reinterpret_cast<unsigned*>(base + params.cq_off.head);
+        cqTail_ = reinterpret_cast<unsigned*>(base + params.cq_off.tail);
+        cqMask_ = *reinterpret_cast<unsigned*>(base + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(base + params.cq_off.cqes);
+        return true;
+    }
+
+    ~Ring() { release(); }
+
+    // Zeroed entry whose completion result lands in results[slot].
+    io_uring_sqe& prepare(uint8_t opcode, size_t slot) {
+        const unsigned tail = *sqTail_ + pending_;
+        const unsigned index = tail & sqMask_;
+        io_uring_sqe& sqe = sqes_[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = opcode;
+        sqe.user_data = slot;
+        sqArray_[index] = index;
+        ++pending_;
+        return sqe;
+    }
+
+    // Submits everything prepared and waits for it. results[slot] receives each result
+    // (-errno on failure). Returns false if the ring itself failed; results are then
+    // -EIO for every entry that did not complete.
+    bool run(std::vector<int>& results) {
+        const unsigned count = pending_;
+        std::atomic_ref<unsigned>(*sqTail_).store(*sqTail_ + count, std::memory_order_release);
+        pending_ = 0;
+
+        unsigned toSubmit = count;
+        unsigned completed = 0;
+        bool ok = true;
+        while (completed < count) {
+            const long entered = ::syscall(__NR_io_uring_enter, fd_, toSubmit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (entered < 0) {
+                if (errno == EINTR || errno == EAGAIN || errno == EBUSY) continue;
+                ok = false;
+                break;
+            }
+            toSubmit -= std::min<unsigned>(toSubmit, static_cast<unsigned>(entered));
+            completed += reap(results);
+        }
+        if (!ok) {
+            for (int& result : results) {
+                if (result == kPending) result = -EIO;
+            }
+        }
+        return ok;
+    }
+
+    // Marks every result as not completed yet.
+    static void resetResults(std::vector<int>& results, size_t count) { results.assign(count, kPending); }
+
+private:
+    static constexpr int kPending = INT_MIN;
+
+    unsigned reap(std::vector<int>& results) {
+        unsigned reaped = 0;
+        unsigned head = *cqHead_;
+        const unsigned tail = std::atomic_ref<unsigned>(*cqTail_).load(std::memory_order_acquire);
+        for (; head != tail; ++head, ++reaped) {
+            const io_uring_cqe& cqe = cqes_[head & cqMask_];
+            if (cqe.user_data < results.size()) results[cqe.user_data] = cqe.res;
+        }
+        std::atomic_ref<unsigned>(*cqHead_).store(head, std::memory_order_release);
+        return reaped;
+    }
+
+    bool supportsOps() {
+        constexpr unsigned kProbeOps = 256;
+        std::vector<char> buffer(sizeof(io_uring_probe) + kProbeOps * sizeof(io_uring_probe_op), 0);
+        auto* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+        if (::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PROBE, probe, kProbeOps) < 0) return false;
+        for (const unsigned op : {IORING_OP_OPENAT, IORING_OP_WRITEV, IORING_OP_FSYNC, IORING_OP_CLOSE, IORING_OP_RENAMEAT}) {
+            if (op > probe->last_op || (probe->ops[op].flags & IO_URING_OP_SUPPORTED) == 0) return false;
+        }
+        return true;
+    }
+
+    void release() {
+        if (sqes_ != nullptr) ::munmap(sqes_, sqesSize_);
+        if (ring_ != nullptr) ::munmap(ring_, ringSize_);
+        if (fd_ >= 0) ::close(fd_);
+        sqes_ = nullptr;
+        ring_ = nullptr;
+        fd_ = -1;
+    }
+
+    int fd_ = -1;
+    void* ring_ = nullptr;
+    size_t ringSize_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sqesSize_ = 0;
+    unsigned* sqTail_ = nullptr;
+    unsigned sqMask_ = 0;
+    unsigned* sqArray_ = nullptr;
+    unsigned* cqHead_ = nullptr;
+    unsigned* cqTail_ = nullptr;
+    unsigned cqMask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+    unsigned pending_ = 0;
+};
+
+#endif
+
+} // namespace
+
+// Publishes one batch as a sequence of stages (open, write, sync, close, rename), each
+// applied to every file still in play. A failure at file i abandons files i and later, so
+// only a prefix of the batch is ever renamed into place.
+class OutputWriter::Engine {
+public:
+    Engine(SyncMode sync, OutputWriter::Backend backend) : sync_(sync) {
+#if defined(NAM_OUTPUT_HAVE_IO_URING)
+        if (backend == OutputWriter::Backend::Auto) {
+            auto ring = std::make_unique<Ring>();
+            if (ring->init()) ring_ = std::move(ring);
+        }
+#else
+        (void)backend;
+#endif
+    }
+
+    const char* name() const {
+#if defined(NAM_OUTPUT_HAVE_IO_URING)
+        if (ring_) return "io_uring";
+#endif
+        return "thread";
+    }
+
+    // Returns how many files (a prefix of batch) were published; error describes the first
+    // file that was not.
+    size_t publish(std::vector<OutputWrite>& batch, std::string& error) {
+        files_.clear();
+        files_.resize(batch.size());
+        for (size_t i = 0; i < batch.size(); ++i) {
+            files_[i].write = std::move(batch[i]);
+            files_[i].tempPath = files_[i].write.finalPath + ".tmp";
+            files_[i].size = totalSize(files_[i].write.pieces);
+        }
+        live_ = files_.size();
+        error_.clear();
+
+#if defined(NAM_OUTPUT_HAVE_POSIX)
+        placeAll();
+        openAll();
+        writeAll();
+        syncAll();
+        closeAll();
+        renameAll();
+        if (sync_ != SyncMode::None) {
+            for (const auto& dir : directories()) syncDirectory(dir);
+        }
+        storeCopies();
+#else
+        publishPortable();
+#endif
+        error = error_;
+        const size_t published = live_;
+        files_.clear();
+        return published;
+    }
+
+private:
+    // Records the failure of file i (if it is the earliest so far) and cuts files from i on.
+    void fail(size_t i, std::string message) {
+        if (i >= live_) return;
+#if defined(NAM_OUTPUT_HAVE_POSIX)
+        for (size_t j = i; j < live_; ++j) {
+            PendingFile& file = files_[j];
+            if (file.fd >= 0) ::close(file.fd);
+            file.fd = -1;
+            if (file.created) ::unlink(file.tempPath.c_str());
+            file.created = false;
+        }
+#endif
+        live_ = i;
+        error_ = std::move(message);
+    }
+
+#if defined(NAM_OUTPUT_HAVE_POSIX)
+    // Runs a stage either as one io_uring submission (prepare fills an entry per file) or
+    // as direct calls (call returns 0 or -errno). Returns per-file results. Placed files
+    // only take part in stages that pass includePlaced; they report 0 otherwise.
+    template <typename Prepare, typename Call>
+    const std::vector<int>& stage(Prepare prepare, Call call, bool includePlaced = false) {
+#if defined(NAM_OUTPUT_HAVE_IO_URING)
+        if (ring_) {
+            Ring::resetResults(results_, live_);
+            bool any = false;
+            for (size_t i = 0; i < live_; ++i) {
+                if (files_[i].placed && !includePlaced) {
+                    results_[i] = 0;
+                    continue;
+                }
+                prepare(*ring_, files_[i], i);
+                any = true;
+            }
+            if (any && !ring_->run(results_)) ring_.reset();  // fall back from now on
+            return results_;
+        }
+#else
+        (void)prepare;
+#endif
+        results_.assign(live_, 0);
+        for (size_t i = 0; i < live_; ++i) {
+            if (!files_[i].placed || includePlaced) results_[i] = call(files_[i]);
+        }
+        return results_;
+    }
+
+    // Distinct parent directories of the files still in play.
+    std::vector<std::string> directories() const {
+        std::vector<std::string> dirs;
+        for (size_t i = 0; i < live_; ++i) {
+            std::string dir = parentDirectory(files_[i].write.finalPath);
+            if (std::find(dirs.begin(), dirs.end(), dir) == dirs.end()) dirs.push_back(std::move(dir));
+        }
+        return dirs;
+    }
+
+    // Creates the temp files of writes that copy an existing file.
+    void placeAll() {
+        for (size_t i = 0; i < live_; ++i) {
+            PendingFile& file = files_[i];
+            if (file.write.sourcePath.empty()) continue;
+            ::unlink(file.tempPath.c_str());  // stale, e.g. left by an interrupted run
+            const bool ok = file.write.sourceFd >= 0 ? placeFile(file.write.sourceFd, file.tempPath)
+                                                     : placeFile(file.write.sourcePath, file.tempPath);
+            if (!ok) {
+                fail(i, writeError(file));
+                return;
+            }
+            file.created = true;
+            file.placed = true;
+            if (sync_ == SyncMode::File) {
+                const int fd = ::open(file.tempPath.c_str(), O_RDONLY | O_CLOEXEC);
+                const bool synced = fd >= 0 && ::fsync(fd) == 0;
+                if (fd >= 0) ::close(fd);
+                if (!synced) {
+                    fail(i, writeError(file));
+                    return;
+                }
+            }
+        }
+    }
+
+    // Best-effort copies of published files (see OutputWrite::copyPath), made read-only so
+    // that cache entries are not edited in place by accident.
+    void storeCopies() {
+        for (size_t i = 0; i < live_; ++i) {
+            const OutputWrite& write = files_[i].write;
+            if (write.copyPath.empty()) continue;
+            // Other runs may store the same entry at the same time: each uses its own temp
+            // file and the last rename wins, with identical bytes.
+            const std::string temp = write.copyPath + "." + std::to_string(::getpid()) + "."
+                + std::to_string(gCopySerial.fetch_add(1)) + ".tmp";
+            if (!placeFile(write.finalPath, temp)) continue;
+            if (::chmod(temp.c_str(), 0444) == 0 && ::rename(temp.c_str(), write.copyPath.c_str()) == 0) continue;
+            ::unlink(temp.c_str());
+        }
+    }
+
+    void openAll() {
+        constexpr int kFlags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+        const auto& results = stage(
+#if defined(NAM_OUTPUT_HAVE_IO_URING)
+            [](Ring& ring, PendingFile& file, size_t slot) {
+                io_uring_sqe& sqe = ring.prepare(IORING_OP_OPENAT, slot);
+                sqe.fd = AT_FDCWD;
+                sqe.addr = reinterpret_cast<uintptr_t>(file.tempPath.c_str());
+                sqe.len = 0666;
+                sqe.open_flags = kFlags;
+            },
+#else
+            nullptr,
+#endif
+            [](PendingFile& file) {
+                const int fd = ::open(file.tempPath.c_str(), kFlags, 0666);
+                return fd >= 0 ? fd : -errno;
+            });
+        size_t firstFailed = live_;
+        for (size_t i = 0; i < results.size(); ++i) {
+            if (files_[i].placed) continue;  // already created; the 0 result is not an fd
+            if (results[i] >= 0) {
+                files_[i].fd = results[i];
+                files_[i].created = true;
+            } else if (firstFailed == live_) {
+                firstFailed = i;
+            }
+        }
+        if (firstFailed < live_) fail(firstFailed, openError(files_[firstFailed]));
+    }
+
+    void writeAll() {
+        for (size_t i = 0; i < live_; ++i) {
+            PendingFile& file = files_[i];
+            file.iov.clear();
+            for (const auto& piece : file.write.pieces) {
+                if (!piece.empty()) file.iov.push_back(iovec{const_cast<char*>(piece.data()), piece.size()});
+            }
+        }
+        const auto& results = stage(
+#if defined(NAM_OUTPUT_HAVE_IO_URING)
+            [](Ring& ring, PendingFile& file, size_t slot) {
+                // Anything beyond IOV_MAX buffers (or a short write) is finished below.
+                io_uring_sqe& sqe = ring.prepare(IORING_OP_WRITEV, slot);
+                sqe.fd = file.fd;
+                sqe.addr = reinterpret_cast<uintptr_t>(file.iov.data());
+                sqe.len = static_cast<unsigned>(std::min<size_t>(file.iov.size(), IOV_MAX));
+                sqe.off = 0;
+            },
+#else
+            nullptr,
+#endif
+            [](PendingFile& file) {
+                if (!writeIov(file.fd, file.iov, 0)) return -EIO;
+                file.written = file.size;
+                return 0;
+            });
+        for (size_t i = 0; i < std::min(results.size(), live_); ++i) {
+            PendingFile& file = files_[i];
+            bool ok = results[i] >= 0;
+            // Direct calls record what they wrote; io_uring reports it as the result.
+            const size_t written = ok ? std::max(file.written, static_cast<size_t>(results[i])) : 0;
+            if (ok && written < file.size) {
+                ok = ::lseek(file.fd, static_cast<off_t>(written), SEEK_SET) >= 0
+                    && writeIov(file.fd, file.iov, consumeIov(file.iov, 0, written));
+            }
+            if (!ok) {
+                fail(i, writeError(file));
+                break;
+            }
+        }
+    }
+
+    void syncAll() {
+        if (sync_ == SyncMode::None) return;
+#if defined(__linux__)
+        if (sync_ == SyncMode::Batch) {
+            // One syncfs per directory's filesystem flushes the whole batch at once.
+            for (const auto& dir : directories()) {
+                const int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+                const bool synced = fd >= 0 && ::syncfs(fd) == 0;
+                if (fd >= 0) ::close(fd);
+                if (!synced) {
+                    // Attribute the failure to the first file in that directory.
+                    for (size_t i = 0; i < live_; ++i) {
+                        if (parentDirectory(files_[i].write.finalPath) == dir) {
+                            fail(i, writeError(files_[i]));
+                            break;
+                        }
+                    }
+                    return;
+                }
+            }
+            return;
+        }
+#endif
+        const auto& results = stage(
+#if defined(NAM_OUTPUT_HAVE_IO_URING)
+            [](Ring& ring, PendingFile& file, size_t slot) {
+                io_uring_sqe& sqe = ring.prepare(IORING_OP_FSYNC, slot);
+                sqe.fd = file.fd;
+            },
+#else
+            nullptr,
+#endif
+            [](PendingFile& file) { return ::fsync(file.fd) == 0 ? 0 : -errno; });
+        for (size_t i = 0; i < std::min(results.size(), live_); ++i) {
+            if (results[i] < 0) {
+                fail(i, writeError(files_[i]));
+                break;
+            }
+        }
+    }
+
+    void closeAll() {
+        const auto& results = stage(
+#if defined(NAM_OUTPUT_HAVE_IO_URING)
+            [](Ring& ring, PendingFile& file, size_t slot) {
+                io_uring_sqe& sqe = ring.prepare(IORING_OP_CLOSE, slot);
+                sqe.fd = file.fd;
+            },
+#else
+            nullptr,
+#endif
+            [](PendingFile& file) { return ::close(file.fd) == 0 ? 0 : -errno; });
+        // The descriptor is released even when close reports an error.
+        for (size_t i = 0; i < std::min(results.size(), live_); ++i) files_[i].fd = -1;
+        for (size_t i = 0; i < std::min(results.size(), live_); ++i) {
+            if (results[i] < 0) {
+                fail(i, writeError(files_[i]));
+                break;
+            }
+        }
+    }
+
+    void renameAll() {
+        const auto& results = stage(
+#if defined(NAM_OUTPUT_HAVE_IO_URING)
+            [this](Ring& ring, PendingFile& file, size_t slot) {
+                // Linked in order: a failed rename cancels the ones after it.
+                io_uring_sqe& sqe = ring.prepare(IORING_OP_RENAMEAT, slot);
+                sqe.fd = AT_FDCWD;
+                sqe.addr = reinterpret_cast<uintptr_t>(file.tempPath.c_str());
+                sqe.len = static_cast<unsigned>(AT_FDCWD);
+                sqe.addr2 = reinterpret_cast<uintptr_t>(file.write.finalPath.c_str());
+                if (slot + 1 < live_) sqe.flags |= IOSQE_IO_LINK;
+            },
+#else
+            nullptr,
+#endif
+            [](PendingFile& file) {
+                return ::rename(file.tempPath.c_str(), file.write.finalPath.c_str()) == 0 ? 0 : -errno;
+            },
+            true);
+        for (size_t i = 0; i < std::min(results.size(), live_); ++i) {
+            if (results[i] < 0) {
+                const std::string detail = std::error_code(-results[i], std::generic_category()).message();
+                fail(i, renameError(files_[i], detail));
+                break;
+            }
+            files_[i].created = false;
+        }
+    }
+#else
+    // Without POSIX I/O: a stream per file and std::filesystem::rename; sync modes are not
+    // supported by iostreams and are ignored.
+    void publishPortable() {
+        for (size_t i = 0; i < live_; ++i) {
+            PendingFile& file = files_[i];
+            std::error_code ec;
+            if (!file.write.sourcePath.empty()) {
+                std::filesystem::copy_file(file.write.sourcePath, file.tempPath,
+                                           std::filesystem::copy_options::overwrite_existing, ec);
+                // copy_file takes the source's permissions; outputs stay writable like rendered ones.
+                if (!ec) {
+                    std::filesystem::permissions(file.tempPath, std::filesystem::perms::owner_write,
+                                                 std::filesystem::perm_options::add, ec);
+                }
+                if (ec) {
+                    fail(i, writeError(file));
+                    return;
+                }
+            } else if (!writeStream(i)) {
+                return;
+            }
+            std::filesystem::rename(file.tempPath, file.write.finalPath, ec);
+            if (ec) {
+                const std::string detail = ec.message();
+                std::filesystem::remove(file.tempPath, ec);
+                fail(i, renameError(file, detail));
+                return;
+            }
+        }
+        for (size_t i = 0; i < live_; ++i) {
+            const OutputWrite& write = files_[i].write;
+            if (write.copyPath.empty()) continue;
+            std::error_code ec;
+            std::filesystem::copy_file(write.finalPath, write.copyPath, std::filesystem::copy_options::overwrite_existing, ec);
+        }
+    }
+
+    // Writes file i's pieces into its temp file; on failure records it and returns false.
+    bool writeStream(size_t i) {
+        PendingFile& file = files_[i];
+        std::ofstream out(file.tempPath, std::ios::binary);
+        if (!out.is_open()) {
+            fail(i, openError(file));
+            return false;
+        }
+        for (const auto& piece : file.write.pieces) out.write(piece.data(), static_cast<std::streamsize>(piece.size()));
+        out.flush();
+        const bool good = out.good();
+        out.close();
+        if (!good) {
+            std::error_code ec;
+            std::filesystem::remove(file.tempPath, ec);
+            fail(i, writeError(file));
+            return false;
+        }
+        return true;
+    }
+#endif
+
+    SyncMode sync_;
+#if defined(NAM_OUTPUT_HAVE_IO_URING)
+    std::unique_ptr<Ring> ring_;
+#endif
+    std::vector<PendingFile> files_;
+    std::vector<int> results_;
+    size_t live_ = 0;
+    std::string error_;
+};
+
+OutputWriter::OutputWriter(SyncMode sync, Backend backend)
+    : sync_(sync), engine_(std::make_unique<Engine>(sync, backend)) {
+    thread_ = std::thread([this] { writerLoop(); });
+}
+
+OutputWriter::~OutputWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    queueChanged_.notify_all();
+    thread_.join();
+}
+
+bool OutputWriter::submit(OutputWrite write) {
+    const size_t bytes = totalSize(write.pieces);
+    std::unique_lock<std::mutex> lock(mutex_);
+    queueChanged_.wait(lock, [&] { return failed_ || queuedBytes_ == 0 || queuedBytes_ + bytes <= kMaxQueuedBytes; });
+    if (failed_) return false;
+    queuedBytes_ += bytes;
+    queue_.push_back(std::move(write));
+    lock.unlock();
+    queueChanged_.notify_all();
+    return true;
+}
+
+bool OutputWriter::finish(std::string& error) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    queueChanged_.wait(lock, [&] { return queue_.empty() && !busy_; });
+    if (failed_) {
+        error = error_;
+        return false;
+    }
+    return true;
+}
+
+size_t OutputWriter::publishedCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return published_;
+}
+
+const char* OutputWriter::backendName() const {
+    return engine_->name();
+}
+
+bool OutputWriter::tryParseSyncMode(std::string_view name, SyncMode& sync) {
+    if (name == "none") {
+        sync = SyncMode::None;
+    } else if (name == "file") {
+        sync = SyncMode::File;
+    } else if (name == "batch") {
+        sync = SyncMode::Batch;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void OutputWriter::writerLoop() {
+    std::vector<OutputWrite> batch;
+    for (;;) {
+        size_t bytes = 0;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            queueChanged_.wait(lock, [&] { return stopping_ || !queue_.empty(); });
+            if (queue_.empty()) return;
+            while (!queue_.empty() && batch.size() < kMaxBatchFiles) {
+                bytes += totalSize(queue_.front().pieces);
+                batch.push_back(std::move(queue_.front()));
+                queue_.pop_front();
+            }
+            busy_ = true;
+        }
+
+        std::vector<std::pair<StatsSink*, size_t>> stats;
+        if (std::any_of(batch.begin(), batch.end(), [](const OutputWrite& w) { return w.stats != nullptr; })) {
+            for (const auto& write : batch) stats.emplace_back(write.stats, totalSize(write.pieces));
+        }
+        const auto start = std::chrono::steady_clock::now();
+
+        std::string error;
+        const size_t count = batch.size();
+        const size_t published = engine_->publish(batch, error);
+        batch.clear();
+
+        // The files of a batch are written together, so each gets an equal share of its time.
+        if (!stats.empty()) {
+            const auto elapsed = std::chrono::steady_clock::now() - start;
+            const uint64_t share = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) / count;
+            for (size_t i = 0; i < stats.size(); ++i) {
+                StatsSink* sink = stats[i].first;
+                if (sink == nullptr) continue;
+                sink->add(StatsStage::Write, share);
+                if (i < published) {
+                    sink->add(StatsCounter::BytesWritten, stats[i].second);
+                    sink->add(StatsCounter::Outputs, 1);
+                }
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queuedBytes_ -= bytes;
+            published_ += published;
+            if (published < count && !failed_) {
+                failed_ = true;
+                error_ = std::move(error);
+                // Nothing after a failed file is published.
+                queue_.clear();
+                queuedBytes_ = 0;
+            }
+            busy_ = false;
+        }
+        queueChanged_.notify_all();
+    }
+}
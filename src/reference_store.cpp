@@ -0,0 +1,202 @@
+#include "reference_store.h"
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <nlohmann/json.hpp>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define NAM_REFERENCE_STORE_HAVE_FLOCK 1
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+using json = nlohmann::json;
+
+// Bumped when the meter or the line layout changes; older lines are then ignored.
+static constexpr int kStoreVersion = 1;
+static constexpr size_t kMinLinesToCompact = 64;
+
+static std::string entryLine(const std::string& key, const AudioLevels& levels) {
+    json line;
+    line["v"] = kStoreVersion;
+    line["key"] = key;
+    line["peak"] = levels.peak;
+    line["rms"] = levels.rms;
+    // JSON has no infinities: a silent model's loudness is written as null.
+    line["lufs"] = std::isfinite(levels.lufs) ? json(levels.lufs) : json(nullptr);
+    // Floats widen to doubles with 17 digits; 7 keep the file small and are plenty for levels.
+    json envelope = json::array();
+    for (float value : levels.envelope) {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.7g", static_cast<double>(value));
+        envelope.push_back(std::strtod(text, nullptr));
+    }
+    line["envelope"] = std::move(envelope);
+    return line.dump() + "\n";
+}
+
+// Reads every entry of path into entries (later lines win) and returns the number of lines.
+// A missing file has none; one that exists but cannot be opened throws.
+static size_t loadEntries(const std::string& path, std::unordered_map<std::string, AudioLevels>& entries) {
+    std::error_code ec;
+    if (!std::filesystem::exists(path, ec)) return 0;
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("Cannot open reference cache " + path);
+
+    size_t lines = 0;
+    std::string text;
+    while (std::getline(in, text)) {
+        ++lines;
+        const json line = json::parse(text, nullptr, false);
+        if (!line.is_object() || line.value("v", 0) != kStoreVersion || !line.contains("key")) continue;
+        try {
+            AudioLevels levels;
+            levels.peak = line.at("peak").get<double>();
+            levels.rms = line.at("rms").get<double>();
+            levels.lufs = line.at("lufs").is_null() ? -std::numeric_limits<double>::infinity()
+                                                    : line.at("lufs").get<double>();
+            levels.envelope = line.value("envelope", std::vector<float>());
+            entries[line.at("key").get<std::string>()] = std::move(levels);
+        } catch (const json::exception&) {
+            // A torn or hand-edited line: measured again and appended.
+        }
+    }
+    return lines;
+}
+
+namespace {
+
+// flock on "<store>.lock", which is never renamed: appends hold it shared, compaction
+// exclusive, so no line is appended to a file that is about to be replaced.
+class StoreLock {
+public:
+    StoreLock(const std::string& storePath, bool exclusive) {
+#if defined(NAM_REFERENCE_STORE_HAVE_FLOCK)
+        fd_ = ::open((storePath + ".lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+        if (fd_ < 0) return;
+        while (::flock(fd_, exclusive ? LOCK_EX : LOCK_SH) != 0) {
+            if (errno != EINTR) {
+                ::close(fd_);
+                fd_ = -1;
+                return;
+            }
+        }
+        locked_ = true;
+#else
+        (void)storePath;
+        (void)exclusive;
+        locked_ = true;  // no advisory locks: compaction still merges what is on disk
+#endif
+    }
+    ~StoreLock() {
+#if defined(NAM_REFERENCE_STORE_HAVE_FLOCK)
+        if (fd_ >= 0) ::close(fd_);  // releases the lock
+#endif
+    }
+    StoreLock(const StoreLock&) = delete;
+    StoreLock& operator=(const StoreLock&) = delete;
+
+    bool locked() const { return locked_; }
+
+private:
+    int fd_ = -1;
+    bool locked_ = false;
+};
+
+} // namespace
+
+ReferenceStore::ReferenceStore(std::string path) : path_(std::move(path)) {
+    lines_ = loadEntries(path_, entries_);
+}
+
+std::string ReferenceStore::makeKey(uint64_t contentHash, const StimulusSpec& stimulus, double sampleRate) {
+    std::ostringstream oss;
+    oss << std::hex << std::setw(16) << std::setfill('0') << contentHash << std::dec << '/' << stimulus.id() << '/'
+        << sampleRate;
+    return oss.str();
+}
+
+bool ReferenceStore::lookup(const std::string& key, AudioLevels& levels) const {
+    const auto it = entries_.find(key);
+    if (it == entries_.end()) return false;
+    levels = it->second;
+    return true;
+}
+
+void ReferenceStore::insert(const std::string& key, const AudioLevels& levels) {
+    entries_[key] = levels;
+    added_.push_back(key);
+}
+
+bool ReferenceStore::trySave(std::string& error) {
+    if (added_.empty()) return true;
+
+    const size_t lines = lines_ + added_.size();
+    if (lines >= kMinLinesToCompact && lines >= 2 * entries_.size()) {
+        StoreLock lock(path_, true);
+        if (!lock.locked()) {
+            error = "Cannot lock reference cache " + path_ + ".lock";
+            return false;
+        }
+        // Other runs may have appended since this one loaded the file: start from what is
+        // there now, with this run's new entries on top.
+        std::unordered_map<std::string, AudioLevels> merged;
+        try {
+            loadEntries(path_, merged);
+        } catch (const std::exception& e) {
+            error = e.what();
+            return false;
+        }
+        for (const auto& key : added_) merged[key] = entries_.at(key);
+        entries_ = std::move(merged);
+
+        const std::string temp = path_ + ".tmp";
+        {
+            std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+            for (const auto& [key, levels] : entries_) out << entryLine(key, levels);
+            if (!out.flush()) {
+                error = "Cannot write reference cache " + temp;
+                std::remove(temp.c_str());
+                return false;
+            }
+        }
+        std::error_code ec;
+        std::filesystem::rename(temp, path_, ec);
+        if (ec) {
+            error = "Cannot replace reference cache " + path_ + ": " + ec.message();
+            std::remove(temp.c_str());
+            return false;
+        }
+        lines_ = entries_.size();
+        added_.clear();
+        return true;
+    }
+
+    StoreLock lock(path_, false);
+    if (!lock.locked()) {
+        error = "Cannot lock reference cache " + path_ + ".lock";
+        return false;
+    }
+    // Unbuffered, so the lines go out in one append and do not interleave with another run's.
+    std::string text;
+    for (const auto& key : added_) text += entryLine(key, entries_.at(key));
+    std::ofstream out;
+    out.rdbuf()->pubsetbuf(nullptr, 0);
+    out.open(path_, std::ios::binary | std::ios::app);
+    out.write(text.data(), static_cast<std::streamsize>(text.size()));
+    if (!out.flush()) {
+        error = "Cannot append to reference cache " + path_;
+        return false;
+    }
+    lines_ = lines;
+    added_.clear();
+    return true;
+}
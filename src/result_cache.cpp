@@ -0,0 +1,201 @@
+#include "result_cache.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(__EMSCRIPTEN__)
+#define NAM_RESULT_CACHE_HAVE_POSIX 1
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr uint64_t kPrime1 = 11400714785074694791ULL;
+constexpr uint64_t kPrime2 = 14029467366897019727ULL;
+constexpr uint64_t kPrime3 = 1609587929392839161ULL;
+constexpr uint64_t kPrime4 = 9650029242287828579ULL;
+constexpr uint64_t kPrime5 = 2870177450012600261ULL;
+
+constexpr const char* kEntryExtension = ".entry";
+
+inline uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+// Little-endian loads (every supported target is little-endian).
+inline uint64_t read64(const unsigned char* p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t read32(const unsigned char* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t xxRound(uint64_t acc, uint64_t input) {
+    acc += input * kPrime2;
+    acc = rotl(acc, 31);
+    return acc * kPrime1;
+}
+
+inline uint64_t mergeRound(uint64_t acc, uint64_t value) {
+    acc ^= xxRound(0, value);
+    return acc * kPrime1 + kPrime4;
+}
+
+std::string toHex(uint64_t value) {
+    static const char kDigits[] = "0123456789abcdef";
+    std::string out(16, '0');
+    for (int i = 15; i >= 0; --i) {
+        out[static_cast<size_t>(i)] = kDigits[value & 0xf];
+        value >>= 4;
+    }
+    return out;
+}
+
+} // namespace
+
+CacheEntry::CacheEntry(std::string path, int fd) : path_(std::move(path)), fd_(fd) {}
+
+CacheEntry::~CacheEntry() {
+#if defined(NAM_RESULT_CACHE_HAVE_POSIX)
+    if (fd_ >= 0) ::close(fd_);
+#endif
+}
+
+ResultCache::ResultCache(std::string dir, uint64_t maxBytes) : dir_(std::move(dir)), maxBytes_(maxBytes) {
+    std::error_code ec;
+    std::filesystem::create_directories(dir_, ec);
+    if (!std::filesystem::is_directory(dir_, ec)) {
+        throw std::runtime_error("Cannot create cache directory: " + dir_);
+    }
+}
+
+uint64_t ResultCache::hash(std::string_view bytes, uint64_t seed) {
+    const auto* p = reinterpret_cast<const unsigned char*>(bytes.data());
+    const auto* const end = p + bytes.size();
+    uint64_t h;
+
+    if (bytes.size() >= 32) {
+        uint64_t v1 = seed + kPrime1 + kPrime2;
+        uint64_t v2 = seed + kPrime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - kPrime1;
+        const auto* const limit = end - 32;
+        do {
+            v1 = xxRound(v1, read64(p));
+            v2 = xxRound(v2, read64(p + 8));
+            v3 = xxRound(v3, read64(p + 16));
+            v4 = xxRound(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = mergeRound(h, v1);
+        h = mergeRound(h, v2);
+        h = mergeRound(h, v3);
+        h = mergeRound(h, v4);
+    } else {
+        h = seed + kPrime5;
+    }
+    h += static_cast<uint64_t>(bytes.size());
+
+    for (; p + 8 <= end; p += 8) {
+        h ^= xxRound(0, read64(p));
+        h = rotl(h, 27) * kPrime1 + kPrime4;
+    }
+    if (p + 4 <= end) {
+        h ^= static_cast<uint64_t>(read32(p)) * kPrime1;
+        h = rotl(h, 23) * kPrime2 + kPrime3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        h ^= *p * kPrime5;
+        h = rotl(h, 11) * kPrime1;
+    }
+
+    h ^= h >> 33;
+    h *= kPrime2;
+    h ^= h >> 29;
+    h *= kPrime3;
+    h ^= h >> 32;
+    return h;
+}
+
+std::string ResultCache::makeKey(uint64_t inputHash, std::string_view options) {
+    return toHex(inputHash) + toHex(hash(options, inputHash));
+}
+
+std::shared_ptr<const CacheEntry> ResultCache::lookup(const std::string& key) {
+    std::string path = entryPath(key);
+#if defined(NAM_RESULT_CACHE_HAVE_POSIX)
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || ::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        if (fd >= 0) ::close(fd);
+        ++misses_;
+        return nullptr;
+    }
+    ::futimens(fd, nullptr);
+#else
+    const int fd = -1;
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file(path, ec)) {
+        ++misses_;
+        return nullptr;
+    }
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+#endif
+    ++hits_;
+    return std::make_shared<const CacheEntry>(std::move(path), fd);
+}
+
+std::string ResultCache::entryPath(const std::string& key) const {
+    return (std::filesystem::path(dir_) / (key + kEntryExtension)).string();
+}
+
+void ResultCache::trim() {
+    struct Entry {
+        std::filesystem::file_time_type lastUsed;
+        uint64_t size;
+        std::filesystem::path path;
+    };
+    std::vector<Entry> entries;
+    uint64_t total = 0;
+    std::error_code iterEc;
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it(dir_, iterEc), end; !iterEc && it != end; it.increment(iterEc)) {
+        if (it->path().extension() != kEntryExtension || !it->is_regular_file(ec)) continue;
+        const uint64_t size = it->file_size(ec);
+        const auto lastUsed = it->last_write_time(ec);
+        if (ec) continue;
+        entries.push_back(Entry{lastUsed, size, it->path()});
+        total += size;
+    }
+    if (total <= maxBytes_) return;
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.lastUsed < b.lastUsed; });
+    for (const auto& entry : entries) {
+        if (total <= maxBytes_) break;
+        if (std::filesystem::remove(entry.path, ec)) {
+            total -= entry.size;
+            ++evicted_;
+        }
+    }
+}
+
+CacheStats ResultCache::stats() const {
+    CacheStats stats;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.evicted = evicted_;
+    return stats;
+}
@@ -0,0 +1,189 @@
+#include "run_stats.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(__EMSCRIPTEN__)
+#define NAM_STATS_HAVE_RUSAGE 1
+#include <sys/resource.h>
+#endif
+
+using json = nlohmann::json;
+
+static const char* const kStageNames[kStatsStageCount] = {"cache", "parse", "validate", "scale", "serialize", "write"};
+static const char* const kCounterNames[kStatsCounterCount] = {"bytes_read", "bytes_written", "weights_visited",
+                                                              "weights_scaled", "allocations", "outputs"};
+
+uint64_t Stats::peakRssBytes() {
+#if defined(NAM_STATS_HAVE_RUSAGE)
+    struct rusage usage {};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#if defined(__APPLE__)
+    return static_cast<uint64_t>(usage.ru_maxrss);  // bytes
+#else
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;  // kilobytes
+#endif
+#else
+    return 0;
+#endif
+}
+
+FileStats StatsSink::snapshot(const std::string& inputPath) const {
+    FileStats stats;
+    stats.inputPath = inputPath;
+    for (size_t i = 0; i < kStatsStageCount; ++i) stats.stageNs[i] = stageNs_[i].load(std::memory_order_relaxed);
+    for (size_t i = 0; i < kStatsCounterCount; ++i) stats.counters[i] = counters_[i].load(std::memory_order_relaxed);
+    return stats;
+}
+
+FileStats RunStats::total() const {
+    FileStats sum;
+    for (const auto& file : files) {
+        for (size_t i = 0; i < kStatsStageCount; ++i) sum.stageNs[i] += file.stageNs[i];
+        for (size_t i = 0; i < kStatsCounterCount; ++i) sum.counters[i] += file.counters[i];
+    }
+    return sum;
+}
+
+namespace {
+
+// Distribution of one stage's time over the files of a run.
+struct StageHistogram {
+    std::vector<uint64_t> sorted;
+
+    StageHistogram(const std::vector<FileStats>& files, size_t stage) {
+        for (const auto& file : files) sorted.push_back(file.stageNs[stage]);
+        std::sort(sorted.begin(), sorted.end());
+    }
+
+    // Nearest-rank percentile.
+    uint64_t percentile(double p) const {
+        if (sorted.empty()) return 0;
+        const size_t rank = static_cast<size_t>(std::ceil(p * static_cast<double>(sorted.size())));
+        return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+    }
+
+    // Files per power-of-two bucket of microseconds: bucket k holds times below 2^(k+1) us.
+    json buckets() const {
+        json out = json::array();
+        uint64_t upper = 2000;
+        size_t count = 0;
+        for (uint64_t ns : sorted) {
+            while (ns >= upper) {
+                if (count != 0) out.push_back({{"le_ns", upper}, {"count", count}});
+                count = 0;
+                upper *= 2;
+            }
+            ++count;
+        }
+        if (count != 0) out.push_back({{"le_ns", upper}, {"count", count}});
+        return out;
+    }
+};
+
+json fileJson(const FileStats& file) {
+    json out;
+    out["input"] = file.inputPath;
+    for (size_t i = 0; i < kStatsStageCount; ++i) out["stage_ns"][kStageNames[i]] = file.stageNs[i];
+    for (size_t i = 0; i < kStatsCounterCount; ++i) out[kCounterNames[i]] = file.counters[i];
+    return out;
+}
+
+FileStats fileFromJson(const json& in) {
+    FileStats file;
+    file.inputPath = in.at("input").get<std::string>();
+    for (size_t i = 0; i < kStatsStageCount; ++i) file.stageNs[i] = in.at("stage_ns").at(kStageNames[i]).get<uint64_t>();
+    for (size_t i = 0; i < kStatsCounterCount; ++i) file.counters[i] = in.at(kCounterNames[i]).get<uint64_t>();
+    return file;
+}
+
+std::string formatMs(uint64_t ns) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.3f", static_cast<double>(ns) / 1e6);
+    return buffer;
+}
+
+std::string formatMb(uint64_t bytes) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.1f MB", static_cast<double>(bytes) / (1024.0 * 1024.0));
+    return buffer;
+}
+
+} // namespace
+
+std::string RunStats::summary() const {
+    const FileStats sum = total();
+    std::string out = "Stats: " + std::to_string(files.size()) + " input(s), "
+        + std::to_string(sum.counter(StatsCounter::Outputs)) + " output(s) in " + formatMs(wallNs) + " ms";
+    if (peakRssBytes != 0) out += ", peak RSS " + formatMb(peakRssBytes);
+    out += "\n";
+
+    char line[160];
+    std::snprintf(line, sizeof(line), "  %-10s %12s %10s %10s %10s %10s\n", "stage", "total ms", "p50 ms", "p90 ms",
+                  "p99 ms", "max ms");
+    out += line;
+    for (size_t i = 0; i < kStatsStageCount; ++i) {
+        const StageHistogram histogram(files, i);
+        std::snprintf(line, sizeof(line), "  %-10s %12s %10s %10s %10s %10s\n", kStageNames[i],
+                      formatMs(sum.stageNs[i]).c_str(), formatMs(histogram.percentile(0.5)).c_str(),
+                      formatMs(histogram.percentile(0.9)).c_str(), formatMs(histogram.percentile(0.99)).c_str(),
+                      formatMs(histogram.percentile(1.0)).c_str());
+        out += line;
+    }
+    out += "  read " + formatMb(sum.counter(StatsCounter::BytesRead)) + ", wrote "
+        + formatMb(sum.counter(StatsCounter::BytesWritten)) + ", "
+        + std::to_string(sum.counter(StatsCounter::WeightsVisited)) + " weight(s) visited, "
+        + std::to_string(sum.counter(StatsCounter::WeightsScaled)) + " scaled, "
+        + std::to_string(sum.counter(StatsCounter::Allocations)) + " allocation(s)\n";
+
+    for (const auto& file : files) {
+        out += "  " + file.inputPath + ":";
+        for (size_t i = 0; i < kStatsStageCount; ++i) {
+            out += std::string(" ") + kStageNames[i] + " " + formatMs(file.stageNs[i]) + " ms"
+                + (i + 1 < kStatsStageCount ? "," : "");
+        }
+        out += "\n";
+    }
+    return out;
+}
+
+std::string RunStats::jsonLines() const {
+    std::string out;
+    for (const auto& file : files) {
+        json line = fileJson(file);
+        line["type"] = "file";
+        out += line.dump() + "\n";
+    }
+    json run = fileJson(total());
+    run.erase("input");
+    run["type"] = "run";
+    run["files"] = files.size();
+    run["wall_ns"] = wallNs;
+    run["peak_rss_bytes"] = peakRssBytes;
+    for (size_t i = 0; i < kStatsStageCount; ++i) {
+        const StageHistogram histogram(files, i);
+        run["histograms"][kStageNames[i]] = {{"p50_ns", histogram.percentile(0.5)}, {"p90_ns", histogram.percentile(0.9)},
+                                             {"p99_ns", histogram.percentile(0.99)}, {"max_ns", histogram.percentile(1.0)},
+                                             {"buckets", histogram.buckets()}};
+    }
+    out += run.dump() + "\n";
+    return out;
+}
+
+json RunStats::toJson() const {
+    json out;
+    out["files"] = json::array();
+    for (const auto& file : files) out["files"].push_back(fileJson(file));
+    out["wallNs"] = wallNs;
+    out["peakRssBytes"] = peakRssBytes;
+    return out;
+}
+
+RunStats RunStats::fromJson(const json& in) {
+    RunStats stats;
+    stats.collected = true;
+    for (const auto& file : in.at("files")) stats.files.push_back(fileFromJson(file));
+    stats.wallNs = in.at("wallNs").get<uint64_t>();
+    stats.peakRssBytes = in.at("peakRssBytes").get<uint64_t>();
+    return stats;
+}
@@ -0,0 +1,156 @@
+#include "thread_pool.h"
+#include <chrono>
+
+namespace {
+// Identifies the pool (and queue) owned by the current thread, if it is a pool worker.
+thread_local const ThreadPool* tlsPool = nullptr;
+thread_local size_t tlsQueueIndex = 0;
+}
+
+ThreadPool::ThreadPool(size_t workerCount) {
+    queues_.reserve(workerCount + 1);
+    for (size_t i = 0; i < workerCount + 1; ++i) {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+    workers_.reserve(workerCount);
+    for (size_t i = 0; i < workerCount; ++i) {
+        workers_.emplace_back([this, i] { workerLoop(i + 1); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+    // Without workers nobody else will drain the queues; run leftovers so no task is dropped.
+    Task task;
+    while (findTask(0, task)) {
+        task();
+    }
+}
+
+size_t ThreadPool::hardwareThreads() {
+    const unsigned n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : static_cast<size_t>(n);
+}
+
+void ThreadPool::submit(Task task) {
+    const size_t queueIndex = (tlsPool == this) ? tlsQueueIndex : 0;
+    {
+        std::lock_guard<std::mutex> lock(queues_[queueIndex]->mutex);
+        queues_[queueIndex]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        ++queued_;
+    }
+    wake_.notify_one();
+}
+
+bool ThreadPool::popFrom(size_t queueIndex, bool back, Task& task) {
+    Queue& q = *queues_[queueIndex];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (q.tasks.empty()) return false;
+    if (back) {
+        task = std::move(q.tasks.back());
+        q.tasks.pop_back();
+    } else {
+        task = std::move(q.tasks.front());
+        q.tasks.pop_front();
+    }
+    return true;
+}
+
+bool ThreadPool::findTask(size_t preferredQueue, Task& task) {
+    bool found = false;
+    // Own queue newest-first (cache-warm work), then steal oldest-first from everyone else.
+    if (preferredQueue != 0 && popFrom(preferredQueue, true, task)) {
+        found = true;
+    } else {
+        for (size_t offset = 0; offset < queues_.size() && !found; ++offset) {
+            const size_t victim = (preferredQueue + offset) % queues_.size();
+            if (victim == preferredQueue && preferredQueue != 0) continue;
+            found = popFrom(victim, false, task);
+        }
+    }
+    if (found) {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        --queued_;
+    }
+    return found;
+}
+
+bool ThreadPool::tryRunPendingTask() {
+    const size_t queueIndex = (tlsPool == this) ? tlsQueueIndex : 0;
+    Task task;
+    if (!findTask(queueIndex, task)) return false;
+    task();
+    return true;
+}
+
+void ThreadPool::workerLoop(size_t index) {
+    tlsPool = this;
+    tlsQueueIndex = index;
+    for (;;) {
+        Task task;
+        if (findTask(index, task)) {
+            task();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        wake_.wait(lock, [this] { return stopping_ || queued_ > 0; });
+        if (stopping_ && queued_ == 0) return;
+    }
+}
+
+TaskGroup::~TaskGroup() {
+    waitNoThrow();
+}
+
+void TaskGroup::run(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++pending_;
+    }
+    pool_.submit([this, task = std::move(task)] {
+        std::exception_ptr error;
+        try {
+            task();
+        } catch (...) {
+            error = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (error && !firstError_) firstError_ = error;
+        if (--pending_ == 0) done_.notify_all();
+    });
+}
+
+void TaskGroup::waitNoThrow() {
+    for (;;) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (pending_ == 0) return;
+        }
+        if (pool_.tryRunPendingTask()) continue;
+        // Nothing to help with: our remaining tasks are running elsewhere. Sleep briefly so
+        // that work they spawn into the pool can still be picked up by this thread.
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait_for(lock, std::chrono::milliseconds(1), [this] { return pending_ == 0; });
+    }
+}
+
+void TaskGroup::wait() {
+    waitNoThrow();
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        error = firstError_;
+        firstError_ = nullptr;
+    }
+    if (error) std::rethrow_exception(error);
+}
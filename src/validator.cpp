@@ -1,26 +1,18 @@
 #include "validator.h"
+#include "run_stats.h"
 #include <string>
-#include <regex>
 #include <cmath>
 
-bool Validator::validateNam(const nlohmann::json& j) {
+// Shared structural checks. Weight contents are checked by the caller-supplied
+// hasValidWeights(model, modelPointer), which is only called for model objects that
+// contain a "weights" key. error is only set for failures worth a specific message.
+template <typename WeightsCheck>
+static bool validateStructure(const nlohmann::json& j, const WeightsCheck& hasValidWeights, std::string& error) {
+    StatsTimer timer(StatsStage::Validate);
     if (!j.contains("version") || !j["version"].is_string()) return false;
-    std::string version = j["version"].get<std::string>();
-
-    // Validate semantic version format: "0.X.Y" where X and Y are integers
-    std::regex versionPattern(R"(^0\.\d+\.\d+$)");
-    if (!std::regex_match(version, versionPattern)) return false;
-
-    // Require minimum version 0.5.0
-    std::string minorPart = version.substr(2, version.find('.', 2) - 2);
-    int minor;
-    try {
-        minor = std::stoi(minorPart);
-    } catch (const std::out_of_range&) {
-        // Version number is too large to fit in int
-        return false;
-    }
-    if (minor < 5) return false;
+    // Semantic version "0.X.Y" with X >= 5 (minimum 0.5.0)
+    NamVersion version;
+    if (!Validator::tryCheckVersion(j["version"].get_ref<const std::string&>(), version, error)) return false;
 
     if (!j.contains("architecture") || !j["architecture"].is_string()) return false;
     if (!j.contains("config") || !j["config"].is_object()) return false;
@@ -30,14 +22,8 @@ bool Validator::validateNam(const nlohmann::json& j) {
 
     // A1 models (non-SlimmableContainer) require weights at top level
     if (arch != "SlimmableContainer") {
-        if (!j.contains("weights") || !j["weights"].is_array() || j["weights"].empty()) return false;
-
         // Validate weights are all numeric and finite (no NaN or Infinity)
-        for (const auto& w : j["weights"]) {
-            if (!w.is_number()) return false;
-            double value = w.get<double>();
-            if (!std::isfinite(value)) return false;  // Reject NaN, Infinity, -Infinity
-        }
+        if (!j.contains("weights") || !hasValidWeights(j, std::string())) return false;
 
         // Validate architecture-specific config fields for A1 models
         if (arch == "LSTM") {
@@ -66,23 +52,72 @@ bool Validator::validateNam(const nlohmann::json& j) {
         if (!j["config"].contains("submodels") || !j["config"]["submodels"].is_array()) return false;
         // Validate that submodels array is not empty and each has required structure
         if (j["config"]["submodels"].empty()) return false;
-        for (const auto& submodel_entry : j["config"]["submodels"]) {
+        const auto& submodels = j["config"]["submodels"];
+        for (size_t i = 0; i < submodels.size(); ++i) {
+            const auto& submodel_entry = submodels[i];
             if (!submodel_entry.is_object() || !submodel_entry.contains("model")) return false;
             const auto& model = submodel_entry["model"];
             if (!model.is_object() || !model.contains("architecture") || !model.contains("config") || !model.contains("weights")) {
                 return false;
             }
             // Validate submodel weights
-            if (!model["weights"].is_array() || model["weights"].empty()) {
-                return false;
-            }
-            for (const auto& w : model["weights"]) {
-                if (!w.is_number()) return false;
-                double value = w.get<double>();
-                if (!std::isfinite(value)) return false;
-            }
+            if (!hasValidWeights(model, "/config/submodels/" + std::to_string(i) + "/model")) return false;
         }
     }
 
     return true;
-}
\ No newline at end of file
+}
+
+bool Validator::tryCheckVersion(std::string_view text, NamVersion& version, std::string& error) {
+    if (tryParseVersion(text, version) && isSupportedVersion(version)) return true;
+    error = "Unsupported version \"" + std::string(text) + "\"; expected 0.X.Y, at least 0.5.0.";
+    return false;
+}
+
+bool Validator::validateNam(const nlohmann::json& j) {
+    std::string error;
+    return validateStructure(j, [](const nlohmann::json& model, const std::string&) {
+        const auto& weights = model["weights"];
+        if (!weights.is_array() || weights.empty()) return false;
+        for (const auto& w : weights) {
+            if (!w.is_number()) return false;
+            double value = w.get<double>();
+            if (!std::isfinite(value)) return false;  // Reject NaN, Infinity, -Infinity
+        }
+        return true;
+    }, error);
+}
+
+bool Validator::validateNamStructure(const nlohmann::json& document,
+                                     const std::function<bool(const std::string& modelPointer)>& hasValidWeights) {
+    std::string error;
+    return validateNamStructure(document, hasValidWeights, error);
+}
+
+bool Validator::validateNamStructure(const nlohmann::json& document,
+                                     const std::function<bool(const std::string& modelPointer)>& hasValidWeights,
+                                     std::string& error) {
+    return validateStructure(document, [&hasValidWeights](const nlohmann::json&, const std::string& modelPointer) {
+        return hasValidWeights(modelPointer);
+    }, error);
+}
+
+bool Validator::validateNam(const NamModel& model) {
+    std::string error;
+    return validateNam(model, error);
+}
+
+bool Validator::validateNam(const NamModel& model, std::string& error) {
+    return validateStructure(model.document, [&model, &error](const nlohmann::json&, const std::string& modelPointer) {
+        // Element contents were checked while parsing; only the recorded result is read here.
+        const NamWeightArray* weights = model.findWeights(modelPointer);
+        if (weights == nullptr) return false;
+        if (weights->firstInvalid != NamWeightArray::npos) {
+            error = "Weight at index " + std::to_string(weights->firstInvalid);
+            if (!modelPointer.empty()) error += " of " + modelPointer;
+            error += " is not a finite number.";
+            return false;
+        }
+        return !weights->values.empty();
+    }, error);
+}
@@ -0,0 +1,293 @@
+#include "verifier.h"
+#include "model_audio.h"
+#include "thread_pool.h"
+#include "mapped_file.h"
+#include "reference_store.h"
+#include "result_cache.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <regex>
+#include <sstream>
+
+static constexpr size_t kMinBlockSize = 64;
+static constexpr size_t kMaxBlockSize = 2048;
+static constexpr size_t kMaxVerifyJobs = 256;
+
+static bool parseNumber(const std::string& raw, double& out) {
+    char* end = nullptr;
+    out = std::strtod(raw.c_str(), &end);
+    return !raw.empty() && end == raw.c_str() + raw.size() && std::isfinite(out);
+}
+
+static bool parseCount(const std::string& raw, size_t min, size_t max, size_t& out) {
+    if (raw.empty() || !std::all_of(raw.begin(), raw.end(), [](char c) { return c >= '0' && c <= '9'; })) return false;
+    const unsigned long long value = std::strtoull(raw.c_str(), nullptr, 10);
+    if (value < min || value > max) return false;
+    out = static_cast<size_t>(value);
+    return true;
+}
+
+static double ratioDb(double value, double reference) {
+    if (value <= 0.0 || reference <= 0.0) return -std::numeric_limits<double>::infinity();
+    return 20.0 * std::log10(value / reference);
+}
+
+std::string Verifier::usage() {
+    return "Usage: nam-volume-knob verify --original <file> --scaled <file> [--scaled <file> ...] "
+           "[--expected-db <dB[,dB...]>] [--stimulus multitone|noise[:<dBFS>[:<seconds>]]] [--sample-rate <Hz>] "
+           "[--block-size <N>] [--jobs <N>] [--tolerance-db <dB>] [--reference-cache <file>]";
+}
+
+bool Verifier::tryParseArgs(int argc, char* argv[], VerifyOptions& options, std::string& error) {
+    for (int i = 2; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            options.showHelp = true;
+            return true;
+        }
+        if (arg != "--original" && arg != "--scaled" && arg != "--expected-db" && arg != "--stimulus"
+            && arg != "--sample-rate" && arg != "--block-size" && arg != "--jobs" && arg != "--tolerance-db"
+            && arg != "--reference-cache") {
+            error = "Error: Unknown option: " + arg + "\n" + usage();
+            return false;
+        }
+        if (i + 1 >= argc) {
+            error = "Error: Missing value for " + arg + ".\n" + usage();
+            return false;
+        }
+        const std::string raw = argv[++i];
+        if (arg == "--original") {
+            options.originalPath = raw;
+        } else if (arg == "--reference-cache") {
+            options.referenceCachePath = raw;
+        } else if (arg == "--scaled") {
+            options.scaledPaths.push_back(raw);
+        } else if (arg == "--expected-db") {
+            std::stringstream ss(raw);
+            std::string item;
+            while (std::getline(ss, item, ',')) {
+                double db = 0.0;
+                if (!parseNumber(item, db)) {
+                    error = "Error: Invalid value for --expected-db: " + raw + "\n" + usage();
+                    return false;
+                }
+                options.expectedDbs.push_back(static_cast<float>(db));
+            }
+        } else if (arg == "--stimulus") {
+            std::string err;
+            if (!TestSignal::tryParse(raw, options.stimulus, err)) {
+                error = "Error: " + err;
+                return false;
+            }
+        } else if (arg == "--sample-rate") {
+            if (!parseNumber(raw, options.sampleRate) || options.sampleRate < 8000.0 || options.sampleRate > 384000.0) {
+                error = "Error: Invalid value for --sample-rate: expected 8000 to 384000 Hz, got " + raw;
+                return false;
+            }
+        } else if (arg == "--block-size") {
+            if (!parseCount(raw, kMinBlockSize, kMaxBlockSize, options.blockSize)) {
+                error = "Error: Invalid value for --block-size: expected an integer from " + std::to_string(kMinBlockSize)
+                    + " to " + std::to_string(kMaxBlockSize) + ", got " + raw;
+                return false;
+            }
+        } else if (arg == "--jobs") {
+            if (!parseCount(raw, 0, kMaxVerifyJobs, options.jobs)) {
+                error = "Error: Invalid value for --jobs: expected an integer from 0 to " + std::to_string(kMaxVerifyJobs)
+                    + ", got " + raw;
+                return false;
+            }
+        } else if (!parseNumber(raw, options.toleranceDb) || options.toleranceDb <= 0.0) {
+            error = "Error: Invalid value for --tolerance-db: expected a number > 0, got " + raw;
+            return false;
+        }
+    }
+    if (options.originalPath.empty() || options.scaledPaths.empty()) {
+        error = "Error: --original and at least one --scaled are required.\n" + usage();
+        return false;
+    }
+    if (!options.expectedDbs.empty() && options.expectedDbs.size() != options.scaledPaths.size()) {
+        error = "Error: --expected-db needs one value per --scaled file (" + std::to_string(options.scaledPaths.size())
+            + "), got " + std::to_string(options.expectedDbs.size()) + ".";
+        return false;
+    }
+    return true;
+}
+
+bool Verifier::tryExpectedDbFromName(const std::string& path, float& gainDb) {
+    // formatGainForName in cli.cpp: dB gains are always signed, both kinds always have a
+    // decimal part, and a "_vN" collision suffix may follow.
+    static const std::regex pattern(R"(_([+-]?)(\d+)_(\d+)(db|lin)(_v\d+)?$)");
+    const std::string stem = std::filesystem::path(path).stem().string();
+    std::smatch match;
+    if (!std::regex_search(stem, match, pattern)) return false;
+    const bool linear = match[4] == "lin";
+    if (linear != match[1].str().empty()) return false;
+
+    double value = 0.0;
+    if (!parseNumber(match[1].str() + match[2].str() + "." + match[3].str(), value)) return false;
+    if (linear) {
+        if (value <= 0.0) return false;
+        value = 20.0 * std::log10(value);
+    }
+    gainDb = static_cast<float>(value);
+    return true;
+}
+
+void Verifier::compare(const AudioLevels& original, double toleranceDb, VerifiedModel& model) {
+    model.rmsDb = ratioDb(model.levels.rms, original.rms);
+    model.peakDb = ratioDb(model.levels.peak, original.peak);
+    model.lufsDb = model.levels.lufs - original.lufs;
+    // RMS over the whole stimulus: peaks depend on phase and LUFS on gating, RMS only on gain.
+    model.passed = std::isfinite(model.rmsDb) && std::fabs(model.rmsDb - model.expectedDb) <= toleranceDb;
+
+    // Hop by hop, ignoring hops 60 dB below the loudest where noise dominates the ratio.
+    model.envelopeErrorDb = 0.0;
+    if (model.levels.envelope.size() != original.envelope.size() || original.envelope.empty()) return;
+    const float loudest = *std::max_element(original.envelope.begin(), original.envelope.end());
+    for (size_t i = 0; i < original.envelope.size(); ++i) {
+        if (!(original.envelope[i] > loudest * 1e-3f)) continue;
+        const double hopDb = ratioDb(model.levels.envelope[i], original.envelope[i]);
+        model.envelopeErrorDb = std::max(model.envelopeErrorDb, std::fabs(hopDb - model.expectedDb));
+    }
+}
+
+VerifyResult Verifier::run(const VerifyOptions& options) {
+    VerifyResult result;
+    if (!ModelAudio::available()) {
+        result.exitCode = 2;
+        result.error = "Error: verify needs a build with NeuralAmpModelerCore "
+                       "(in third_party/, NAM_VOLUME_KNOB_WITH_NAM_CORE=ON).";
+        return result;
+    }
+
+    result.original.path = options.originalPath;
+    for (size_t i = 0; i < options.scaledPaths.size(); ++i) {
+        VerifiedModel model;
+        model.path = options.scaledPaths[i];
+        if (!options.expectedDbs.empty()) {
+            model.expectedDb = options.expectedDbs[i];
+        } else {
+            float gainDb = 0.0f;
+            if (!tryExpectedDbFromName(model.path, gainDb)) {
+                result.exitCode = 2;
+                result.error = "Error: Cannot tell the gain of " + model.path + " from its name; pass --expected-db.";
+                return result;
+            }
+            model.expectedDb = gainDb;
+        }
+        result.scaled.push_back(std::move(model));
+    }
+
+    // A cached reference saves the original's run, the largest share of verifying few outputs.
+    std::unique_ptr<ReferenceStore> store;
+    std::string referenceKey;
+    if (!options.referenceCachePath.empty()) {
+        try {
+            store = std::make_unique<ReferenceStore>(options.referenceCachePath);
+            const MappedFile original(options.originalPath);
+            referenceKey = ReferenceStore::makeKey(ResultCache::hash(original.view()), options.stimulus, options.sampleRate);
+        } catch (const std::exception& e) {
+            result.exitCode = 3;
+            result.error = std::string("Error: ") + e.what();
+            return result;
+        }
+        result.original.cached = store->lookup(referenceKey, result.original.levels);
+    }
+
+    const std::vector<double> stimulus = TestSignal::generate(options.stimulus, options.sampleRate);
+    std::vector<VerifiedModel*> models;
+    if (!result.original.cached) models.push_back(&result.original);
+    for (auto& model : result.scaled) models.push_back(&model);
+    std::vector<std::string> errors(models.size());
+    std::vector<char> failed(models.size(), 0);
+
+    const auto start = std::chrono::steady_clock::now();
+    {
+        const size_t jobs = options.jobs == 0 ? ThreadPool::hardwareThreads() : options.jobs;
+        ThreadPool pool(std::min(jobs, models.size()) - 1);  // the calling thread helps while it waits
+        TaskGroup tasks(pool);
+        for (size_t i = 0; i < models.size(); ++i) {
+            tasks.run([&, i] {
+                failed[i] = !ModelAudio::tryMeasure(models[i]->path, stimulus, options.sampleRate, options.blockSize,
+                                                    models[i]->levels, errors[i], &models[i]->processSeconds);
+            });
+        }
+        tasks.wait();
+    }
+    result.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (size_t i = 0; i < models.size(); ++i) {
+        if (failed[i]) {
+            result.exitCode = 3;
+            result.error = "Error: " + errors[i];
+            return result;
+        }
+    }
+    if (store && !result.original.cached) {
+        store->insert(referenceKey, result.original.levels);
+        // A cache that cannot be written only costs the next run time, so it does not fail this one.
+        std::string error;
+        if (!store->trySave(error)) result.warning = "Warning: " + error;
+    }
+    if (!(result.original.levels.rms > 0.0)) {
+        result.exitCode = 3;
+        result.error = "Error: " + options.originalPath + " is silent for the stimulus; nothing to compare against.";
+        return result;
+    }
+    for (auto& model : result.scaled) {
+        compare(result.original.levels, options.toleranceDb, model);
+        if (!model.passed) result.exitCode = 1;
+    }
+    return result;
+}
+
+std::string Verifier::report(const VerifyOptions& options, const VerifyResult& result) {
+    const double stimulusSeconds = std::round(options.stimulus.seconds * options.sampleRate) / options.sampleRate;
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2);
+    auto throughput = [&](const VerifiedModel& model) {
+        std::ostringstream oss;
+        oss << std::fixed << std::setprecision(1);
+        if (model.cached) {
+            oss << "cached";
+        } else if (model.processSeconds > 0.0) {
+            oss << stimulusSeconds / model.processSeconds << "x realtime, "
+                << stimulusSeconds * options.sampleRate / model.processSeconds / 1e6 << "M samples/s";
+        } else {
+            oss << "no time measured";
+        }
+        return oss.str();
+    };
+    auto dbfs = [](double value) { return value > 0.0 ? 20.0 * std::log10(value) : -std::numeric_limits<double>::infinity(); };
+
+    out << "Stimulus " << options.stimulus.id() << " at " << std::setprecision(0) << options.sampleRate << " Hz in "
+        << options.blockSize << "-frame blocks" << std::setprecision(2) << "\n";
+    const VerifiedModel& original = result.original;
+    out << "original  " << original.path << ": peak " << dbfs(original.levels.peak) << " dBFS, RMS "
+        << dbfs(original.levels.rms) << " dBFS, " << original.levels.lufs << " LUFS; " << throughput(original) << "\n";
+
+    size_t passed = 0;
+    for (const auto& model : result.scaled) {
+        if (model.passed) ++passed;
+        out << (model.passed ? "PASS" : "FAIL") << "      " << model.path << ": expected " << std::showpos
+            << model.expectedDb << " dB, measured " << model.rmsDb << " dB RMS, " << model.peakDb << " dB peak, "
+            << model.lufsDb << " LU" << std::noshowpos << ", worst 100 ms hop off by " << model.envelopeErrorDb
+            << " dB; " << throughput(model) << "\n";
+    }
+
+    const size_t runCount = result.scaled.size() + (result.original.cached ? 0 : 1);
+    const double totalSamples = stimulusSeconds * options.sampleRate * static_cast<double>(runCount);
+    out << passed << " of " << result.scaled.size() << " within " << options.toleranceDb << " dB; " << runCount
+        << " models run in " << std::setprecision(3) << result.wallSeconds << " s";
+    if (result.wallSeconds > 0.0) {
+        out << std::setprecision(1) << " (" << totalSamples / result.wallSeconds / 1e6 << "M samples/s overall)";
+    }
+    out << "\n";
+    return out.str();
+}
@@ -0,0 +1,376 @@
+#include "watcher.h"
+#include "mapped_file.h"
+#include "result_cache.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+#define NAM_WATCH_HAVE_INOTIFY 1
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#ifndef NAM_VOLUME_KNOB_VERSION
+#define NAM_VOLUME_KNOB_VERSION "dev"
+#endif
+
+static constexpr const char* kStateHeader = "nam-volume-knob watch state 1";
+static constexpr const char* kDefaultStateName = ".nam-volume-knob-watch";
+static constexpr size_t kMaxWatchJobs = 256;
+static constexpr size_t kMaxDebounceMs = 600000;
+
+static bool parseCount(const std::string& raw, size_t max, size_t& out) {
+    if (raw.empty() || raw.size() > 9 || !std::all_of(raw.begin(), raw.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+        return false;
+    }
+    const size_t value = std::strtoul(raw.c_str(), nullptr, 10);
+    if (value > max) return false;
+    out = value;
+    return true;
+}
+
+static bool isCandidate(const std::string& name) {
+    if (name.empty() || name[0] == '.') return false;  // hidden, and the CLI's own temp files
+    const std::string ext = std::filesystem::path(name).extension().string();
+    return ext == ".nam" || ext == ".namb";
+}
+
+static std::string toHex(uint64_t value) {
+    std::ostringstream oss;
+    oss << std::hex << std::setw(16) << std::setfill('0') << value;
+    return oss.str();
+}
+
+// Every option that changes the outputs of an input: a different key means every input is new.
+static std::string optionsKey(const CliArgs& args) {
+    std::ostringstream oss;
+    oss << std::setprecision(9) << "version=" << NAM_VOLUME_KNOB_VERSION << ";db=" << args.useDb << ";gains=";
+    for (float gain : args.useDb ? args.gainDbs : args.gainLinears) oss << gain << ',';
+    oss << ";sweep=" << args.gainSweep << ";lufs=" << (args.hasTargetLufs ? std::to_string(args.targetLufs) : "")
+        << ";match=" << args.matchToPath << ";surgical=" << args.surgical
+        << ";format=" << static_cast<int>(args.format) << ";container=" << static_cast<int>(args.container)
+        << ";convert=" << args.convertOnly << ";out=" << args.outputDir;
+    return std::string(kStateHeader) + " " + toHex(ResultCache::hash(oss.str()));
+}
+
+std::string FolderWatcher::usage() {
+    return "Usage: nam-volume-knob watch --input-dir <dir> --output-dir <dir> (--gain-db <dB[,dB...]> | ...) "
+           "[--jobs <N>] [--state-file <file>] [--debounce-ms <N>] [--rescan-s <N>] [--once] "
+           "[any other option of the main command except --input, --output and --server]";
+}
+
+bool FolderWatcher::tryParseArgs(int argc, char* argv[], WatchOptions& options, std::string& error) {
+    // Watch options are taken out here; the rest goes through the main command's parser.
+    std::vector<char*> forwarded = {argv[0]};
+    for (int i = 2; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            options.showHelp = true;
+            return true;
+        }
+        if (arg == "--input" || arg == "--output" || arg == "--server") {
+            error = "Error: " + arg + " cannot be used with watch.\n" + usage();
+            return false;
+        }
+        if (arg == "--once") {
+            options.once = true;
+            continue;
+        }
+        if (arg != "--input-dir" && arg != "--state-file" && arg != "--debounce-ms" && arg != "--rescan-s") {
+            forwarded.push_back(argv[i]);
+            continue;
+        }
+        if (i + 1 >= argc) {
+            error = "Error: Missing value for " + arg + ".\n" + usage();
+            return false;
+        }
+        const std::string raw = argv[++i];
+        if (arg == "--input-dir") {
+            options.inputDir = raw;
+        } else if (arg == "--state-file") {
+            options.statePath = raw;
+        } else if (arg == "--debounce-ms") {
+            if (!parseCount(raw, kMaxDebounceMs, options.debounceMs)) {
+                error = "Error: Invalid value for --debounce-ms: expected an integer from 0 to "
+                    + std::to_string(kMaxDebounceMs) + ", got " + raw;
+                return false;
+            }
+        } else if (!parseCount(raw, 86400, options.rescanSeconds)) {
+            error = "Error: Invalid value for --rescan-s: expected an integer from 0 to 86400, got " + raw;
+            return false;
+        }
+    }
+
+    CliParseResult parsed = CliHandler::parseArgs(static_cast<int>(forwarded.size()), forwarded.data(), false);
+    if (!parsed.ok) {
+        error = parsed.error;
+        return false;
+    }
+    options.args = std::move(parsed.args);
+    if (options.inputDir.empty() || options.args.outputDir.empty()) {
+        error = "Error: --input-dir and --output-dir are required.\n" + usage();
+        return false;
+    }
+    if (options.args.jobs > kMaxWatchJobs) options.args.jobs = kMaxWatchJobs;
+    return true;
+}
+
+FolderWatcher::FolderWatcher(WatchOptions options) : options_(std::move(options)), optionsKey_(optionsKey(options_.args)) {
+    if (options_.statePath.empty()) {
+        options_.statePath = (std::filesystem::path(options_.args.outputDir) / kDefaultStateName).string();
+    }
+    const size_t jobs = options_.args.jobs == 0 ? ThreadPool::hardwareThreads() : std::max<size_t>(options_.args.jobs, 1);
+    pool_ = std::make_unique<ThreadPool>(jobs - 1);  // the calling thread helps while it waits
+}
+
+FolderWatcher::~FolderWatcher() {
+#if defined(NAM_WATCH_HAVE_INOTIFY)
+    if (inotifyFd_ >= 0) ::close(inotifyFd_);
+    for (int fd : wakeFds_) {
+        if (fd >= 0) ::close(fd);
+    }
+#endif
+}
+
+bool FolderWatcher::tryStart(std::string& error) {
+    std::error_code ec;
+    if (!std::filesystem::is_directory(options_.inputDir, ec)) {
+        error = "Error: --input-dir is not a directory: " + options_.inputDir;
+        return false;
+    }
+    std::filesystem::create_directories(options_.args.outputDir, ec);
+    if (!std::filesystem::is_directory(options_.args.outputDir, ec)) {
+        error = "Error: Cannot create --output-dir " + options_.args.outputDir;
+        return false;
+    }
+    // Outputs landing in the watched directory would be picked up as new inputs.
+    if (std::filesystem::equivalent(options_.inputDir, options_.args.outputDir, ec)) {
+        error = "Error: --output-dir must differ from --input-dir.";
+        return false;
+    }
+    if (!tryLoadState(error)) return false;
+    if (options_.once) return true;
+
+#if defined(NAM_WATCH_HAVE_INOTIFY)
+    inotifyFd_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd_ < 0 || ::pipe2(wakeFds_, O_CLOEXEC | O_NONBLOCK) != 0) {
+        error = std::string("Error: Cannot start watching: ") + std::strerror(errno);
+        return false;
+    }
+    const uint32_t mask = IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE
+        | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+    if (::inotify_add_watch(inotifyFd_, options_.inputDir.c_str(), mask) < 0) {
+        error = "Error: Cannot watch " + options_.inputDir + ": " + std::strerror(errno);
+        return false;
+    }
+    return true;
+#else
+    error = "Error: watch needs inotify (Linux); use --once to process the directory and exit.";
+    return false;
+#endif
+}
+
+bool FolderWatcher::tryLoadState(std::string& error) {
+    std::ifstream in(options_.statePath, std::ios::binary);
+    std::string line;
+    if (in && std::getline(in, line) && line == optionsKey_) {
+        while (std::getline(in, line)) {
+            if (!line.empty()) processed_.insert(line);
+        }
+        return true;
+    }
+    in.close();
+
+    // Missing, unreadable or written for other options: start over.
+    std::ofstream out(options_.statePath, std::ios::binary | std::ios::trunc);
+    out << optionsKey_ << '\n';
+    if (!out.flush()) {
+        error = "Error: Cannot write state file " + options_.statePath;
+        return false;
+    }
+    return true;
+}
+
+bool FolderWatcher::recordProcessed(const std::string& key, std::string& error) {
+    std::lock_guard<std::mutex> lock(stateMutex_);
+    processed_.insert(key);
+    // Appended as each file finishes, so an interrupted watcher only repeats files in progress.
+    std::ofstream out(options_.statePath, std::ios::binary | std::ios::app);
+    out << key << '\n';
+    if (!out.flush()) {
+        error = "Error: Cannot write state file " + options_.statePath + "; the file will be processed again after a restart.";
+        return false;
+    }
+    return true;
+}
+
+std::vector<std::string> FolderWatcher::scan() const {
+    std::vector<std::string> paths;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(options_.inputDir, ec)) {
+        if (entry.is_regular_file(ec) && isCandidate(entry.path().filename().string())) {
+            paths.push_back(entry.path().string());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+std::vector<WatchedFile> FolderWatcher::processFiles(const std::vector<std::string>& paths) {
+    std::vector<WatchedFile> results(paths.size());
+    TaskGroup tasks(*pool_);
+    for (size_t i = 0; i < paths.size(); ++i) {
+        tasks.run([this, &paths, &results, i] {
+            WatchedFile& file = results[i];
+            file.inputPath = paths[i];
+            std::string key;
+            try {
+                const MappedFile input(file.inputPath, false);  // see CliArgs::readInputs
+                key = ResultCache::makeKey(ResultCache::hash(input.view()),
+                                           std::filesystem::path(file.inputPath).filename().string());
+            } catch (const std::exception&) {
+                // Deleted or renamed since its event: a later event covers its new name.
+                file.skipped = true;
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(stateMutex_);
+                file.skipped = processed_.count(key) != 0;
+            }
+            if (file.skipped) return;
+
+            CliArgs args = options_.args;
+            args.inputPaths = {file.inputPath};
+            args.jobs = 1;  // files are the unit of parallelism here
+            args.replaceOutputs = true;
+            args.readInputs = true;
+            CliRunResult result = CliHandler::run(args);
+            file.exitCode = result.exitCode;
+            file.error = std::move(result.error);
+            file.outputPaths = std::move(result.outputPaths);
+            if (file.exitCode == 0) recordProcessed(key, file.warning);
+        });
+    }
+    tasks.wait();
+    return results;
+}
+
+bool FolderWatcher::run(const std::function<void(const WatchedFile&)>& report, std::string& error) {
+    for (const auto& file : processFiles(scan())) {
+        if (!file.skipped) report(file);
+    }
+    if (options_.once) return true;
+    return watchLoop(report, error);
+}
+
+void FolderWatcher::stop() {
+    stopRequested_ = true;
+#if defined(NAM_WATCH_HAVE_INOTIFY)
+    if (wakeFds_[1] >= 0) {
+        const char byte = 1;
+        [[maybe_unused]] const ssize_t n = ::write(wakeFds_[1], &byte, 1);
+    }
+#endif
+}
+
+bool FolderWatcher::watchLoop(const std::function<void(const WatchedFile&)>& report, std::string& error) {
+#if defined(NAM_WATCH_HAVE_INOTIFY)
+    using Clock = std::chrono::steady_clock;
+    const auto debounce = std::chrono::milliseconds(options_.debounceMs);
+    // A file still open for writing may just be slow (e.g. a copy over the network), so it
+    // gets longer to settle than one its writer closed.
+    const auto openDebounce = std::max<Clock::duration>(debounce * 5, std::chrono::seconds(5));
+    const auto rescan = std::chrono::seconds(options_.rescanSeconds);
+    auto nextRescan = options_.rescanSeconds > 0 ? Clock::now() + rescan : Clock::time_point::max();
+
+    // Settle time per path; the map keeps them in name order when several are ready at once.
+    std::map<std::string, Clock::time_point> pending;
+    auto enqueueAll = [&](Clock::time_point at) {
+        for (const auto& path : scan()) pending.emplace(path, at);
+    };
+    alignas(inotify_event) char buffer[64 * 1024];
+
+    while (!stopRequested_) {
+        auto now = Clock::now();
+        std::vector<std::string> ready;
+        for (auto it = pending.begin(); it != pending.end();) {
+            if (it->second <= now) {
+                ready.push_back(it->first);
+                it = pending.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (!ready.empty()) {
+            for (const auto& file : processFiles(ready)) {
+                if (!file.skipped) report(file);
+            }
+            continue;
+        }
+
+        Clock::time_point wakeAt = nextRescan;
+        for (const auto& entry : pending) wakeAt = std::min(wakeAt, entry.second);
+        int timeoutMs = -1;
+        if (wakeAt != Clock::time_point::max()) {
+            const auto wait = std::chrono::ceil<std::chrono::milliseconds>(wakeAt - now).count();
+            timeoutMs = static_cast<int>(std::clamp<long long>(wait, 0, 24 * 3600 * 1000));
+        }
+        pollfd fds[2] = {{inotifyFd_, POLLIN, 0}, {wakeFds_[0], POLLIN, 0}};
+        if (::poll(fds, 2, timeoutMs) < 0) {
+            if (errno == EINTR) continue;
+            error = std::string("Error: Watching failed: ") + std::strerror(errno);
+            return false;
+        }
+        if (fds[1].revents != 0) break;
+
+        now = Clock::now();
+        if (now >= nextRescan) {
+            enqueueAll(now);
+            nextRescan = now + rescan;
+        }
+        if ((fds[0].revents & POLLIN) == 0) continue;
+
+        for (;;) {
+            const ssize_t n = ::read(inotifyFd_, buffer, sizeof(buffer));
+            if (n <= 0) break;
+            for (const char* p = buffer; p < buffer + n;) {
+                const auto* event = reinterpret_cast<const inotify_event*>(p);
+                p += sizeof(inotify_event) + event->len;
+                if (event->mask & IN_Q_OVERFLOW) {
+                    enqueueAll(now + debounce);  // events were lost; the state file skips what is done
+                    continue;
+                }
+                if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                    error = "Error: " + options_.inputDir + " was removed or moved.";
+                    return false;
+                }
+                if (event->len == 0 || !isCandidate(event->name)) continue;
+                const std::string path = (std::filesystem::path(options_.inputDir) / event->name).string();
+                if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                    pending.erase(path);
+                } else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                    pending[path] = now + debounce;
+                } else {
+                    pending[path] = now + openDebounce;
+                }
+            }
+        }
+    }
+    return true;
+#else
+    (void)report;
+    error = "Error: watch needs inotify (Linux); use --once to process the directory and exit.";
+    return false;
+#endif
+}
@@ -1,21 +1,25 @@
 #include <emscripten/bind.h>
+#include <emscripten/val.h>
 #include "nam_parser.h"
+#include "nam_writer.h"
 #include "weight_scaler.h"
 #include "validator.h"
 #include <iostream>
 #include <cmath>
 #include <algorithm>
+#include <cstdint>
 #include <iomanip>
+#include <memory>
 #include <sstream>
 
 // Gain limits (must match CLI limits for consistency)
 static constexpr float kMaxGainDb = 9.0f;
 static constexpr float kMaxGainLinear = 2.8183829312644537f;  // pow(10, 9/20)
 
-std::string processNam(const std::string& jsonStr, float factor, float gainDb) {
-    // Important: the shipped wasm may be built without exception catching.
-    // Avoid throwing C++ exceptions here; return "Error: ..." strings instead.
+// Important: the shipped wasm may be built without exception catching.
+// Avoid throwing C++ exceptions here; return "Error: ..." strings instead.
 
+static std::string checkGain(float factor, float gainDb) {
     // Validate gain parameters (defensive programming - web layer should also validate)
     if (!std::isfinite(factor) || factor <= 0.0f || factor > kMaxGainLinear) {
         return "Error: Gain factor must be > 0 and <= " + std::to_string(kMaxGainLinear);
@@ -23,54 +27,191 @@ std::string processNam(const std::string& jsonStr, float factor, float gainDb) {
     if (!std::isfinite(gainDb) || gainDb > kMaxGainDb) {
         return "Error: Gain must be <= " + std::to_string(kMaxGainDb) + " dB";
     }
+    return std::string();
+}
 
-    auto j = nlohmann::json::parse(jsonStr, nullptr, false);
-    if (j.is_discarded()) {
-        return "Error: Failed to parse JSON.";
+// Streaming parse: weights are converted to floats and checked for finiteness in the
+// same pass, so validation and scaling below never walk the whole array again.
+static std::string loadModel(std::string_view bytes, NamModel& model) {
+    std::string err;
+    if (!NamParser::tryParseNamModel(bytes, model, err)) {
+        return "Error: " + err;
     }
-
-    if (!Validator::validateNam(j)) {
-        return "Error: Invalid .nam file format (missing required fields or corrupted).";
+    if (!Validator::validateNam(model, err)) {
+        std::string message = "Error: Invalid .nam file format (missing required fields or corrupted).";
+        if (!err.empty()) message += " " + err;
+        return message;
     }
+    return std::string();
+}
 
-    // Validation passed; extract guaranteed-safe fields
-    const std::string arch = j["architecture"].get<std::string>();
-    const auto& config = j["config"];
+// Scales one gain of a validated model into a copy-on-write variant and serializes it.
+static std::string renderVariant(const std::shared_ptr<const NamModel>& model, float factor, float gainDb,
+                                 NamOutputFormat format, std::string& out) {
+    NamModelVariant variant(model);
+    const std::string arch = variant.document["architecture"].get<std::string>();
+    std::string err;
 
     // Handle A2 (SlimmableContainer) models differently from flat architectures
     if (arch == "SlimmableContainer") {
-        std::string err;
-        if (!WeightScaler::tryScaleA2Model(j, factor, err)) {
+        if (!WeightScaler::tryScaleA2Model(variant, factor, err)) {
             return "Error: " + err;
         }
     } else {
-        // Convert weights to float vector safely (no exceptions).
-        std::vector<float> weightsVec;
-        weightsVec.reserve(j["weights"].size());
-        for (const auto& w : j["weights"]) {
-            if (!w.is_number()) {
-                return "Error: Weights array contains non-numeric value(s).";
-            }
-            weightsVec.push_back(static_cast<float>(w.get<double>()));
+        size_t weightCount = 0;
+        if (!variant.tryGetWeightCount("", weightCount)) {
+            return "Error: Model missing or invalid weights array.";
         }
 
         size_t start = 0;
         size_t end = 0;
-        std::string err;
-        if (!WeightScaler::tryGetHeadWeightIndices(arch, config, weightsVec.size(), start, end, err)) {
+        if (!WeightScaler::tryGetHeadWeightIndices(arch, variant.document["config"], weightCount, start, end, err)) {
             return "Error: " + err;
         }
 
-        WeightScaler::scaleWeights(weightsVec, start, end, factor);
-        j["weights"] = weightsVec;
+        if (!WeightScaler::tryScaleWeights(variant, "", start, end, factor, err)) {
+            return "Error: " + err;
+        }
 
         // Update metadata to reflect the scaling
-        WeightScaler::updateMetadata(j, gainDb);
+        WeightScaler::updateMetadata(variant.document, gainDb);
+    }
+
+    out = NamWriter::dump(variant, format);
+    return std::string();
+}
+
+// format is "pretty" (dump(4) layout) or "compact" (no whitespace, shortest round-trip weights).
+std::string processNam(const std::string& jsonStr, float factor, float gainDb, const std::string& format) {
+    NamOutputFormat outputFormat;
+    if (!NamWriter::tryParseFormat(format, outputFormat)) {
+        return "Error: Output format must be \"compact\" or \"pretty\".";
+    }
+    std::string error = checkGain(factor, gainDb);
+    if (!error.empty()) return error;
+
+    auto model = std::make_shared<NamModel>();
+    error = loadModel(jsonStr, *model);
+    if (!error.empty()) return error;
+
+    std::string out;
+    error = renderVariant(model, factor, gainDb, outputFormat, out);
+    return error.empty() ? out : error;
+}
+
+std::string processNam(const std::string& jsonStr, float factor, float gainDb) {
+    return processNam(jsonStr, factor, gainDb, "pretty");
+}
+
+// Bytes in the wasm heap that JS fills or reads through view(), a Uint8Array over them, so
+// files and outputs never pass through JS strings. A view is invalidated when the heap
+// grows: take it right before use and copy out (slice()) whatever must outlive the buffer.
+class NamBuffer {
+public:
+    explicit NamBuffer(size_t size) : bytes_(size, '\0') {}
+
+    size_t size() const { return bytes_.size(); }
+    emscripten::val view() {
+        return emscripten::val(emscripten::typed_memory_view(bytes_.size(), reinterpret_cast<uint8_t*>(bytes_.data())));
+    }
+
+    std::string_view bytes() const { return bytes_; }
+    void assign(std::string bytes) { bytes_ = std::move(bytes); }
+
+private:
+    std::string bytes_;
+};
+
+// Architecture and version of a .nam/.namb for the UI; weights are not parsed. An
+// unsupported version is an error here already, before the model is loaded.
+struct NamProbeResult {
+    std::string architecture;
+    std::string version;
+    std::string error;  // "Error: ..." or empty
+};
+
+NamProbeResult probeNam(const NamBuffer& input) {
+    NamProbeResult result;
+    NamProbe probe;
+    std::string err;
+    if (!NamParser::tryProbeNam(input.bytes(), probe, err)) {
+        result.error = "Error: " + err;
+        return result;
+    }
+    result.architecture = std::move(probe.architecture);
+    // A missing version is left to NamInput, which reports the file as invalid.
+    if (!probe.version.empty()) {
+        NamVersion version;
+        if (!Validator::tryCheckVersion(probe.version, version, err)) {
+            result.error = "Error: Invalid .nam file format (missing required fields or corrupted). " + err;
+            return result;
+        }
+        // Canonical form for the UI and analytics, e.g. "0.05.0" is reported as "0.5.0".
+        result.version = std::to_string(version.major) + "." + std::to_string(version.minor) + "."
+            + std::to_string(version.patch);
+    }
+    return result;
+}
+
+// A parsed and validated input; every gain is rendered from it without parsing again, and
+// the input buffer can be freed once it is built. Weights are held as floats, a fraction
+// of the size of their text.
+class NamInput {
+public:
+    explicit NamInput(const NamBuffer& input) {
+        auto model = std::make_shared<NamModel>();
+        error_ = loadModel(input.bytes(), *model);
+        if (error_.empty()) model_ = std::move(model);
     }
 
-    return j.dump(4);
+    // "Error: ..." if the input could not be loaded, otherwise empty.
+    std::string error() const { return error_; }
+
+    // Writes one gain into output, replacing its contents. Returns "Error: ..." or empty.
+    std::string render(float factor, float gainDb, const std::string& format, NamBuffer& output) const {
+        if (!model_) return error_;
+        NamOutputFormat outputFormat;
+        if (!NamWriter::tryParseFormat(format, outputFormat)) {
+            return "Error: Output format must be \"compact\" or \"pretty\".";
+        }
+        std::string error = checkGain(factor, gainDb);
+        if (!error.empty()) return error;
+        std::string out;
+        error = renderVariant(model_, factor, gainDb, outputFormat, out);
+        if (error.empty()) output.assign(std::move(out));
+        return error;
+    }
+
+private:
+    std::shared_ptr<const NamModel> model_;
+    std::string error_;
+};
+
+// processNam over heap buffers: one gain of input written into output.
+std::string processNamBytes(const NamBuffer& input, float factor, float gainDb, const std::string& format,
+                            NamBuffer& output) {
+    return NamInput(input).render(factor, gainDb, format, output);
 }
 
 EMSCRIPTEN_BINDINGS(my_module) {
-    emscripten::function("processNam", &processNam);
-}
\ No newline at end of file
+    // Overloaded by argument count: processNam(json, factor, gainDb[, format]).
+    emscripten::function("processNam",
+        emscripten::select_overload<std::string(const std::string&, float, float)>(&processNam));
+    emscripten::function("processNam",
+        emscripten::select_overload<std::string(const std::string&, float, float, const std::string&)>(&processNam));
+
+    emscripten::class_<NamBuffer>("NamBuffer")
+        .constructor<size_t>()
+        .function("size", &NamBuffer::size)
+        .function("view", &NamBuffer::view);
+    emscripten::value_object<NamProbeResult>("NamProbeResult")
+        .field("architecture", &NamProbeResult::architecture)
+        .field("version", &NamProbeResult::version)
+        .field("error", &NamProbeResult::error);
+    emscripten::function("probeNam", &probeNam);
+    emscripten::class_<NamInput>("NamInput")
+        .constructor<const NamBuffer&>()
+        .function("error", &NamInput::error)
+        .function("render", &NamInput::render);
+    emscripten::function("processNamBytes", &processNamBytes);
+}
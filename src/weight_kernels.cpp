@@ -0,0 +1,226 @@
+#include "weight_kernels.h"
+#include <cstdint>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define NAM_KERNELS_X86_DISPATCH 1
+#include <immintrin.h>
+#elif defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NAM_KERNELS_SSE2_ONLY 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#endif
+
+namespace {
+
+constexpr uint32_t kExponentMask = 0x7f800000u;
+
+// NaN and +/-Inf are exactly the values with an all-ones exponent.
+inline bool isNonFinite(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return (bits & kExponentMask) == kExponentMask;
+}
+
+using ScaleFindFn = size_t (*)(float*, size_t, float);
+using FindFn = size_t (*)(const float*, size_t);
+
+size_t scaleFindScalar(float* data, size_t count, float factor) {
+    size_t firstBad = count;
+    for (size_t i = 0; i < count; ++i) {
+        data[i] *= factor;
+        if (firstBad == count && isNonFinite(data[i])) firstBad = i;
+    }
+    return firstBad;
+}
+
+size_t findScalar(const float* data, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        if (isNonFinite(data[i])) return i;
+    }
+    return count;
+}
+
+// Resolves the exact index once a vector block reported a non-finite lane.
+inline size_t firstBadInBlock(const float* block, size_t base, size_t width) {
+    for (size_t k = 0; k < width; ++k) {
+        if (isNonFinite(block[k])) return base + k;
+    }
+    return base + width;
+}
+
+#if defined(NAM_KERNELS_X86_DISPATCH) || defined(NAM_KERNELS_SSE2_ONLY)
+
+#if defined(NAM_KERNELS_X86_DISPATCH)
+#define NAM_TARGET(isa) __attribute__((target(isa)))
+#else
+#define NAM_TARGET(isa)
+#endif
+
+NAM_TARGET("sse2") size_t scaleFindSse2(float* data, size_t count, float factor) {
+    const __m128 f = _mm_set1_ps(factor);
+    const __m128i mask = _mm_set1_epi32(static_cast<int>(kExponentMask));
+    size_t firstBad = count;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128 r = _mm_mul_ps(_mm_loadu_ps(data + i), f);
+        _mm_storeu_ps(data + i, r);
+        const __m128i e = _mm_and_si128(_mm_castps_si128(r), mask);
+        if (firstBad == count && _mm_movemask_epi8(_mm_cmpeq_epi32(e, mask)) != 0) {
+            firstBad = firstBadInBlock(data + i, i, 4);
+        }
+    }
+    const size_t tailBad = scaleFindScalar(data + i, count - i, factor);
+    if (firstBad == count && tailBad != count - i) firstBad = i + tailBad;
+    return firstBad;
+}
+
+NAM_TARGET("sse2") size_t findSse2(const float* data, size_t count) {
+    const __m128i mask = _mm_set1_epi32(static_cast<int>(kExponentMask));
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i e = _mm_and_si128(_mm_castps_si128(_mm_loadu_ps(data + i)), mask);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(e, mask)) != 0) return firstBadInBlock(data + i, i, 4);
+    }
+    return i + findScalar(data + i, count - i);
+}
+
+#endif
+
+#if defined(NAM_KERNELS_X86_DISPATCH)
+
+NAM_TARGET("avx2") size_t scaleFindAvx2(float* data, size_t count, float factor) {
+    const __m256 f = _mm256_set1_ps(factor);
+    const __m256i mask = _mm256_set1_epi32(static_cast<int>(kExponentMask));
+    size_t firstBad = count;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256 r = _mm256_mul_ps(_mm256_loadu_ps(data + i), f);
+        _mm256_storeu_ps(data + i, r);
+        const __m256i bad = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_castps_si256(r), mask), mask);
+        if (firstBad == count && !_mm256_testz_si256(bad, bad)) {
+            firstBad = firstBadInBlock(data + i, i, 8);
+        }
+    }
+    const size_t tailBad = scaleFindScalar(data + i, count - i, factor);
+    if (firstBad == count && tailBad != count - i) firstBad = i + tailBad;
+    return firstBad;
+}
+
+NAM_TARGET("avx2") size_t findAvx2(const float* data, size_t count) {
+    const __m256i mask = _mm256_set1_epi32(static_cast<int>(kExponentMask));
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i bad = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_castps_si256(_mm256_loadu_ps(data + i)), mask), mask);
+        if (!_mm256_testz_si256(bad, bad)) return firstBadInBlock(data + i, i, 8);
+    }
+    return i + findScalar(data + i, count - i);
+}
+
+NAM_TARGET("avx512f") size_t scaleFindAvx512(float* data, size_t count, float factor) {
+    const __m512 f = _mm512_set1_ps(factor);
+    const __m512i mask = _mm512_set1_epi32(static_cast<int>(kExponentMask));
+    size_t firstBad = count;
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m512 r = _mm512_mul_ps(_mm512_loadu_ps(data + i), f);
+        _mm512_storeu_ps(data + i, r);
+        const __mmask16 bad = _mm512_cmpeq_epi32_mask(_mm512_and_si512(_mm512_castps_si512(r), mask), mask);
+        if (firstBad == count && bad != 0) {
+            firstBad = firstBadInBlock(data + i, i, 16);
+        }
+    }
+    const size_t tailBad = scaleFindScalar(data + i, count - i, factor);
+    if (firstBad == count && tailBad != count - i) firstBad = i + tailBad;
+    return firstBad;
+}
+
+NAM_TARGET("avx512f") size_t findAvx512(const float* data, size_t count) {
+    const __m512i mask = _mm512_set1_epi32(static_cast<int>(kExponentMask));
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m512i e = _mm512_and_si512(_mm512_castps_si512(_mm512_loadu_ps(data + i)), mask);
+        if (_mm512_cmpeq_epi32_mask(e, mask) != 0) return firstBadInBlock(data + i, i, 16);
+    }
+    return i + findScalar(data + i, count - i);
+}
+
+#endif
+
+#if defined(__wasm_simd128__)
+
+size_t scaleFindSimd128(float* data, size_t count, float factor) {
+    const v128_t f = wasm_f32x4_splat(factor);
+    const v128_t mask = wasm_i32x4_splat(static_cast<int32_t>(kExponentMask));
+    size_t firstBad = count;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const v128_t r = wasm_f32x4_mul(wasm_v128_load(data + i), f);
+        wasm_v128_store(data + i, r);
+        if (firstBad == count && wasm_v128_any_true(wasm_i32x4_eq(wasm_v128_and(r, mask), mask))) {
+            firstBad = firstBadInBlock(data + i, i, 4);
+        }
+    }
+    const size_t tailBad = scaleFindScalar(data + i, count - i, factor);
+    if (firstBad == count && tailBad != count - i) firstBad = i + tailBad;
+    return firstBad;
+}
+
+size_t findSimd128(const float* data, size_t count) {
+    const v128_t mask = wasm_i32x4_splat(static_cast<int32_t>(kExponentMask));
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        if (wasm_v128_any_true(wasm_i32x4_eq(wasm_v128_and(wasm_v128_load(data + i), mask), mask))) {
+            return firstBadInBlock(data + i, i, 4);
+        }
+    }
+    return i + findScalar(data + i, count - i);
+}
+
+#endif
+
+struct KernelTable {
+    ScaleFindFn scaleFind;
+    FindFn find;
+    const char* isa;
+};
+
+KernelTable selectKernels() {
+#if defined(NAM_KERNELS_X86_DISPATCH)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return {scaleFindAvx512, findAvx512, "avx512f"};
+    if (__builtin_cpu_supports("avx2")) return {scaleFindAvx2, findAvx2, "avx2"};
+    if (__builtin_cpu_supports("sse2")) return {scaleFindSse2, findSse2, "sse2"};
+#elif defined(NAM_KERNELS_SSE2_ONLY)
+    return {scaleFindSse2, findSse2, "sse2"};
+#elif defined(__wasm_simd128__)
+    return {scaleFindSimd128, findSimd128, "simd128"};
+#endif
+    return {scaleFindScalar, findScalar, "scalar"};
+}
+
+const KernelTable& kernels() {
+    static const KernelTable table = selectKernels();
+    return table;
+}
+
+} // namespace
+
+void WeightKernels::scale(float* data, size_t count, float factor) {
+    kernels().scaleFind(data, count, factor);
+}
+
+size_t WeightKernels::scaleAndFindNonFinite(float* data, size_t count, float factor) {
+    return kernels().scaleFind(data, count, factor);
+}
+
+size_t WeightKernels::findNonFinite(const float* data, size_t count) {
+    return kernels().find(data, count);
+}
+
+const char* WeightKernels::activeIsa() {
+    return kernels().isa;
+}
@@ -1,6 +1,10 @@
 #include "weight_scaler.h"
+#include "run_stats.h"
+#include "thread_pool.h"
+#include "weight_kernels.h"
 #include <stdexcept>
 #include <cmath>
+#include <mutex>
 
 bool WeightScaler::tryGetHeadWeightIndices(const std::string& arch, const nlohmann::json& config, size_t weightsSize, size_t& start, size_t& end, std::string& error) {
     if (weightsSize == 0) {
@@ -84,74 +88,181 @@ std::pair<size_t, size_t> WeightScaler::getHeadWeightIndices(const std::string&
 }
 
 void WeightScaler::scaleWeights(std::vector<float>& weights, size_t start, size_t end, float factor) {
-    for (size_t i = start; i < end; ++i) {
-        weights[i] *= factor;
-    }
+    if (end <= start) return;
+    StatsTimer timer(StatsStage::Scale);
+    Stats::count(StatsCounter::WeightsScaled, end - start);
+    WeightKernels::scale(weights.data() + start, end - start, factor);
 }
 
-bool WeightScaler::tryScaleA2Model(nlohmann::json& model, float factor, std::string& error) {
-    if (!model.contains("architecture") || !model["architecture"].is_string()) {
-        error = "Missing or invalid architecture field in model.";
+// Scales count values in place; firstIndex is the position of data[0] in the whole array,
+// used to report the first non-finite result.
+static bool tryScaleRange(float* data, size_t count, size_t firstIndex, float factor, std::string& error) {
+    StatsTimer timer(StatsStage::Scale);
+    Stats::count(StatsCounter::WeightsScaled, count);
+    const size_t bad = WeightKernels::scaleAndFindNonFinite(data, count, factor);
+    if (bad != count) {
+        error = "Scaled weight at index " + std::to_string(firstIndex + bad) + " is not a finite number.";
         return false;
     }
+    return true;
+}
 
-    std::string arch = model["architecture"].get<std::string>();
+bool WeightScaler::tryScaleWeights(std::vector<float>& weights, size_t start, size_t end, float factor, std::string& error) {
+    if (end <= start) return true;
+    return tryScaleRange(weights.data() + start, end - start, start, factor, error);
+}
 
-    if (arch == "SlimmableContainer") {
-        if (!model.contains("config") || !model["config"].is_object()) {
-            error = "SlimmableContainer missing or invalid config.";
+bool WeightScaler::tryScaleWeights(NamModelVariant& variant, const std::string& ownerPointer, size_t start, size_t end,
+                                   float factor, std::string& error) {
+    if (end <= start) return true;
+    NamWeightOverlay* overlay = variant.overlay(ownerPointer, start, end);
+    if (overlay == nullptr) {
+        error = "Model missing or invalid weights array.";
+        return false;
+    }
+    return tryScaleRange(overlay->values.data(), overlay->values.size(), start, factor, error);
+}
+
+bool WeightScaler::tryScaleJsonWeights(nlohmann::json& weights, size_t start, size_t end, float factor, std::string& error) {
+    StatsTimer timer(StatsStage::Scale);
+    Stats::count(StatsCounter::WeightsScaled, end > start ? end - start : 0);
+    size_t index = 0;
+    for (auto& w : weights) {
+        if (!w.is_number()) {
+            error = "Weight at index " + std::to_string(index) + " is not a number.";
             return false;
         }
-        if (!model["config"].contains("submodels") || !model["config"]["submodels"].is_array()) {
-            error = "SlimmableContainer config missing or invalid submodels array.";
+        float value = static_cast<float>(w.get<double>());
+        const bool head = index >= start && index < end;
+        if (head) value *= factor;
+        if (!std::isfinite(value)) {
+            error = std::string(head ? "Scaled weight" : "Weight") + " at index " + std::to_string(index) + " is not a finite number.";
             return false;
         }
+        w = value;
+        ++index;
+    }
+    return true;
+}
 
-        for (auto& submodel_entry : model["config"]["submodels"]) {
-            if (!submodel_entry.contains("model") || !submodel_entry["model"].is_object()) {
-                error = "SlimmableContainer submodel entry missing or invalid model field.";
+// Walks an A2 (SlimmableContainer) model, scaling the head of every leaf submodel and updating
+// the metadata of every node. pointer is the node's JSON pointer; weightCount(pointer, count)
+// and scaleRange(pointer, start, end, error) access the weights owned by that node, and must be
+// safe to call concurrently for different nodes when pool is given.
+//
+// With a pool that has workers, the submodels of a container run as tasks of it. Nested
+// containers add their tasks to the same pool and help drain it while they wait, so a model
+// never uses more threads than the pool has, also when the pool is already busy with other
+// files. On failure error is that of the first failing submodel by index, as in a serial walk.
+template <typename WeightCount, typename ScaleRange>
+static bool tryScaleA2Node(nlohmann::json& node, const std::string& pointer, float factor, ThreadPool* pool,
+                           const WeightCount& weightCount, const ScaleRange& scaleRange, std::string& error) {
+    const float dbGain = 20.0f * std::log10(factor);
+    {
+        StatsTimer timer(StatsStage::Scale);
+        if (!node.contains("architecture") || !node["architecture"].is_string()) {
+            error = "Missing or invalid architecture field in model.";
+            return false;
+        }
+
+        const std::string arch = node["architecture"].get<std::string>();
+
+        if (arch != "SlimmableContainer") {
+            // For non-container models (WaveNet, LSTM, ConvNet, Linear), scale the weights directly
+            size_t count = 0;
+            if (!weightCount(pointer, count)) {
+                error = "Model missing or invalid weights array.";
+                return false;
+            }
+            if (!node.contains("config") || !node["config"].is_object()) {
+                error = "Model missing or invalid config.";
                 return false;
             }
 
-            if (!tryScaleA2Model(submodel_entry["model"], factor, error)) {
+            size_t start, end;
+            if (!WeightScaler::tryGetHeadWeightIndices(arch, node["config"], count, start, end, error)) {
                 return false;
             }
+
+            if (!scaleRange(pointer, start, end, error)) {
+                return false;
+            }
+
+            // Note: For WaveNet, head_scale is within the weights array (last weight)
+            // so we don't scale the config head_scale separately to avoid double-scaling
+            WeightScaler::updateMetadata(node, dbGain);
+            return true;
         }
 
-        // Scale top-level metadata for the container
-        float dbGain = 20.0f * std::log10(factor);
-        updateMetadata(model, dbGain);
-        return true;
-    } else {
-        // For non-container models (WaveNet, LSTM, ConvNet, Linear), scale the weights directly
-        if (!model.contains("weights") || !model["weights"].is_array()) {
-            error = "Model missing or invalid weights array.";
+        if (!node.contains("config") || !node["config"].is_object()) {
+            error = "SlimmableContainer missing or invalid config.";
             return false;
         }
-
-        std::vector<float> weights = model["weights"].get<std::vector<float>>();
-        if (!model.contains("config") || !model["config"].is_object()) {
-            error = "Model missing or invalid config.";
+        if (!node["config"].contains("submodels") || !node["config"]["submodels"].is_array()) {
+            error = "SlimmableContainer config missing or invalid submodels array.";
             return false;
         }
+    }
 
-        size_t start, end;
-        if (!tryGetHeadWeightIndices(arch, model["config"], weights.size(), start, end, error)) {
+    // Submodels are timed by their own walks, so waiting for them is not counted as scaling.
+    auto& submodels = node["config"]["submodels"];
+    auto scaleSubmodel = [&](size_t i, std::string& err) {
+        auto& submodel_entry = submodels[i];
+        if (!submodel_entry.contains("model") || !submodel_entry["model"].is_object()) {
+            err = "SlimmableContainer submodel entry missing or invalid model field.";
             return false;
         }
+        return tryScaleA2Node(submodel_entry["model"], pointer + "/config/submodels/" + std::to_string(i) + "/model",
+                              factor, pool, weightCount, scaleRange, err);
+    };
 
-        scaleWeights(weights, start, end, factor);
-        model["weights"] = weights;
-
-        // Note: For WaveNet, head_scale is within the weights array (last weight)
-        // so we don't scale the config head_scale separately to avoid double-scaling
+    if (pool != nullptr && pool->workerCount() > 0 && submodels.size() > 1) {
+        std::vector<std::string> errors(submodels.size());
+        std::vector<char> failed(submodels.size(), 0);
+        StatsSink* stats = Stats::current();
+        TaskGroup tasks(*pool);
+        for (size_t i = 0; i < submodels.size(); ++i) {
+            tasks.run([&, i] {
+                StatsBinding binding(stats);
+                failed[i] = !scaleSubmodel(i, errors[i]);
+            });
+        }
+        tasks.wait();
+        for (size_t i = 0; i < submodels.size(); ++i) {
+            if (failed[i]) {
+                error = std::move(errors[i]);
+                return false;
+            }
+        }
+    } else {
+        for (size_t i = 0; i < submodels.size(); ++i) {
+            if (!scaleSubmodel(i, error)) return false;
+        }
+    }
 
-        // Update metadata to reflect the weight scaling
-        float dbGain = 20.0f * std::log10(factor);
-        updateMetadata(model, dbGain);
+    // Scale top-level metadata for the container
+    StatsTimer timer(StatsStage::Scale);
+    WeightScaler::updateMetadata(node, dbGain);
+    return true;
+}
 
-        return true;
-    }
+bool WeightScaler::tryScaleA2Model(nlohmann::json& model, float factor, std::string& error, ThreadPool* pool) {
+    // Looking nodes up by pointer only reads the DOM; each leaf then converts its own array.
+    auto owner = [&model](const std::string& pointer) -> nlohmann::json& {
+        return model.at(nlohmann::json::json_pointer(pointer));
+    };
+    return tryScaleA2Node(
+        model, "", factor, pool,
+        [&owner](const std::string& pointer, size_t& count) {
+            const nlohmann::json& node = owner(pointer);
+            if (!node.contains("weights") || !node["weights"].is_array()) return false;
+            count = node["weights"].size();
+            return true;
+        },
+        [&owner, factor](const std::string& pointer, size_t start, size_t end, std::string& err) {
+            return tryScaleJsonWeights(owner(pointer)["weights"], start, end, factor, err);
+        },
+        error);
 }
 
 void WeightScaler::scaleA2Model(nlohmann::json& model, float factor) {
@@ -161,7 +272,47 @@ void WeightScaler::scaleA2Model(nlohmann::json& model, float factor) {
     }
 }
 
+bool WeightScaler::tryScaleA2Model(NamModel& model, float factor, std::string& error, ThreadPool* pool) {
+    return tryScaleA2Node(
+        model.document, "", factor, pool,
+        [&model](const std::string& owner, size_t& count) {
+            const NamWeightArray* weights = model.findWeights(owner);
+            if (weights == nullptr) return false;
+            count = weights->values.size();
+            return true;
+        },
+        [&model, factor](const std::string& owner, size_t start, size_t end, std::string& err) {
+            return tryScaleWeights(model.findWeights(owner)->values, start, end, factor, err);
+        },
+        error);
+}
+
+bool WeightScaler::tryScaleA2Model(NamModelVariant& variant, float factor, std::string& error, ThreadPool* pool) {
+    // Overlays may be added from several threads: with room reserved for one per base array,
+    // adding one never moves the others, so each leaf can scale its overlay outside the lock.
+    variant.overlays.reserve(variant.overlays.size() + variant.base->weightArrays.size());
+    std::mutex overlayMutex;
+    return tryScaleA2Node(
+        variant.document, "", factor, pool,
+        [&variant](const std::string& owner, size_t& count) { return variant.tryGetWeightCount(owner, count); },
+        [&variant, &overlayMutex, factor](const std::string& owner, size_t start, size_t end, std::string& err) {
+            if (end <= start) return true;
+            NamWeightOverlay* overlay = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(overlayMutex);
+                overlay = variant.overlay(owner, start, end);
+            }
+            if (overlay == nullptr) {
+                err = "Model missing or invalid weights array.";
+                return false;
+            }
+            return tryScaleRange(overlay->values.data(), overlay->values.size(), start, factor, err);
+        },
+        error);
+}
+
 void WeightScaler::updateMetadata(nlohmann::json& model, float dbGain) {
+    StatsTimer timer(StatsStage::Scale);
     // Update loudness and gain metadata to reflect weight scaling.
     // This prevents host normalization from negating the weight-level changes.
     if (model.contains("metadata") && model["metadata"].is_object()) {
@@ -1,9 +1,44 @@
 #include <catch2/catch_all.hpp>
 #include "validator.h"
 #include "weight_scaler.h"
+#include "cli.h"
+#include "nam_parser.h"
+#include "nam_writer.h"
+#include "nam_patcher.h"
+#include "thread_pool.h"
+#include "mapped_file.h"
+#include "weight_kernels.h"
+#include "output_writer.h"
+#include "result_cache.h"
+#include "model_cache.h"
+#include "daemon.h"
+#include "nam_binary.h"
+#include "loudness.h"
+#include "model_audio.h"
+#include "verifier.h"
+#include "reference_store.h"
+#include "watcher.h"
+#include <algorithm>
 #include <vector>
 #include <nlohmann/json.hpp>
 #include <cmath>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <random>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
 
 using json = nlohmann::json;
 
@@ -30,6 +65,27 @@ json makeNamJson(const std::string& version, const std::string& arch = "Linear")
     return j;
 }
 
+// Helper to create an empty scratch directory for CLI tests
+std::filesystem::path makeTempDir(const std::string& name) {
+    auto dir = std::filesystem::temp_directory_path() / ("nam_volume_knob_tests_" + name);
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    return dir;
+}
+
+std::string writeFile(const std::filesystem::path& path, const std::string& contents) {
+    std::ofstream out(path, std::ios::binary);
+    out << contents;
+    return path.string();
+}
+
+std::string readFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
 TEST_CASE("Validator accepts valid version strings") {
     SECTION("accepts 0.5.x versions") {
         auto j = makeNamJson("0.5.0");
@@ -291,6 +347,38 @@ TEST_CASE("Validator rejects invalid version formats") {
     }
 }
 
+TEST_CASE("Validator::tryParseVersion") {
+    constexpr auto parse = [](std::string_view text) {
+        NamVersion v{-1, -1, -1};
+        return Validator::tryParseVersion(text, v) ? v : NamVersion{-1, -1, -1};
+    };
+    STATIC_REQUIRE(parse("0.5.12").minor == 5);
+    STATIC_REQUIRE(parse("0.5.12").patch == 12);
+    STATIC_REQUIRE(Validator::isSupportedVersion(parse("0.10.0")));
+    STATIC_REQUIRE_FALSE(Validator::isSupportedVersion(parse("1.5.0")));
+
+    NamVersion v;
+    for (const char* bad : {"", "0", "0.5", "0.5.", ".5.0", "0..0", "0.5.0a", "0.5.0.1", " 0.5.0", "0.-5.0", "0.5.x", "0.2147483648.0"}) {
+        INFO(bad);
+        REQUIRE_FALSE(Validator::tryParseVersion(bad, v));
+    }
+    REQUIRE(Validator::tryParseVersion("0.2147483647.0", v));
+    REQUIRE(v.minor == 2147483647);
+
+    std::string err;
+    REQUIRE(Validator::tryCheckVersion("0.05.1", v, err));
+    REQUIRE((v.minor == 5 && v.patch == 1));
+    REQUIRE_FALSE(Validator::tryCheckVersion("0.4.9", v, err));
+    REQUIRE(err == "Unsupported version \"0.4.9\"; expected 0.X.Y, at least 0.5.0.");
+}
+
+TEST_CASE("Validator reports unsupported versions") {
+    auto model = NamParser::parseNamModel(writeFile(makeTempDir("version") / "old.nam", makeNamJson("0.4.9").dump()));
+    std::string err;
+    REQUIRE_FALSE(Validator::validateNam(model, err));
+    REQUIRE(err == "Unsupported version \"0.4.9\"; expected 0.X.Y, at least 0.5.0.");
+}
+
 TEST_CASE("WaveNet scales last weight (head_scale in weights array)") {
     SECTION("last weight is scaled, others unchanged") {
         std::vector<float> w = {0.1f, 0.2f, 0.3f, 0.02f};
@@ -412,4 +500,1527 @@ TEST_CASE("A2 (SlimmableContainer) weight scaling") {
         REQUIRE_FALSE(WeightScaler::tryGetHeadWeightIndices("SlimmableContainer", config, 10, start, end, err));
         REQUIRE(err.find("SlimmableContainer") != std::string::npos);
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("ThreadPool and TaskGroup") {
+    SECTION("runs every task, including nested ones, with and without workers") {
+        for (size_t workers : {0, 3}) {
+            ThreadPool pool(workers);
+            std::atomic<int> count{0};
+            {
+                TaskGroup group(pool);
+                for (int i = 0; i < 20; ++i) {
+                    group.run([&] {
+                        TaskGroup inner(pool);
+                        for (int k = 0; k < 5; ++k) {
+                            inner.run([&] { count++; });
+                        }
+                        inner.wait();
+                    });
+                }
+                group.wait();
+            }
+            REQUIRE(count == 100);
+        }
+    }
+
+    SECTION("wait rethrows a task exception") {
+        ThreadPool pool(2);
+        TaskGroup group(pool);
+        group.run([] { throw std::runtime_error("boom"); });
+        REQUIRE_THROWS(group.wait());
+    }
+}
+
+TEST_CASE("CliHandler::run with --jobs") {
+    auto dir = makeTempDir("jobs");
+    std::vector<std::string> inputs;
+    for (int i = 0; i < 6; ++i) {
+        auto j = makeNamJson("0.5.0", i % 2 ? "WaveNet" : "Linear");
+        j["metadata"]["loudness"] = -10.0 - i;
+        inputs.push_back(writeFile(dir / ("model" + std::to_string(i) + ".nam"), j.dump()));
+    }
+    // Same stem in a different directory forces a _v2 collision in the shared output dir.
+    std::filesystem::create_directories(dir / "other");
+    inputs.push_back(writeFile(dir / "other" / "model0.nam", makeNamJson("0.5.0").dump()));
+
+    auto runWithJobs = [&](size_t jobs, const std::string& outDirName) {
+        CliArgs args;
+        args.inputPaths = inputs;
+        args.outputDir = (dir / outDirName).string();
+        std::filesystem::create_directories(args.outputDir);
+        args.gainDbs = {-3.0f, 0.0f, 6.0f};
+        args.jobs = jobs;
+        return CliHandler::run(args);
+    };
+
+    auto serial = runWithJobs(1, "serial");
+    auto parallel = runWithJobs(4, "parallel");
+    REQUIRE(serial.exitCode == 0);
+    REQUIRE(parallel.exitCode == 0);
+    REQUIRE(parallel.outputPaths.size() == inputs.size() * 3);
+    REQUIRE(parallel.outputPaths.size() == serial.outputPaths.size());
+    for (size_t i = 0; i < serial.outputPaths.size(); ++i) {
+        const auto serialName = std::filesystem::path(serial.outputPaths[i]).filename();
+        const auto parallelName = std::filesystem::path(parallel.outputPaths[i]).filename();
+        REQUIRE(serialName == parallelName);
+        REQUIRE(readFile(serial.outputPaths[i]) == readFile(parallel.outputPaths[i]));
+    }
+    REQUIRE(std::filesystem::path(parallel.outputPaths[0]).filename() == "model0_-3_0db.nam");
+    REQUIRE(std::filesystem::path(parallel.outputPaths.back()).filename() == "model0_+6_0db_v2.nam");
+
+    SECTION("first failing input in order is reported") {
+        CliArgs args;
+        args.inputPaths = {inputs[0], writeFile(dir / "broken.nam", "{not json"), inputs[1]};
+        args.outputDir = (dir / "failing").string();
+        std::filesystem::create_directories(args.outputDir);
+        args.gainDbs = {1.0f};
+        args.jobs = 3;
+        auto result = CliHandler::run(args);
+        REQUIRE(result.exitCode == 1);
+        REQUIRE(result.outputPaths.size() == 1);
+    }
+}
+
+TEST_CASE("GainSweep parsing and expansion") {
+    GainSweep sweep;
+    std::string err;
+    REQUIRE(GainSweep::tryParse("-6:-3:0.5", sweep, err));
+    std::vector<float> gains;
+    REQUIRE(sweep.tryExpand(gains, err));
+    REQUIRE(gains == std::vector<float>{-6.0f, -5.5f, -5.0f, -4.5f, -4.0f, -3.5f, -3.0f});
+
+    REQUIRE(GainSweep::tryParse("0.3:1.7:0.7", sweep, err));
+    REQUIRE(sweep.tryExpand(gains, err));
+    REQUIRE(gains == std::vector<float>{0.3f, 1.0f, 1.7f});  // stop stays inclusive
+
+    REQUIRE(GainSweep::tryParse("3:-3:-3", sweep, err));
+    REQUIRE(sweep.tryExpand(gains, err));
+    REQUIRE(gains == std::vector<float>{3.0f, 0.0f, -3.0f});
+
+    for (const char* bad : {"", "1:2", "1:2:3:4", "a:2:1", "1::1", "1:2:1x"}) {
+        INFO(bad);
+        REQUIRE_FALSE(GainSweep::tryParse(bad, sweep, err));
+    }
+    REQUIRE(GainSweep::tryParse("0:1:0", sweep, err));
+    REQUIRE_FALSE(sweep.tryExpand(gains, err));
+    REQUIRE(GainSweep::tryParse("0:-1:1", sweep, err));
+    REQUIRE_FALSE(sweep.tryExpand(gains, err));
+    REQUIRE(GainSweep::tryParse("-100:0:0.01", sweep, err));
+    REQUIRE_FALSE(sweep.tryExpand(gains, err));
+}
+
+TEST_CASE("CliHandler::runGainSweep matches per-gain rendering") {
+    auto dir = makeTempDir("sweep");
+    json lstm = makeNamJson("0.5.0", "LSTM");
+    lstm["config"]["hidden_size"] = 2;
+    lstm["config"]["output_level"] = -1.3;
+    lstm["weights"] = {0.1, -0.25, 1e-7, 0.3, -0.7};
+    lstm["metadata"]["loudness"] = -18.7;
+    lstm["metadata"]["gain"] = 0.4;
+    json a2 = makeNamJson("0.7.0");
+    a2["architecture"] = "SlimmableContainer";
+    a2.erase("weights");
+    json sub;
+    sub["max_value"] = 1.0;
+    sub["model"] = makeNamJson("0.5.0", "WaveNet");
+    sub["model"]["weights"] = {0.1, -2, 0.02};
+    sub["model"]["metadata"]["loudness"] = -20.1;
+    a2["config"]["submodels"] = json::array({sub, sub});
+
+    CliArgs args;
+    args.inputPaths = {writeFile(dir / "lstm.nam", lstm.dump()), writeFile(dir / "a2.nam", a2.dump(2))};
+    args.outputDir = (dir / "list").string();
+    std::filesystem::create_directories(args.outputDir);
+    args.gainDbs = {-6.0f, -4.5f, -3.0f, -1.5f, 0.0f, 1.5f, 3.0f};
+    auto list = CliHandler::run(args);
+    REQUIRE(list.exitCode == 0);
+
+    args.outputDir = (dir / "sweep").string();
+    std::filesystem::create_directories(args.outputDir);
+    args.jobs = 3;
+    GainSweep sweep;
+    sweep.startDb = -6.0;
+    sweep.stopDb = 3.0;
+    sweep.stepDb = 1.5;
+    auto swept = CliHandler::runGainSweep(args, sweep);
+    REQUIRE(swept.exitCode == 0);
+    REQUIRE(swept.outputPaths.size() == list.outputPaths.size());
+    for (size_t i = 0; i < list.outputPaths.size(); ++i) {
+        REQUIRE(std::filesystem::path(swept.outputPaths[i]).filename() == std::filesystem::path(list.outputPaths[i]).filename());
+        REQUIRE(readFile(swept.outputPaths[i]) == readFile(list.outputPaths[i]));
+    }
+
+    SECTION("compact sweep matches compact per-gain rendering") {
+        args.format = NamOutputFormat::Compact;
+        args.jobs = 1;
+        args.outputDir = (dir / "compact-list").string();
+        std::filesystem::create_directories(args.outputDir);
+        auto compactList = CliHandler::run(args);
+        REQUIRE(compactList.exitCode == 0);
+        args.outputDir = (dir / "compact-sweep").string();
+        std::filesystem::create_directories(args.outputDir);
+        auto compactSwept = CliHandler::runGainSweep(args, sweep);
+        REQUIRE(compactSwept.exitCode == 0);
+        REQUIRE(compactSwept.outputPaths.size() == compactList.outputPaths.size());
+        for (size_t i = 0; i < compactList.outputPaths.size(); ++i) {
+            const std::string contents = readFile(compactSwept.outputPaths[i]);
+            REQUIRE(contents == readFile(compactList.outputPaths[i]));
+            REQUIRE(contents.find('\n') == std::string::npos);
+        }
+    }
+
+    sweep.stopDb = 12.0;
+    auto tooLoud = CliHandler::runGainSweep(args, sweep);
+    REQUIRE(tooLoud.exitCode == 2);
+    REQUIRE(tooLoud.error.find("Maximum allowed gain") != std::string::npos);
+}
+
+TEST_CASE("NamParser::parseNamModel streams weights into float storage") {
+    auto dir = makeTempDir("sax");
+
+    json a2 = makeNamJson("0.7.0");
+    a2["architecture"] = "SlimmableContainer";
+    a2.erase("weights");
+    a2["metadata"]["loudness"] = -11.5;
+    a2["metadata"]["name"] = "weights / \"quoted\"";
+    json sub;
+    sub["max_value"] = 1.0;
+    sub["model"] = makeNamJson("0.5.0", "WaveNet");
+    sub["model"]["weights"] = {0.1, -2, 3.5e-7, 0.02};
+    a2["config"]["submodels"] = json::array({sub, sub});
+    const auto path = writeFile(dir / "a2.nam", a2.dump(2));
+
+    auto model = NamParser::parseNamModel(path);
+    REQUIRE(model.weightArrays.size() == 2);
+    REQUIRE(model.weightArrays[1].ownerPointer == "/config/submodels/1/model");
+    REQUIRE(model.weightArrays[1].values.size() == 4);
+    REQUIRE(model.document["config"]["submodels"][0]["model"]["weights"].is_null());
+    REQUIRE(Validator::validateNam(model));
+
+    SECTION("writer output matches the DOM serializer") {
+        auto dom = NamParser::parseNamFile(path);
+        REQUIRE(NamWriter::dump(model) == model.toJson().dump(4));
+        dom["config"]["submodels"][0]["model"]["weights"] = dom["config"]["submodels"][0]["model"]["weights"].get<std::vector<float>>();
+        dom["config"]["submodels"][1]["model"]["weights"] = dom["config"]["submodels"][1]["model"]["weights"].get<std::vector<float>>();
+        REQUIRE(NamWriter::dump(model) == dom.dump(4));
+    }
+
+    SECTION("compact writer output matches dump() and reloads bit-exactly") {
+        const std::string compact = NamWriter::dump(model, NamOutputFormat::Compact);
+        REQUIRE(compact.find('\n') == std::string::npos);
+        REQUIRE(compact.find("\"version\":\"0.7.0\"") != std::string::npos);
+        REQUIRE(compact.find("[0.1,-2,3.5e-07,0.02]") != std::string::npos);
+
+        NamModel reloaded;
+        std::string err;
+        REQUIRE(NamParser::tryParseNamModel(compact, reloaded, err));
+        REQUIRE(reloaded.document == model.document);
+        REQUIRE(reloaded.weightArrays.size() == model.weightArrays.size());
+        for (size_t i = 0; i < model.weightArrays.size(); ++i) {
+            REQUIRE(reloaded.weightArrays[i].values == model.weightArrays[i].values);
+        }
+    }
+
+    SECTION("A2 scaling matches the DOM implementation") {
+        auto dom = NamParser::parseNamFile(path);
+        std::string err;
+        REQUIRE(WeightScaler::tryScaleA2Model(model, 2.0f, err));
+        REQUIRE(WeightScaler::tryScaleA2Model(dom, 2.0f, err));
+        REQUIRE(NamWriter::dump(model) == dom.dump(4));
+        REQUIRE(model.weightArrays[0].values[3] == Catch::Approx(0.04f));
+    }
+
+    SECTION("copy-on-write variants share the base weights") {
+        auto base = std::make_shared<const NamModel>(model);
+        NamModelVariant louder(base);
+        NamModelVariant quieter(base);
+        std::string err;
+        REQUIRE(WeightScaler::tryScaleA2Model(louder, 2.0f, err));
+        REQUIRE(WeightScaler::tryScaleA2Model(quieter, 0.5f, err));
+
+        // Only the one-weight WaveNet heads are copied; the base is untouched.
+        REQUIRE(louder.overlays.size() == 2);
+        REQUIRE(louder.overlays[1].arrayIndex == 1);
+        REQUIRE(louder.overlays[1].start == 3);
+        REQUIRE(louder.overlays[1].values.size() == 1);
+        REQUIRE(base->weightArrays[0].values[3] == 0.02f);
+
+        NamModel copy = model;
+        REQUIRE(WeightScaler::tryScaleA2Model(copy, 2.0f, err));
+        REQUIRE(NamWriter::dump(louder) == NamWriter::dump(copy));
+        REQUIRE(NamWriter::dump(louder.materialize()) == NamWriter::dump(copy));
+        REQUIRE(NamWriter::dump(quieter).find("0.009999999776482582") != std::string::npos);
+
+        REQUIRE(louder.overlay("/config/submodels/0/model", 3, 4) == &louder.overlays[0]);
+        REQUIRE(louder.overlay("/config/submodels/0/model", 2, 4) == nullptr);
+        REQUIRE(louder.overlay("/config/submodels/0/model", 3, 5) == nullptr);
+        REQUIRE_FALSE(WeightScaler::tryScaleWeights(louder, "/missing", 0, 1, 2.0f, err));
+    }
+
+    SECTION("validator rejects non-numeric and missing weights") {
+        json bad = makeNamJson("0.5.0");
+        bad["weights"] = {1.0, "x", 3.0};
+        auto badModel = NamParser::parseNamModel(writeFile(dir / "bad.nam", bad.dump()));
+        REQUIRE_FALSE(Validator::validateNam(badModel));
+
+        bad["weights"] = "not an array";
+        badModel = NamParser::parseNamModel(writeFile(dir / "bad2.nam", bad.dump()));
+        REQUIRE_FALSE(Validator::validateNam(badModel));
+
+        bad["weights"] = json::array();
+        badModel = NamParser::parseNamModel(writeFile(dir / "bad3.nam", bad.dump()));
+        REQUIRE_FALSE(Validator::validateNam(badModel));
+    }
+
+    SECTION("validator reports the first bad weight recorded while parsing") {
+        json bad = makeNamJson("0.5.0");
+        bad["weights"] = {1.0, 2.0, 1e39, "x"};
+        auto badModel = NamParser::parseNamModel(writeFile(dir / "bad4.nam", bad.dump()));
+        REQUIRE(badModel.weightArrays[0].firstInvalid == 2);
+        std::string err;
+        REQUIRE_FALSE(Validator::validateNam(badModel, err));
+        REQUIRE(err == "Weight at index 2 is not a finite number.");
+
+        json badA2 = a2;
+        badA2["config"]["submodels"][1]["model"]["weights"] = {0.5, json::array({1}), 0.5};
+        badModel = NamParser::parseNamModel(writeFile(dir / "bad5.nam", badA2.dump()));
+        err.clear();
+        REQUIRE_FALSE(Validator::validateNam(badModel, err));
+        REQUIRE(err == "Weight at index 1 of /config/submodels/1/model is not a finite number.");
+    }
+
+    SECTION("in-memory parse matches the file parse and never throws") {
+        NamModel fromText;
+        std::string err;
+        REQUIRE(NamParser::tryParseNamModel(a2.dump(2), fromText, err));
+        REQUIRE(NamWriter::dump(fromText) == NamWriter::dump(model));
+        REQUIRE_FALSE(NamParser::tryParseNamModel("{\"weights\": [1, 2", fromText, err));
+        REQUIRE(err == "Failed to parse JSON.");
+        REQUIRE(fromText.weightArrays.empty());
+    }
+
+    SECTION("malformed JSON throws") {
+        REQUIRE_THROWS(NamParser::parseNamModel(writeFile(dir / "broken.nam", "{\"weights\": [1, 2")));
+    }
+}
+
+TEST_CASE("MappedFile maps regular files and reads everything else") {
+    auto dir = makeTempDir("mapped");
+    const std::string contents = makeNamJson("0.5.0").dump(4);
+
+    SECTION("regular files are mapped") {
+        MappedFile file(writeFile(dir / "a.nam", contents));
+        REQUIRE(file.isMapped());
+        REQUIRE(file.view() == contents);
+
+        MappedFile moved = std::move(file);
+        REQUIRE(moved.view() == contents);
+        REQUIRE(file.size() == 0);
+    }
+
+    SECTION("regular files are read when mapping is not allowed") {
+        MappedFile file(writeFile(dir / "read.nam", contents), false);
+        REQUIRE_FALSE(file.isMapped());
+        REQUIRE(file.view() == contents);
+    }
+
+    SECTION("empty files and missing files") {
+        MappedFile empty(writeFile(dir / "empty.nam", ""));
+        REQUIRE(empty.size() == 0);
+        REQUIRE_THROWS(MappedFile((dir / "missing.nam").string()));
+    }
+
+#ifndef _WIN32
+    SECTION("pipes fall back to a buffered read") {
+        const auto fifo = dir / "pipe.nam";
+        REQUIRE(::mkfifo(fifo.string().c_str(), 0600) == 0);
+        std::thread writer([&] { std::ofstream(fifo) << contents; });
+        MappedFile file(fifo.string());
+        writer.join();
+        REQUIRE_FALSE(file.isMapped());
+        REQUIRE(file.view() == contents);
+    }
+#endif
+
+    SECTION("parsers run over the mapped bytes") {
+        const auto path = writeFile(dir / "b.nam", contents + "\ntrailing");
+        REQUIRE(NamParser::parseNamFile(path) == makeNamJson("0.5.0"));  // non-strict, like operator>>
+        REQUIRE_THROWS(NamParser::parseNamModel(path));
+        REQUIRE(NamParser::parseNamModel(writeFile(dir / "c.nam", contents)).toJson() == NamParser::parseNamFile(path));
+    }
+}
+
+TEST_CASE("WeightScaler tryScaleJsonWeights converts, checks and scales in one pass") {
+    json weights = {1, 0.1, -2.5, 0.5};
+    std::string err;
+    REQUIRE(WeightScaler::tryScaleJsonWeights(weights, 2, 4, 2.0f, err));
+    REQUIRE(weights.dump() == json(std::vector<float>{1.0f, 0.1f, -5.0f, 1.0f}).dump());
+
+    json bad = {1.0, 2.0, "x", 3.0};
+    REQUIRE_FALSE(WeightScaler::tryScaleJsonWeights(bad, 0, 4, 2.0f, err));
+    REQUIRE(err == "Weight at index 2 is not a number.");
+
+    json overflow = {1.0, 3e38};
+    REQUIRE_FALSE(WeightScaler::tryScaleJsonWeights(overflow, 1, 2, 2.0f, err));
+    REQUIRE(err == "Scaled weight at index 1 is not a finite number.");
+
+    json a2 = makeNamJson("0.7.0");
+    a2["architecture"] = "SlimmableContainer";
+    json sub;
+    sub["model"] = makeNamJson("0.5.0", "WaveNet");
+    sub["model"]["weights"] = {0.1, "x"};
+    a2["config"]["submodels"] = json::array({sub});
+    REQUIRE_FALSE(WeightScaler::tryScaleA2Model(a2, 2.0f, err));
+    REQUIRE(err == "Weight at index 1 is not a number.");
+}
+
+TEST_CASE("A2 submodels scale in parallel with serial results") {
+    // Four WaveNet leaves and a nested container of two LSTMs.
+    json a2 = makeNamJson("0.7.0");
+    a2["architecture"] = "SlimmableContainer";
+    a2["metadata"]["loudness"] = -10.0;
+    json nested = makeNamJson("0.7.0");
+    nested["architecture"] = "SlimmableContainer";
+    for (int i = 0; i < 2; ++i) {
+        json lstm = makeNamJson("0.5.0", "LSTM");
+        lstm["config"]["hidden_size"] = 2;
+        lstm["weights"] = {1.0f, 2.0f, 3.0f + i};
+        nested["config"]["submodels"].push_back({{"model", lstm}});
+    }
+    for (int i = 0; i < 4; ++i) {
+        json wavenet = makeNamJson("0.5.0", "WaveNet");
+        wavenet["weights"] = {0.5f, 0.25f * (i + 1)};
+        a2["config"]["submodels"].push_back({{"model", wavenet}});
+    }
+    a2["config"]["submodels"].push_back({{"model", nested}});
+
+    ThreadPool pool(3);
+    std::string err;
+    json serial = a2;
+    REQUIRE(WeightScaler::tryScaleA2Model(serial, 2.0f, err));
+    json parallel = a2;
+    REQUIRE(WeightScaler::tryScaleA2Model(parallel, 2.0f, err, &pool));
+    REQUIRE(parallel.dump(4) == serial.dump(4));
+    REQUIRE(parallel["config"]["submodels"][4]["model"]["config"]["submodels"][1]["model"]["weights"][2] == 8.0f);
+
+    NamModel model;
+    REQUIRE(NamParser::tryParseNamModel(a2.dump(), model, err));
+    auto base = std::make_shared<const NamModel>(model);
+    NamModelVariant variant(base);
+    REQUIRE(WeightScaler::tryScaleA2Model(variant, 2.0f, err, &pool));
+    REQUIRE(variant.overlays.size() == 6);
+    REQUIRE(NamWriter::dump(variant) == serial.dump(4));
+    REQUIRE(WeightScaler::tryScaleA2Model(model, 2.0f, err, &pool));
+    REQUIRE(NamWriter::dump(model) == serial.dump(4));
+
+    SECTION("the first failing submodel by index is reported") {
+        json bad = a2;
+        bad["config"]["submodels"][1]["model"]["weights"] = {0.1, "x"};
+        bad["config"]["submodels"][3]["model"]["weights"] = {0.1, 0.2, "y"};
+        for (int run = 0; run < 20; ++run) {
+            json copy = bad;
+            REQUIRE_FALSE(WeightScaler::tryScaleA2Model(copy, 2.0f, err, &pool));
+            REQUIRE(err == "Weight at index 1 is not a number.");
+        }
+    }
+}
+
+TEST_CASE("NamPatcher surgical output") {
+    SECTION("matches full re-serialization when the input is already in dump(4) form") {
+        auto dir = makeTempDir("surgical");
+        json lstm = makeNamJson("0.5.0", "LSTM");
+        lstm["config"]["hidden_size"] = 2;
+        lstm["config"]["output_level"] = -1.5f;
+        lstm["weights"] = {0.25f, -0.5f, 0.125f, 1.0f};
+        lstm["metadata"]["loudness"] = -18.0f;
+        lstm["metadata"]["gain"] = 3.0f;
+        json a2 = makeNamJson("0.7.0");
+        a2["architecture"] = "SlimmableContainer";
+        a2.erase("weights");
+        json sub;
+        sub["model"] = makeNamJson("0.5.0", "WaveNet");
+        sub["model"]["metadata"]["loudness"] = -20.0f;
+        a2["config"]["submodels"] = json::array({sub, sub});
+
+        for (const auto& model : {lstm, a2}) {
+            const auto input = writeFile(dir / "model.nam", model.dump(4));
+            for (bool surgical : {false, true}) {
+                CliArgs args;
+                args.inputPaths = {input};
+                args.outputDir = (dir / (surgical ? "surgical" : "full")).string();
+                std::filesystem::create_directories(args.outputDir);
+                args.gainDbs = {4.5f};
+                args.surgical = surgical;
+                REQUIRE(CliHandler::run(args).exitCode == 0);
+            }
+            const auto name = "model_+4_5db.nam";
+            REQUIRE(readFile((dir / "surgical" / name).string()) == readFile((dir / "full" / name).string()));
+            std::filesystem::remove_all(dir / "surgical");
+            std::filesystem::remove_all(dir / "full");
+        }
+    }
+
+    SECTION("preserves the text of untouched weights and formatting") {
+        const std::string text = R"({"version":"0.5.0", "architecture":"WaveNet", "config":{},
+  "weights":[1.000, 2e0 ,  -0.50],
+  "metadata":{"loudness":-10}})";
+        NamTextIndex index;
+        std::string err;
+        REQUIRE(NamPatcher::tryIndex(text, index, err));
+        REQUIRE(NamPatcher::validate(index));
+        std::vector<NamPatchEdit> edits;
+        REQUIRE(NamPatcher::tryBuildEdits(text, index, 2.0f, 6.0f, edits, err));
+        const std::string out = NamPatcher::apply(text, edits);
+        REQUIRE(out == R"({"version":"0.5.0", "architecture":"WaveNet", "config":{},
+  "weights":[1.000, 2e0 ,  -1.0],
+  "metadata":{"loudness":-4.0}})");
+    }
+
+    SECTION("rejects malformed or invalid input") {
+        NamTextIndex index;
+        std::string err;
+        REQUIRE_FALSE(NamPatcher::tryIndex(R"({"weights": [1, 2,]})", index, err));
+        REQUIRE_FALSE(err.empty());
+        REQUIRE(NamPatcher::tryIndex(R"({"version":"0.5.0","architecture":"Linear","config":{},"weights":[1,"x"]})", index, err));
+        REQUIRE_FALSE(NamPatcher::validate(index));
+    }
+
+    SECTION("rejects weights that overflow, like the default path") {
+        auto dir = makeTempDir("surgical_overflow");
+        for (const std::string weight : {"1e999", "-1e39"}) {
+            const auto input = writeFile(dir / "model.nam",
+                R"({"version":"0.5.0","architecture":"WaveNet","config":{},"weights":[2.0,)" + weight + R"(,3.0]})");
+            for (bool surgical : {false, true}) {
+                INFO(weight << (surgical ? " surgical" : " full"));
+                CliArgs args;
+                args.inputPaths = {input};
+                args.outputDir = dir.string();
+                args.gainDbs = {-3.0f};
+                args.surgical = surgical;
+                auto result = CliHandler::run(args);
+                REQUIRE(result.exitCode != 0);
+                REQUIRE(result.outputPaths.empty());
+                if (surgical) REQUIRE(result.error.find("Weight at index 1 is not a finite number.") != std::string::npos);
+            }
+        }
+        NamTextIndex index;
+        std::string err;
+        REQUIRE(NamPatcher::tryIndex(R"({"version":"0.5.0","architecture":"Linear","config":{},"weights":[1e-999,1]})", index, err));
+        REQUIRE(NamPatcher::validate(index));
+    }
+}
+
+TEST_CASE("NamWriter::appendShortestFloat round-trips every float it prints") {
+    std::mt19937 rng(7);
+    std::vector<float> values = {0.0f, -0.0f, 0.1f, 1.0f, -2.5f, 1e-7f, 3.4028235e38f, 1.17549435e-38f, 1e-45f,
+                                 std::nextafter(1.0f, 2.0f), 16777217.0f};
+    for (int i = 0; i < 200000; ++i) {
+        const uint32_t bits = rng();
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        if (std::isfinite(value)) values.push_back(value);
+    }
+    for (float value : values) {
+        std::string text;
+        NamWriter::appendShortestFloat(text, value);
+        std::string pretty;
+        NamWriter::appendFloat(pretty, value);
+        REQUIRE(text.size() <= pretty.size());
+        // NAM core reads weights as double and narrows; strtof reads them directly.
+        const float viaDouble = static_cast<float>(std::strtod(text.c_str(), nullptr));
+        const float direct = std::strtof(text.c_str(), nullptr);
+        REQUIRE(std::memcmp(&viaDouble, &value, sizeof(value)) == 0);
+        REQUIRE(std::memcmp(&direct, &value, sizeof(value)) == 0);
+    }
+
+    std::string text;
+    NamWriter::appendShortestFloat(text, std::numeric_limits<float>::quiet_NaN());
+    REQUIRE(text == "null");
+
+    NamOutputFormat format = NamOutputFormat::Pretty;
+    REQUIRE(NamWriter::tryParseFormat("compact", format));
+    REQUIRE(format == NamOutputFormat::Compact);
+    REQUIRE_FALSE(NamWriter::tryParseFormat("Compact", format));
+}
+
+TEST_CASE("NamWriter::dumpBinary round-trips through NamParser") {
+    json a2 = makeNamJson("0.7.0");
+    a2["architecture"] = "SlimmableContainer";
+    a2.erase("weights");
+    json sub;
+    sub["max_value"] = 1.0;
+    sub["model"] = makeNamJson("0.5.0", "WaveNet");
+    sub["model"]["weights"] = {0.1, -2, 3.5e-7, 0.02};
+    sub["model"]["metadata"]["loudness"] = -20.1;
+    json small = sub;
+    small["model"]["weights"] = {1.5};
+    a2["config"]["submodels"] = json::array({sub, small});
+
+    NamModel model;
+    std::string err;
+    REQUIRE(NamParser::tryParseNamModel(a2.dump(), model, err));
+    const std::string binary = NamWriter::dumpBinary(model);
+    REQUIRE(NamBinary::matches(binary));
+
+    NamModel reloaded;
+    REQUIRE(NamParser::tryParseNamModel(binary, reloaded, err));
+    REQUIRE(reloaded.document == model.document);
+    REQUIRE(reloaded.weightArrays.size() == 2);
+    for (size_t a = 0; a < model.weightArrays.size(); ++a) {
+        REQUIRE(reloaded.weightArrays[a].ownerPointer == model.weightArrays[a].ownerPointer);
+        REQUIRE(reloaded.weightArrays[a].values == model.weightArrays[a].values);
+    }
+    REQUIRE(NamWriter::dump(reloaded) == NamWriter::dump(model));
+
+    SECTION("blobs are 64-byte aligned") {
+        uint64_t headerSize = 0;
+        std::memcpy(&headerSize, binary.data() + 8, sizeof(headerSize));
+        const json header = json::parse(binary.substr(NamBinary::kPrefixSize, headerSize));
+        const size_t dataStart = NamBinary::alignUp(NamBinary::kPrefixSize + headerSize);
+        REQUIRE(dataStart % NamBinary::kAlignment == 0);
+        for (const auto& entry : header["weights"]) REQUIRE(entry["offset"].get<size_t>() % NamBinary::kAlignment == 0);
+        float first = 0.0f;
+        std::memcpy(&first, binary.data() + dataStart, sizeof(first));
+        REQUIRE(first == 0.1f);
+    }
+
+    SECTION("variants write their overlays") {
+        auto base = std::make_shared<const NamModel>(model);
+        NamModelVariant variant(base);
+        variant.overlay("/config/submodels/1/model", 0, 1)->values[0] = 3.0f;
+        REQUIRE(NamParser::tryParseNamBinary(NamWriter::dumpBinary(variant), reloaded, err));
+        REQUIRE(reloaded.weightArrays[0].values == model.weightArrays[0].values);
+        REQUIRE(reloaded.weightArrays[1].values == std::vector<float>{3.0f});
+    }
+
+    SECTION("truncated or corrupted files are rejected") {
+        REQUIRE_FALSE(NamParser::tryParseNamBinary(binary.substr(0, binary.size() - 4), reloaded, err));
+        REQUIRE(err.find("outside the file") != std::string::npos);
+        std::string badVersion = binary;
+        badVersion[4] = 9;
+        REQUIRE_FALSE(NamParser::tryParseNamBinary(badVersion, reloaded, err));
+        REQUIRE_FALSE(NamParser::tryParseNamBinary(binary.substr(0, 12), reloaded, err));
+    }
+}
+
+TEST_CASE("NamParser::tryProbeNam reads architecture and version only") {
+    json wavenet = makeNamJson("0.5.4", "WaveNet");
+    wavenet["weights"] = {0.1, 0.2, 0.3};
+    NamProbe probe;
+    std::string err;
+    REQUIRE(NamParser::tryProbeNam(wavenet.dump(), probe, err));
+    REQUIRE(probe.architecture == "WaveNet");
+    REQUIRE(probe.version == "0.5.4");
+
+    // Stops before the weights once both are seen, so a broken tail is not an error.
+    const std::string head = R"({"version": "0.5.2", "architecture": "LSTM", "config": {"version": "x"}, "weights": [0.1, )";
+    REQUIRE(NamParser::tryProbeNam(head + "oops", probe, err));
+    REQUIRE(probe.architecture == "LSTM");
+    REQUIRE(probe.version == "0.5.2");
+
+    REQUIRE(NamParser::tryProbeNam(R"({"architecture": 3, "weights": []})", probe, err));
+    REQUIRE(probe.architecture.empty());
+    REQUIRE_FALSE(NamParser::tryProbeNam("{\"architecture\": ", probe, err));
+
+    NamModel model;
+    REQUIRE(NamParser::tryParseNamModel(wavenet.dump(), model, err));
+    REQUIRE(NamParser::tryProbeNam(NamWriter::dumpBinary(model), probe, err));
+    REQUIRE(probe.architecture == "WaveNet");
+    REQUIRE(probe.version == "0.5.4");
+    REQUIRE_FALSE(NamParser::tryProbeNam(NamWriter::dumpBinary(model).substr(0, 20), probe, err));
+}
+
+TEST_CASE("CliHandler::run converts between .nam and .namb") {
+    auto dir = makeTempDir("binary");
+    json lstm = makeNamJson("0.5.0", "LSTM");
+    lstm["config"]["hidden_size"] = 2;
+    lstm["weights"] = {0.1, -0.25, 1e-7, 0.3, -0.7};
+    lstm["metadata"]["loudness"] = -18.7;
+    const auto input = writeFile(dir / "lstm.nam", lstm.dump());
+
+    CliArgs args;
+    args.inputPaths = {input};
+    args.gainDbs = {-3.0f, 2.0f};
+    args.outputDir = (dir / "json").string();
+    std::filesystem::create_directories(args.outputDir);
+    auto fromJson = CliHandler::run(args);
+    REQUIRE(fromJson.exitCode == 0);
+
+    args.container = NamContainer::Binary;
+    args.convertOnly = true;
+    args.gainDbs = {0.0f};
+    args.outputDir.clear();
+    auto converted = CliHandler::run(args);
+    REQUIRE(converted.exitCode == 0);
+    REQUIRE(converted.outputPaths == std::vector<std::string>{(dir / "lstm.namb").string()});
+    REQUIRE(NamBinary::matches(readFile(converted.outputPaths[0])));
+
+    // .namb in keeps .namb out by default; --from-binary writes the same JSON as a JSON input.
+    args.inputPaths = converted.outputPaths;
+    args.container = NamContainer::Auto;
+    args.convertOnly = false;
+    args.gainDbs = {-3.0f, 2.0f};
+    args.outputDir = (dir / "binary").string();
+    std::filesystem::create_directories(args.outputDir);
+    auto binaryOut = CliHandler::run(args);
+    REQUIRE(binaryOut.exitCode == 0);
+    REQUIRE(std::filesystem::path(binaryOut.outputPaths[1]).extension() == ".namb");
+    NamModel scaled;
+    std::string err;
+    REQUIRE(NamParser::tryParseNamModel(readFile(binaryOut.outputPaths[1]), scaled, err));
+    REQUIRE(NamWriter::dump(scaled) == readFile(fromJson.outputPaths[1]));
+
+    args.container = NamContainer::Json;
+    args.outputDir = (dir / "back").string();
+    std::filesystem::create_directories(args.outputDir);
+    for (bool sweep : {false, true}) {
+        args.gainSweep = sweep;
+        auto back = CliHandler::run(args);
+        REQUIRE(back.exitCode == 0);
+        for (size_t g = 0; g < 2; ++g) REQUIRE(readFile(back.outputPaths[g]) == readFile(fromJson.outputPaths[g]));
+    }
+
+    args.container = NamContainer::Auto;
+    args.gainSweep = false;
+    args.surgical = true;
+    auto surgical = CliHandler::run(args);
+    REQUIRE(surgical.exitCode == 1);
+    REQUIRE(surgical.error.find("--surgical needs a JSON .nam input") != std::string::npos);
+}
+
+TEST_CASE("CliHandler::run collects per-file stats") {
+    auto dir = makeTempDir("stats");
+    json lstm = makeNamJson("0.5.0", "LSTM");
+    lstm["config"]["hidden_size"] = 2;
+    lstm["weights"] = {0.1, -0.25, 1e-7, 0.3, -0.7};
+    const auto first = writeFile(dir / "a.nam", lstm.dump());
+    const auto second = writeFile(dir / "b.nam", lstm.dump());
+
+    CliArgs args;
+    args.inputPaths = {first, second};
+    args.gainDbs = {-3.0f, 2.0f};
+    args.outputDir = dir.string();
+    args.jobs = 2;
+    auto plain = CliHandler::run(args);
+    REQUIRE(plain.exitCode == 0);
+    REQUIRE_FALSE(plain.stats.collected);
+
+    for (bool surgical : {false, true}) {
+        args.surgical = surgical;
+        args.stats = true;
+        auto result = CliHandler::run(args);
+        REQUIRE(result.exitCode == 0);
+        REQUIRE(result.stats.collected);
+        REQUIRE(result.stats.files.size() == 2);
+        for (const auto& file : result.stats.files) {
+            REQUIRE(file.counter(StatsCounter::BytesRead) == lstm.dump().size());
+            REQUIRE(file.counter(StatsCounter::Outputs) == 2);
+            REQUIRE(file.counter(StatsCounter::WeightsScaled) == 2 * 2);  // LSTM head: hidden_size weights per gain
+            REQUIRE(file.counter(StatsCounter::BytesWritten)
+                    == std::filesystem::file_size(result.outputPaths[0]) + std::filesystem::file_size(result.outputPaths[1]));
+            REQUIRE(file.stageNs[static_cast<size_t>(StatsStage::Parse)] > 0);
+        }
+        REQUIRE(result.stats.files[1].inputPath == second);
+
+        const RunStats back = RunStats::fromJson(result.stats.toJson());
+        REQUIRE(back.total().counters == result.stats.total().counters);
+        const std::string lines = result.stats.jsonLines();
+        REQUIRE(std::count(lines.begin(), lines.end(), '\n') == 3);
+        REQUIRE(json::parse(lines.substr(lines.rfind('\n', lines.size() - 2) + 1))["type"] == "run");
+    }
+}
+
+TEST_CASE("NamPatcher::pieces matches apply") {
+    const std::string text = "0123456789";
+    std::vector<NamPatchEdit> edits = {{0, 2, "ab"}, {4, 4, "X"}, {5, 7, ""}, {9, 10, "Z"}};
+    auto pieces = NamPatcher::pieces(text, edits);
+    std::string joined;
+    for (const auto& piece : pieces) {
+        REQUIRE_FALSE(piece.empty());
+        joined += piece;
+    }
+    REQUIRE(joined == NamPatcher::apply(text, edits));
+    REQUIRE(joined == "ab23X478Z");
+}
+
+TEST_CASE("OutputWriter publishes files in order") {
+    auto dir = makeTempDir("writer");
+    auto countTempFiles = [&dir] {
+        size_t count = 0;
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(dir)) {
+            if (entry.path().extension() == ".tmp") ++count;
+        }
+        return count;
+    };
+
+    for (auto backend : {OutputWriter::Backend::Auto, OutputWriter::Backend::Thread}) {
+        for (auto sync : {SyncMode::None, SyncMode::File, SyncMode::Batch}) {
+            INFO("sync mode " << static_cast<int>(sync));
+            const auto outDir = dir / ("out" + std::to_string(static_cast<int>(backend)) + std::to_string(static_cast<int>(sync)));
+            std::filesystem::create_directories(outDir);
+            OutputWriter writer(sync, backend);
+            INFO("backend " << writer.backendName());
+            // More files than one batch, each written from several pieces of one buffer.
+            const size_t fileCount = OutputWriter::kMaxBatchFiles * 2 + 5;
+            for (size_t i = 0; i < fileCount; ++i) {
+                auto text = std::make_shared<std::string>("file " + std::to_string(i) + std::string(i * 97, 'x'));
+                OutputWrite write;
+                write.finalPath = (outDir / ("f" + std::to_string(i) + ".nam")).string();
+                const std::string_view view(*text);
+                write.pieces = {view.substr(0, 3), view.substr(3, 0), view.substr(3)};
+                write.storage = text;
+                REQUIRE(writer.submit(std::move(write)));
+            }
+            std::string err;
+            REQUIRE(writer.finish(err));
+            REQUIRE(writer.publishedCount() == fileCount);
+            for (size_t i = 0; i < fileCount; ++i) {
+                REQUIRE(readFile((outDir / ("f" + std::to_string(i) + ".nam")).string())
+                        == "file " + std::to_string(i) + std::string(i * 97, 'x'));
+            }
+        }
+    }
+    REQUIRE(countTempFiles() == 0);
+
+    SECTION("nothing after the first failure is published") {
+        for (auto backend : {OutputWriter::Backend::Auto, OutputWriter::Backend::Thread}) {
+            const auto outDir = dir / ("failing" + std::to_string(static_cast<int>(backend)));
+            std::filesystem::create_directories(outDir);
+            OutputWriter writer(SyncMode::None, backend);
+            std::vector<std::string> paths;
+            for (size_t i = 0; i < 6; ++i) {
+                paths.push_back((i == 3 ? outDir / "missing" / "f3.nam" : outDir / ("f" + std::to_string(i) + ".nam")).string());
+                OutputWrite write;
+                write.finalPath = paths.back();
+                write.pieces = {"{}"};
+                writer.submit(std::move(write));
+            }
+            std::string err;
+            REQUIRE_FALSE(writer.finish(err));
+            REQUIRE(err == "Error: Failed to open output file for writing: " + paths[3]);
+            REQUIRE(writer.publishedCount() == 3);
+            for (size_t i = 0; i < paths.size(); ++i) {
+                REQUIRE(std::filesystem::exists(paths[i]) == (i < 3));
+            }
+            OutputWrite late;
+            late.finalPath = (outDir / "late.nam").string();
+            REQUIRE_FALSE(writer.submit(std::move(late)));
+        }
+        REQUIRE(countTempFiles() == 0);
+    }
+
+#ifndef _WIN32
+    SECTION("a failure before a copied file leaves other descriptors alone") {
+        // Copied (cache-hit) files have no descriptor of their own; fd 0 must survive the cut.
+        const int savedStdin = ::dup(0);
+        const int devNull = ::open("/dev/null", O_RDONLY);
+        REQUIRE(::dup2(devNull, 0) == 0);
+        const std::string source = writeFile(dir / "cached.nam", "{\"cached\":true}");
+        for (auto backend : {OutputWriter::Backend::Auto, OutputWriter::Backend::Thread}) {
+            const auto outDir = dir / ("mixed" + std::to_string(static_cast<int>(backend)));
+            std::filesystem::create_directories(outDir);
+            OutputWriter writer(SyncMode::None, backend);
+            OutputWrite miss;
+            miss.finalPath = (outDir / "missing" / "miss.nam").string();
+            miss.pieces = {"{}"};
+            writer.submit(std::move(miss));
+            OutputWrite hit;
+            hit.finalPath = (outDir / "hit.nam").string();
+            hit.sourcePath = source;
+            writer.submit(std::move(hit));
+            std::string err;
+            REQUIRE_FALSE(writer.finish(err));
+            REQUIRE(writer.publishedCount() == 0);
+            REQUIRE_FALSE(std::filesystem::exists(outDir / "hit.nam"));
+            REQUIRE(::fcntl(0, F_GETFD) != -1);
+        }
+        ::dup2(savedStdin, 0);
+        ::close(savedStdin);
+        ::close(devNull);
+        REQUIRE(countTempFiles() == 0);
+    }
+#endif
+
+    SECTION("CLI reports the write failure and only the published outputs") {
+        CliArgs args;
+        args.inputPaths = {writeFile(dir / "model.nam", makeNamJson("0.5.0").dump())};
+        args.outputPath = (dir / "no-such-dir" / "out.nam").string();
+        args.gainDbs = {1.0f};
+        args.sync = SyncMode::Batch;
+        auto result = CliHandler::run(args);
+        REQUIRE(result.exitCode == 4);
+        REQUIRE(result.error == "Error: Failed to open output file for writing: " + args.outputPath);
+        REQUIRE(result.outputPaths.empty());
+    }
+
+    SyncMode mode = SyncMode::None;
+    REQUIRE(OutputWriter::tryParseSyncMode("batch", mode));
+    REQUIRE(mode == SyncMode::Batch);
+    REQUIRE_FALSE(OutputWriter::tryParseSyncMode("always", mode));
+}
+
+TEST_CASE("ResultCache::hash is XXH64") {
+    REQUIRE(ResultCache::hash("") == 0xEF46DB3751D8E999ULL);
+    REQUIRE(ResultCache::hash("abc") == 0x44BC2CF5AD770999ULL);
+    REQUIRE(ResultCache::hash("Nobody inspects the spammish repetition") == 0xFBCEA83C8A378BF1ULL);
+    REQUIRE(ResultCache::makeKey(1, "gain=1") != ResultCache::makeKey(1, "gain=2"));
+    REQUIRE(ResultCache::makeKey(1, "gain=1").size() == 32);
+}
+
+TEST_CASE("CliHandler::run with --cache-dir") {
+    auto dir = makeTempDir("cache");
+    json lstm = makeNamJson("0.5.0", "LSTM");
+    lstm["config"]["hidden_size"] = 2;
+    lstm["weights"] = {0.1, -0.25, 0.5, 0.3, -0.7};
+    lstm["metadata"]["loudness"] = -18.7;
+    const auto input = writeFile(dir / "lstm.nam", lstm.dump());
+
+    CliArgs args;
+    args.inputPaths = {input};
+    args.gainDbs = {-3.0f, 2.0f};
+    auto runInto = [&](const std::string& name) {
+        args.outputDir = (dir / name).string();
+        std::filesystem::create_directories(args.outputDir);
+        return CliHandler::run(args);
+    };
+
+    auto uncached = runInto("uncached");
+    args.cacheDir = (dir / "cache").string();
+    auto first = runInto("first");
+    REQUIRE(first.exitCode == 0);
+    REQUIRE(first.cache.hits == 0);
+    REQUIRE(first.cache.misses == 2);
+    // Entries are named neutrally, whatever the output container.
+    for (const auto& entry : std::filesystem::directory_iterator(args.cacheDir)) {
+        REQUIRE(entry.path().extension() == ".entry");
+    }
+    auto second = runInto("second");
+    REQUIRE(second.exitCode == 0);
+    REQUIRE(second.cache.hits == 2);
+    REQUIRE(second.cache.misses == 0);
+    for (size_t i = 0; i < uncached.outputPaths.size(); ++i) {
+        REQUIRE(readFile(second.outputPaths[i]) == readFile(uncached.outputPaths[i]));
+        REQUIRE(readFile(first.outputPaths[i]) == readFile(uncached.outputPaths[i]));
+        // Hits are copies: writable like rendered outputs and independent of the entry.
+        REQUIRE(std::filesystem::hard_link_count(second.outputPaths[i]) == 1);
+        const auto perms = std::filesystem::status(second.outputPaths[i]).permissions();
+        REQUIRE((perms & std::filesystem::perms::owner_write) != std::filesystem::perms::none);
+    }
+
+    SECTION("the surgical path parses the bytes read for hashing") {
+        args.surgical = true;
+        auto surgical = runInto("surgical");
+        REQUIRE(surgical.exitCode == 0);
+        REQUIRE(surgical.cache.misses == 2);
+        REQUIRE(runInto("surgical-again").cache.hits == 2);
+    }
+
+    SECTION("options and input bytes are part of the key") {
+        args.format = NamOutputFormat::Compact;
+        auto compact = runInto("compact");
+        REQUIRE(compact.cache.misses == 2);
+        args.format = NamOutputFormat::Pretty;
+        args.gainDbs = {-3.0f, 2.5f};
+        auto newGain = runInto("new-gain");
+        REQUIRE(newGain.cache.hits == 1);
+        REQUIRE(newGain.cache.misses == 1);
+        lstm["metadata"]["loudness"] = -18.5;
+        writeFile(dir / "lstm.nam", lstm.dump());
+        auto edited = runInto("edited");
+        REQUIRE(edited.cache.hits == 0);
+        REQUIRE(readFile(edited.outputPaths[0]).find("-21.5") != std::string::npos);
+    }
+
+    SECTION("least recently used entries are evicted") {
+        const uint64_t entrySize = std::filesystem::file_size(first.outputPaths[0]);
+        args.cacheMaxBytes = entrySize * 3;
+        args.gainDbs = {-3.0f};
+        runInto("touch");  // -3 dB is now the most recently used entry
+        args.gainDbs = {1.0f, 4.0f};
+        auto more = runInto("more");
+        REQUIRE(more.cache.evicted >= 1);
+        uint64_t total = 0;
+        for (const auto& entry : std::filesystem::directory_iterator(args.cacheDir)) total += entry.file_size();
+        REQUIRE(total <= args.cacheMaxBytes);
+        args.gainDbs = {-3.0f};
+        REQUIRE(runInto("after").cache.hits == 1);
+    }
+
+#ifndef _WIN32
+    SECTION("an entry evicted between lookup and publish is still published") {
+        ResultCache cache(args.cacheDir, 0);
+        const std::string key = ResultCache::makeKey(1, "evicted");
+        writeFile(cache.entryPath(key), "cached bytes");
+        auto entry = cache.lookup(key);
+        REQUIRE(entry);
+        cache.trim();  // as another run's settle() would
+        REQUIRE_FALSE(std::filesystem::exists(entry->path()));
+
+        OutputWriter writer(SyncMode::None);
+        OutputWrite write;
+        write.finalPath = (dir / "evicted.nam").string();
+        write.sourcePath = entry->path();
+        write.sourceFd = entry->fd();
+        write.storage = entry;
+        REQUIRE(writer.submit(std::move(write)));
+        std::string err;
+        REQUIRE(writer.finish(err));
+        REQUIRE(readFile((dir / "evicted.nam").string()) == "cached bytes");
+    }
+#endif
+}
+
+#ifndef _WIN32
+TEST_CASE("DaemonServer answers requests from parsed models it keeps") {
+    auto dir = makeTempDir("daemon");
+    json lstm = makeNamJson("0.5.0", "LSTM");
+    lstm["config"]["hidden_size"] = 2;
+    lstm["weights"] = {0.1, -0.25, 0.5, 0.3, -0.7};
+    const auto input = writeFile(dir / "lstm.nam", lstm.dump());
+    std::filesystem::create_directories(dir / "local");
+    std::filesystem::create_directories(dir / "served");
+
+    DaemonOptions options;
+    options.socketPath = (dir / "s.sock").string();
+    options.jobs = 2;
+    options.maxModels = 1;
+    DaemonServer server(options);
+    std::string error;
+    REQUIRE(server.tryStart(error));
+    std::thread serving([&server] { server.run(); });
+
+    CliArgs args;
+    args.inputPaths = {input};
+    args.gainDbs = {-3.0f, 2.0f};
+    args.outputDir = (dir / "local").string();
+    auto local = CliHandler::run(args);
+    REQUIRE(local.exitCode == 0);
+
+    SECTION("run writes what a local run writes and reuses the parsed model") {
+        args.outputDir = (dir / "served").string();
+        for (int i = 0; i < 2; ++i) {
+            CliRunResult served;
+            REQUIRE(DaemonClient::tryRun(options.socketPath, args, served, error));
+            REQUIRE(served.exitCode == 0);
+            REQUIRE(served.outputPaths.size() == 2);
+            for (size_t g = 0; g < 2; ++g) REQUIRE(readFile(served.outputPaths[g]) == readFile(local.outputPaths[g]));
+        }
+        REQUIRE(server.models().stats().hits == 1);
+        REQUIRE(server.models().stats().misses == 1);
+
+        args.inputPaths = {(dir / "missing.nam").string()};
+        CliRunResult failed;
+        REQUIRE(DaemonClient::tryRun(options.socketPath, args, failed, error));
+        REQUIRE(failed.exitCode == 2);
+        REQUIRE(failed.error.find("does not exist") != std::string::npos);
+    }
+
+    SECTION("render returns the outputs for in-memory bytes") {
+        const std::string bytes = readFile(input);
+        CliRenderResult rendered;
+        REQUIRE(DaemonClient::tryRender(options.socketPath, bytes, args, rendered, error));
+        REQUIRE(rendered.exitCode == 0);
+        REQUIRE(rendered.outputs.size() == 2);
+        REQUIRE(rendered.outputs[1] == readFile(local.outputPaths[1]));
+
+        CliRenderResult invalid;
+        REQUIRE(DaemonClient::tryRender(options.socketPath, "{\"version\": \"0.5.0\"}", args, invalid, error));
+        REQUIRE(invalid.exitCode == 3);
+        REQUIRE(invalid.outputs.empty());
+    }
+
+    SECTION("idle and half-sent connections do not hold workers") {
+        // More silent clients than workers, one stopped in the middle of a header frame.
+        std::vector<int> idle;
+        for (int i = 0; i < 4; ++i) {
+            const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            std::strncpy(address.sun_path, options.socketPath.c_str(), sizeof(address.sun_path) - 1);
+            REQUIRE(::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0);
+            idle.push_back(fd);
+        }
+        const char partial[] = {100, 0, 0, 0, '{'};
+        REQUIRE(::send(idle[0], partial, sizeof(partial), 0) == static_cast<ssize_t>(sizeof(partial)));
+
+        args.outputDir = (dir / "served").string();
+        CliRunResult served;
+        REQUIRE(DaemonClient::tryRun(options.socketPath, args, served, error));
+        REQUIRE(served.exitCode == 0);
+        CliRenderResult rendered;
+        REQUIRE(DaemonClient::tryRender(options.socketPath, readFile(input), args, rendered, error));
+        REQUIRE(rendered.outputs.size() == 2);
+        for (int fd : idle) ::close(fd);
+    }
+
+    SECTION("a second server cannot take over a live socket") {
+        DaemonServer other(options);
+        REQUIRE_FALSE(other.tryStart(error));
+        REQUIRE(error.find("already listening") != std::string::npos);
+    }
+
+    json reply;
+    std::vector<std::string> outputs;
+    REQUIRE(DaemonClient::tryCall(options.socketPath, json{{"op", "shutdown"}}, nullptr, reply, outputs, error));
+    serving.join();
+    REQUIRE_FALSE(std::filesystem::exists(options.socketPath));
+    bool connected = true;
+    CliRunResult none;
+    REQUIRE_FALSE(DaemonClient::tryRun(options.socketPath, args, none, error, &connected));
+    REQUIRE_FALSE(connected);
+}
+#endif
+
+TEST_CASE("WeightKernels match the scalar loop bit for bit") {
+    INFO("active ISA: " << WeightKernels::activeIsa());
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> dist(-4.0f, 4.0f);
+    const float factors[] = {0.5011872f, 1.4125376f, 2.8183830f, 1.0f};
+
+    for (size_t count = 0; count < 70; ++count) {
+        for (size_t offset = 0; offset < 3; ++offset) {
+            std::vector<float> input(count + offset);
+            for (auto& v : input) v = dist(rng);
+            if (count > 5) input[offset + 5] = 1e-40f;  // denormal
+            for (float factor : factors) {
+                std::vector<float> expected = input;
+                for (size_t i = offset; i < expected.size(); ++i) expected[i] *= factor;
+
+                std::vector<float> actual = input;
+                WeightKernels::scale(actual.data() + offset, count, factor);
+                REQUIRE(std::memcmp(actual.data(), expected.data(), actual.size() * sizeof(float)) == 0);
+
+                actual = input;
+                REQUIRE(WeightKernels::scaleAndFindNonFinite(actual.data() + offset, count, factor) == count);
+                REQUIRE(std::memcmp(actual.data(), expected.data(), actual.size() * sizeof(float)) == 0);
+            }
+        }
+    }
+}
+
+TEST_CASE("WeightKernels report the first non-finite value") {
+    std::vector<float> w(37, 0.5f);
+    REQUIRE(WeightKernels::findNonFinite(w.data(), w.size()) == w.size());
+    w[33] = std::numeric_limits<float>::infinity();
+    w[35] = std::numeric_limits<float>::quiet_NaN();
+    REQUIRE(WeightKernels::findNonFinite(w.data(), w.size()) == 33);
+    w[20] = std::numeric_limits<float>::max();
+    REQUIRE(WeightKernels::scaleAndFindNonFinite(w.data(), w.size(), 2.0f) == 20);
+    REQUIRE(w[36] == 1.0f);  // scaling continues past the first bad value
+
+    std::vector<float> head = {1.0f, std::numeric_limits<float>::max()};
+    std::string err;
+    REQUIRE_FALSE(WeightScaler::tryScaleWeights(head, 0, 2, 2.0f, err));
+    REQUIRE(err.find("index 1") != std::string::npos);
+}
+
+TEST_CASE("LoudnessMeter follows BS.1770") {
+    const double kPi = 3.14159265358979323846;
+    for (double rate : {44100.0, 48000.0}) {
+        std::vector<double> sine(static_cast<size_t>(rate * 5));
+        for (size_t i = 0; i < sine.size(); ++i) sine[i] = std::sin(2.0 * kPi * 997.0 * static_cast<double>(i) / rate);
+        LoudnessMeter meter(rate);
+        // Pushed in uneven blocks: the result must not depend on them.
+        for (size_t offset = 0; offset < sine.size(); offset += 1000) {
+            meter.push(sine.data() + offset, std::min<size_t>(1000, sine.size() - offset));
+        }
+        const AudioLevels levels = meter.levels();
+        REQUIRE(std::abs(levels.lufs - -3.01) < 0.05);
+        REQUIRE(std::abs(levels.peak - 1.0) < 1e-3);
+        REQUIRE(std::abs(levels.rms - std::sqrt(0.5)) < 1e-3);
+        REQUIRE(levels.envelope.size() == 50);  // complete 100 ms hops
+    }
+
+    std::vector<double> silence(48000 * 2, 0.0);
+    LoudnessMeter quiet(48000.0);
+    quiet.push(silence.data(), silence.size());
+    REQUIRE(std::isinf(quiet.levels().lufs));
+
+    // A quiet tail is gated out instead of dragging the loudness down (ungated it would be
+    // about -6 LUFS; the blocks overlapping the transition still count).
+    std::vector<double> signal(48000 * 4, 0.0);
+    for (size_t i = 0; i < signal.size() / 2; ++i) signal[i] = std::sin(2.0 * kPi * 997.0 * static_cast<double>(i) / 48000.0);
+    for (size_t i = signal.size() / 2; i < signal.size(); ++i) signal[i] = 1e-3 * std::sin(2.0 * kPi * 997.0 * static_cast<double>(i) / 48000.0);
+    LoudnessMeter gated(48000.0);
+    gated.push(signal.data(), signal.size());
+    REQUIRE(gated.levels().lufs < -3.01);
+    REQUIRE(gated.levels().lufs > -3.5);
+}
+
+TEST_CASE("TestSignal::standard is deterministic at -18 dBFS RMS") {
+    const auto signal = TestSignal::standard(48000.0, 2.0);
+    REQUIRE(signal.size() == 96000);
+    REQUIRE(signal == TestSignal::standard(48000.0, 2.0));
+    LoudnessMeter meter(48000.0);
+    meter.push(signal.data(), signal.size());
+    const AudioLevels levels = meter.levels();
+    REQUIRE(std::abs(20.0 * std::log10(levels.rms) - -18.0) < 0.01);
+    REQUIRE(levels.peak < 1.0);
+}
+
+TEST_CASE("CliHandler loudness matching options") {
+    auto dir = makeTempDir("loudness");
+    const auto input = writeFile(dir / "linear.nam", makeNamJson("0.5.0").dump());
+
+    CliArgs args;
+    args.inputPaths = {input};
+    args.outputDir = dir.string();
+    args.hasTargetLufs = true;
+    args.targetLufs = -18.0f;
+    std::string error;
+    REQUIRE(CliHandler::validateArgs(args, error));
+
+    args.matchToPath = input;
+    REQUIRE_FALSE(CliHandler::validateArgs(args, error));
+    REQUIRE(error.find("mutually exclusive") != std::string::npos);
+
+    args.hasTargetLufs = false;
+    args.matchToPath = (dir / "missing.nam").string();
+    REQUIRE_FALSE(CliHandler::validateArgs(args, error));
+    REQUIRE(error.find("--match-to") != std::string::npos);
+
+    args.matchToPath = input;
+    args.gainDbs = {1.0f};
+    REQUIRE_FALSE(CliHandler::validateArgs(args, error));
+    args.gainDbs.clear();
+    REQUIRE(CliHandler::validateArgs(args, error));
+
+    if (!ModelAudio::available()) {
+        CliRunResult result = CliHandler::run(args);
+        REQUIRE(result.exitCode == 2);
+        REQUIRE(result.error.find("NeuralAmpModelerCore") != std::string::npos);
+        REQUIRE(result.outputPaths.empty());
+    }
+}
+
+TEST_CASE("TestSignal stimuli") {
+    StimulusSpec spec;
+    std::string err;
+    REQUIRE(TestSignal::tryParse("noise:-30:2", spec, err));
+    REQUIRE(spec.kind == StimulusSpec::Kind::Noise);
+    REQUIRE(spec.id() == "noise:-30:2");
+    REQUIRE(TestSignal::tryParse("multitone", spec, err));
+    REQUIRE(spec.id() == "multitone:-18:5");
+    REQUIRE(TestSignal::generate(spec, 48000.0) == TestSignal::standard(48000.0, 5.0));
+    REQUIRE_FALSE(TestSignal::tryParse("pink", spec, err));
+    REQUIRE_FALSE(TestSignal::tryParse("noise:3", spec, err));
+    REQUIRE_FALSE(TestSignal::tryParse("noise:-18:0.1", spec, err));
+    REQUIRE_FALSE(TestSignal::tryParse("noise:-18:5:1", spec, err));
+
+    REQUIRE(TestSignal::tryParse("noise:-30:2", spec, err));
+    const auto noise = TestSignal::generate(spec, 44100.0);
+    REQUIRE(noise.size() == 88200);
+    REQUIRE(noise == TestSignal::generate(spec, 44100.0));
+    LoudnessMeter meter(44100.0);
+    meter.push(noise.data(), noise.size());
+    REQUIRE(std::abs(20.0 * std::log10(meter.levels().rms) - -30.0) < 0.05);
+}
+
+TEST_CASE("Verifier options and expected gains") {
+    auto parse = [](std::vector<std::string> words, VerifyOptions& options, std::string& error) {
+        words.insert(words.begin(), {"nam-volume-knob", "verify"});
+        std::vector<char*> argv;
+        for (auto& word : words) argv.push_back(word.data());
+        return Verifier::tryParseArgs(static_cast<int>(argv.size()), argv.data(), options, error);
+    };
+    VerifyOptions options;
+    std::string error;
+    REQUIRE(parse({"--original", "a.nam", "--scaled", "b.nam", "--scaled", "c.nam", "--expected-db", "3,-6",
+                   "--stimulus", "noise", "--block-size", "64", "--jobs", "0"}, options, error));
+    REQUIRE(options.scaledPaths.size() == 2);
+    REQUIRE(options.expectedDbs == std::vector<float>{3.0f, -6.0f});
+    REQUIRE(options.stimulus.kind == StimulusSpec::Kind::Noise);
+    REQUIRE(options.blockSize == 64);
+    REQUIRE(options.jobs == 0);
+
+    for (const auto& words : std::vector<std::vector<std::string>>{
+             {"--original", "a.nam"},
+             {"--original", "a.nam", "--scaled", "b.nam", "--block-size", "4096"},
+             {"--original", "a.nam", "--scaled", "b.nam", "--expected-db", "1,2"}}) {
+        VerifyOptions bad;
+        REQUIRE_FALSE(parse(words, bad, error));
+    }
+
+    float db = 0.0f;
+    REQUIRE(Verifier::tryExpectedDbFromName("out/model_+3_5db.nam", db));
+    REQUIRE(db == 3.5f);
+    REQUIRE(Verifier::tryExpectedDbFromName("model_2_-12_0db_v3.namb", db));
+    REQUIRE(db == -12.0f);
+    REQUIRE(Verifier::tryExpectedDbFromName("model_0_5lin.nam", db));
+    REQUIRE(std::abs(db - -6.0206f) < 1e-3f);
+    REQUIRE_FALSE(Verifier::tryExpectedDbFromName("model.nam", db));
+    REQUIRE_FALSE(Verifier::tryExpectedDbFromName("model_3_5db.nam", db));  // dB names are signed
+}
+
+TEST_CASE("Verifier compares levels against the original") {
+    AudioLevels original;
+    original.peak = 0.5;
+    original.rms = 0.1;
+    original.lufs = -20.0;
+    VerifiedModel model;
+    model.expectedDb = 6.0;
+    model.levels.peak = 0.5 * std::pow(10.0, 6.0 / 20.0);
+    model.levels.rms = 0.1 * std::pow(10.0, 6.05 / 20.0);
+    model.levels.lufs = -14.0;
+    Verifier::compare(original, 0.1, model);
+    REQUIRE(model.passed);
+    REQUIRE(std::abs(model.rmsDb - 6.05) < 1e-9);
+    REQUIRE(std::abs(model.peakDb - 6.0) < 1e-9);
+    REQUIRE(model.lufsDb == 6.0);
+    Verifier::compare(original, 0.01, model);
+    REQUIRE_FALSE(model.passed);
+
+    original.envelope = {0.1f, 0.2f, 0.0f};
+    model.levels.envelope = {0.2f, 0.4f, 0.3f};  // the silent hop is ignored
+    Verifier::compare(original, 0.1, model);
+    REQUIRE(std::abs(model.envelopeErrorDb - (20.0 * std::log10(2.0) - 6.0)) < 1e-5);
+
+    VerifyOptions options;
+    options.originalPath = "a.nam";
+    options.scaledPaths = {"b.nam"};
+    if (!ModelAudio::available()) {
+        VerifyResult result = Verifier::run(options);
+        REQUIRE(result.exitCode == 2);
+        REQUIRE(result.error.find("NeuralAmpModelerCore") != std::string::npos);
+    }
+}
+
+TEST_CASE("ReferenceStore keeps measurements across runs") {
+    auto dir = makeTempDir("references");
+    const std::string path = (dir / "references.jsonl").string();
+    StimulusSpec stimulus;
+    const std::string key = ReferenceStore::makeKey(0xabcull, stimulus, 48000.0);
+    REQUIRE(key == "0000000000000abc/multitone:-18:5/48000");
+    REQUIRE(key != ReferenceStore::makeKey(0xabcull, stimulus, 44100.0));
+
+    AudioLevels levels;
+    levels.peak = 0.5;
+    levels.rms = 0.125;
+    levels.lufs = -20.25;
+    levels.envelope = {0.125f, 0.25f};
+    AudioLevels silent;
+    silent.lufs = -std::numeric_limits<double>::infinity();
+    {
+        ReferenceStore store(path);
+        REQUIRE(store.size() == 0);
+        store.insert(key, levels);
+        store.insert("silent", silent);
+        std::string error;
+        REQUIRE(store.trySave(error));
+    }
+
+    ReferenceStore reloaded(path);
+    AudioLevels found;
+    REQUIRE(reloaded.lookup(key, found));
+    REQUIRE(found.peak == 0.5);
+    REQUIRE(found.rms == 0.125);
+    REQUIRE(found.lufs == -20.25);
+    REQUIRE(found.envelope == levels.envelope);
+    REQUIRE(reloaded.lookup("silent", found));
+    REQUIRE(std::isinf(found.lufs));
+    REQUIRE_FALSE(reloaded.lookup("other", found));
+
+    SECTION("torn lines are skipped and the last line for a key wins") {
+        std::ofstream(path, std::ios::app) << "{\"v\":1,\"key\":\"sil\n";
+        levels.rms = 0.25;
+        ReferenceStore store(path);
+        store.insert(key, levels);
+        std::string error;
+        REQUIRE(store.trySave(error));
+        ReferenceStore again(path);
+        REQUIRE(again.size() == 2);
+        REQUIRE(again.lookup(key, found));
+        REQUIRE(found.rms == 0.25);
+    }
+
+    SECTION("duplicates are compacted away") {
+        for (int i = 0; i < 70; ++i) {
+            ReferenceStore store(path);
+            levels.rms = i;
+            store.insert(key, levels);
+            std::string error;
+            REQUIRE(store.trySave(error));
+        }
+        std::ifstream in(path);
+        const auto lines = std::count(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>(), '\n');
+        REQUIRE(lines < 70);
+        ReferenceStore store(path);
+        REQUIRE(store.size() == 2);
+        REQUIRE(store.lookup(key, found));
+        REQUIRE(found.rms == 69);
+    }
+
+    SECTION("compaction keeps what other runs appended meanwhile") {
+        {
+            std::ofstream out(path, std::ios::app);
+            for (int i = 0; i < 70; ++i) out << "{\"v\":1,\"key\":\"dup\",\"peak\":1,\"rms\":1,\"lufs\":null}\n";
+        }
+        ReferenceStore first(path);
+        ReferenceStore second(path);
+        second.insert("from-second", levels);
+        std::string error;
+        REQUIRE(second.trySave(error));
+        first.insert("from-first", levels);
+        REQUIRE(first.trySave(error));
+        ReferenceStore merged(path);
+        REQUIRE(merged.size() == 5);
+        REQUIRE(merged.lookup("from-first", found));
+        REQUIRE(merged.lookup("from-second", found));
+        REQUIRE(merged.lookup(key, found));
+    }
+}
+
+TEST_CASE("FolderWatcher options") {
+    auto parse = [](std::vector<std::string> words, WatchOptions& options, std::string& error) {
+        words.insert(words.begin(), {"nam-volume-knob", "watch"});
+        std::vector<char*> argv;
+        for (auto& word : words) argv.push_back(word.data());
+        return FolderWatcher::tryParseArgs(static_cast<int>(argv.size()), argv.data(), options, error);
+    };
+    WatchOptions options;
+    std::string error;
+    REQUIRE(parse({"--input-dir", "in", "--output-dir", "out", "--gain-db", "3,-3", "--jobs", "4", "--debounce-ms",
+                   "250", "--format", "compact", "--once"}, options, error));
+    REQUIRE(options.inputDir == "in");
+    REQUIRE(options.args.outputDir == "out");
+    REQUIRE(options.args.gainDbs == std::vector<float>{3.0f, -3.0f});
+    REQUIRE(options.args.jobs == 4);
+    REQUIRE(options.args.format == NamOutputFormat::Compact);
+    REQUIRE(options.debounceMs == 250);
+    REQUIRE(options.once);
+
+    for (const auto& words : std::vector<std::vector<std::string>>{
+             {"--input-dir", "in", "--gain-db", "3"},
+             {"--input-dir", "in", "--output-dir", "out"},
+             {"--input-dir", "in", "--output-dir", "out", "--gain-db", "3", "--input", "a.nam"},
+             {"--input-dir", "in", "--output-dir", "out", "--gain-db", "3", "--debounce-ms", "soon"}}) {
+        WatchOptions bad;
+        REQUIRE_FALSE(parse(words, bad, error));
+    }
+}
+
+TEST_CASE("FolderWatcher processes each input once per content and options") {
+    auto dir = makeTempDir("watch");
+    std::filesystem::create_directories(dir / "in");
+    writeFile(dir / "in" / "a.nam", makeNamJson("0.5.0").dump());
+    writeFile(dir / "in" / "b.namb", NamWriter::dumpBinary(NamParser::parseNamModel(
+        writeFile(dir / "b.nam", makeNamJson("0.5.0").dump()))));
+    writeFile(dir / "in" / ".partial.nam", "{");
+    writeFile(dir / "in" / "notes.txt", "x");
+
+    WatchOptions options;
+    options.inputDir = (dir / "in").string();
+    options.args.outputDir = (dir / "out").string();
+    options.args.gainDbs = {3.0f, -3.0f};
+    options.args.jobs = 2;
+    options.once = true;
+    auto runOnce = [&](const WatchOptions& watchOptions) {
+        FolderWatcher watcher(watchOptions);
+        std::string error;
+        REQUIRE(watcher.tryStart(error));
+        std::vector<WatchedFile> reported;
+        REQUIRE(watcher.run([&](const WatchedFile& file) { reported.push_back(file); }, error));
+        return reported;
+    };
+
+    FolderWatcher scanner(options);
+    REQUIRE(scanner.scan() == std::vector<std::string>{(dir / "in" / "a.nam").string(), (dir / "in" / "b.namb").string()});
+
+    auto first = runOnce(options);
+    REQUIRE(first.size() == 2);
+    for (const auto& file : first) {
+        REQUIRE(file.exitCode == 0);
+        REQUIRE(file.outputPaths.size() == 2);
+    }
+    REQUIRE(std::filesystem::exists(dir / "out" / "a_+3_0db.nam"));
+    REQUIRE(std::filesystem::exists(dir / "out" / "b_-3_0db.namb"));
+
+    // A restart skips both; a changed input is processed again and replaces its outputs.
+    REQUIRE(runOnce(options).empty());
+    const std::string before = readFile((dir / "out" / "a_+3_0db.nam").string());
+    json changed = makeNamJson("0.5.0");
+    changed["weights"] = {1.0f, 2.0f, 4.0f};
+    writeFile(dir / "in" / "a.nam", changed.dump());
+    auto second = runOnce(options);
+    REQUIRE(second.size() == 1);
+    REQUIRE(second[0].inputPath == (dir / "in" / "a.nam").string());
+    REQUIRE(second[0].outputPaths[0] == (dir / "out" / "a_+3_0db.nam").string());
+    REQUIRE(readFile(second[0].outputPaths[0]) != before);
+    REQUIRE_FALSE(std::filesystem::exists(dir / "out" / "a_+3_0db_v2.nam"));
+
+    // Other options make every input new.
+    options.args.gainDbs = {1.0f};
+    REQUIRE(runOnce(options).size() == 2);
+
+    SECTION("failed inputs are retried") {
+        writeFile(dir / "in" / "c.nam", "{");
+        auto failed = runOnce(options);
+        REQUIRE(failed.size() == 1);
+        REQUIRE(failed[0].exitCode != 0);
+        REQUIRE(runOnce(options).size() == 1);
+    }
+
+    SECTION("a state file that cannot be written is reported") {
+        options.statePath = (dir / "state").string();
+        FolderWatcher watcher(options);
+        std::string error;
+        REQUIRE(watcher.tryStart(error));
+        std::filesystem::remove(options.statePath);
+        std::filesystem::create_directory(options.statePath);
+        std::vector<WatchedFile> reported;
+        REQUIRE(watcher.run([&](const WatchedFile& file) { reported.push_back(file); }, error));
+        REQUIRE(reported.size() == 2);
+        REQUIRE(reported[0].exitCode == 0);
+        REQUIRE(reported[0].warning.find("Cannot write state file") != std::string::npos);
+    }
+
+    SECTION("outputs cannot go to the watched directory") {
+        options.args.outputDir = options.inputDir;
+        FolderWatcher watcher(options);
+        std::string error;
+        REQUIRE_FALSE(watcher.tryStart(error));
+    }
+}
+
+#if defined(__linux__)
+TEST_CASE("FolderWatcher picks up files as they land") {
+    auto dir = makeTempDir("watch_live");
+    std::filesystem::create_directories(dir / "in");
+    WatchOptions options;
+    options.inputDir = (dir / "in").string();
+    options.args.outputDir = (dir / "out").string();
+    options.args.gainDbs = {2.0f};
+    options.debounceMs = 20;
+    FolderWatcher watcher(options);
+    std::string error;
+    REQUIRE(watcher.tryStart(error));
+
+    std::mutex mutex;
+    std::vector<WatchedFile> reported;
+    bool ok = false;
+    std::thread loop([&] {
+        ok = watcher.run([&](const WatchedFile& file) {
+            std::lock_guard<std::mutex> lock(mutex);
+            reported.push_back(file);
+        }, error);
+    });
+    // Written under a hidden name and renamed into place, as capture tools do.
+    writeFile(dir / "in" / ".landing.nam", makeNamJson("0.5.0").dump());
+    std::filesystem::rename(dir / "in" / ".landing.nam", dir / "in" / "live.nam");
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    for (;;) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!reported.empty() || std::chrono::steady_clock::now() > deadline) break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    watcher.stop();
+    loop.join();
+    REQUIRE(ok);
+    REQUIRE(reported.size() == 1);
+    REQUIRE(reported[0].exitCode == 0);
+    REQUIRE(std::filesystem::exists(dir / "out" / "live_+2_0db.nam"));
+}
+#endif
@@ -6,6 +6,7 @@ const dropZoneOutput = document.getElementById('drop-zone-output');
 const gainDbInput = document.getElementById('gain-db');
 const processBtn = document.getElementById('process');
 const results = document.getElementById('results');
+const zipLevelInput = document.getElementById('zip-level');
 
 const MAX_GAIN_DB = 9;
 
@@ -81,6 +82,233 @@ function parseGainList(raw) {
     return values;
 }
 
+// Dedicated workers, each with its own wasm instance (worker.js), so files render in
+// parallel and off the main thread. variant 'compat' forces the compatible wasm build. Files are handed over as File handles and outputs come
+// back as transferred ArrayBuffers, so neither side copies the other's bytes.
+class RenderPool {
+    constructor(size, variant) {
+        this.workerUrl = variant === 'compat' ? 'worker.js?variant=compat' : 'worker.js';
+        this.variant = null;  // build the workers loaded, from their 'ready' message
+        this.startupMs = 0;
+        this.idle = [];
+        this.queue = [];
+        this.jobs = new Map();  // worker -> job it is rendering
+        this.nextId = 0;
+        this.live = 0;
+        // Resolves to the number of workers that loaded the module.
+        this.ready = Promise.all(Array.from({ length: size }, () => this.spawn())).then(() => this.live);
+    }
+
+    spawn() {
+        return new Promise(resolve => {
+            let worker;
+            try {
+                worker = new Worker(this.workerUrl);
+            } catch {
+                resolve();
+                return;
+            }
+            const fail = () => {
+                worker.terminate();
+                resolve();
+            };
+            worker.onerror = fail;
+            worker.onmessage = (e) => {
+                if (e.data.type === 'failed') {
+                    fail();
+                    return;
+                }
+                if (e.data.type !== 'ready') return;
+                this.live++;
+                this.variant = e.data.variant;
+                this.startupMs = Math.max(this.startupMs, e.data.startupMs);
+                worker.onerror = (err) => {
+                    err.preventDefault();
+                    this.onCrash(worker, err.message || 'Worker failed.');
+                };
+                worker.onmessage = (msg) => this.onMessage(worker, msg.data);
+                this.release(worker);
+                resolve();
+            };
+        });
+    }
+
+    // Resolves to {architecture, version, outputs: [Uint8Array per gain]}; onProgress() is
+    // called once per rendered gain.
+    render(file, gains, onProgress) {
+        return new Promise((resolve, reject) => {
+            this.queue.push({ file, gains, onProgress, resolve, reject });
+            this.dispatch();
+        });
+    }
+
+    release(worker) {
+        this.idle.push(worker);
+        this.dispatch();
+    }
+
+    dispatch() {
+        while (this.idle.length && this.queue.length) {
+            const worker = this.idle.pop();
+            const job = this.queue.shift();
+            job.id = this.nextId++;
+            this.jobs.set(worker, job);
+            worker.postMessage({ id: job.id, file: job.file, gains: job.gains });
+        }
+    }
+
+    onMessage(worker, msg) {
+        const job = this.jobs.get(worker);
+        if (!job || msg.id !== job.id) return;
+        if (msg.type === 'crashed') {
+            this.onCrash(worker, msg.message);
+            return;
+        }
+        if (msg.type === 'progress') {
+            job.onProgress();
+            return;
+        }
+        this.jobs.delete(worker);
+        this.release(worker);
+        if (msg.type === 'done') {
+            console.debug(`Rendered ${job.file.name} in ${msg.renderMs} ms (${this.variant} build)`);
+            job.resolve({
+                architecture: msg.architecture,
+                version: msg.version,
+                outputs: msg.outputs.map(buffer => new Uint8Array(buffer))
+            });
+        } else {
+            job.reject(new Error(msg.message));
+        }
+    }
+
+    // A worker died (e.g. out of memory, or an abort in the SIMD build, which cannot catch
+    // exceptions): fail its file with error.crashed set and replace the worker.
+    onCrash(worker, message) {
+        worker.terminate();
+        this.live--;
+        const job = this.jobs.get(worker);
+        this.jobs.delete(worker);
+        if (job) {
+            const error = new Error(message);
+            error.crashed = true;
+            job.reject(error);
+        }
+        this.spawn().then(() => {
+            if (this.live > 0) return;
+            for (const queued of this.queue.splice(0)) queued.reject(new Error('No worker available.'));
+        });
+    }
+}
+
+function downloadBlob(blob, name, revokeAfterMs) {
+    const url = URL.createObjectURL(blob);
+    const a = document.createElement('a');
+    a.href = url;
+    a.download = name;
+    document.body.appendChild(a);
+    a.click();
+    a.remove();
+    setTimeout(() => URL.revokeObjectURL(url), revokeAfterMs);
+}
+
+// Where a streamed zip goes: straight into a file the user picks where the File System
+// Access API exists, otherwise into a Blob of the zip's chunks that is downloaded at the end.
+// Resolves to null if the user cancels the picker.
+async function openZipSink(name) {
+    if (typeof window.showSaveFilePicker === 'function') {
+        try {
+            const handle = await window.showSaveFilePicker({
+                suggestedName: name,
+                types: [{ description: 'Zip archive', accept: { 'application/zip': ['.zip'] } }]
+            });
+            const writable = await handle.createWritable();
+            return {
+                write: chunk => writable.write(chunk),
+                close: () => writable.close(),
+                abort: () => writable.abort()
+            };
+        } catch (e) {
+            if (e.name === 'AbortError') return null;
+            // Otherwise (e.g. not allowed in this frame) fall back to a download.
+        }
+    }
+    const parts = [];
+    return {
+        write: chunk => { parts.push(chunk); },
+        close: () => downloadBlob(new Blob(parts, { type: 'application/zip' }), name, 2000),
+        abort: () => { parts.length = 0; }
+    };
+}
+
+// A zip written to a sink as entries are added, so each output can be dropped as soon as it
+// is in the zip instead of every output and the whole zip being held at the end. Level 0
+// stores entries; higher levels deflate them off the main thread.
+class ZipStream {
+    constructor(sink, level) {
+        this.sink = sink;
+        this.level = level;
+        let written = Promise.resolve();
+        this.done = new Promise((resolve, reject) => {
+            this.zip = new window.fflate.Zip((err, chunk, final) => {
+                if (err) {
+                    reject(err);
+                    return;
+                }
+                written = written.then(() => sink.write(chunk));
+                if (final) written.then(resolve, reject);
+            });
+        });
+        this.done.catch(() => {});  // reported by finish()
+    }
+
+    add(name, bytes) {
+        const entry = this.level > 0
+            ? new window.fflate.AsyncZipDeflate(name, { level: this.level })
+            : new window.fflate.ZipPassThrough(name);
+        this.zip.add(entry);
+        entry.push(bytes, true);
+    }
+
+    async finish() {
+        this.zip.end();
+        await this.done;
+        await this.sink.close();
+    }
+
+    async abort() {
+        this.zip.terminate();
+        await this.sink.abort();
+    }
+}
+
+let renderPoolPromise = null;
+
+// The shared pool, or null if workers are unavailable (then files render on this thread).
+function getRenderPool() {
+    if (renderPoolPromise === null) renderPoolPromise = createRenderPool();
+    return renderPoolPromise;
+}
+
+async function createRenderPool() {
+    if (typeof Worker !== 'function') return null;
+    const size = Math.max(1, navigator.hardwareConcurrency || 4);
+    // The fastest build the browser supports, then the compatible one if none of those load.
+    for (const variant of ['auto', 'compat']) {
+        const pool = new RenderPool(size, variant);
+        if (await pool.ready > 0) {
+            console.log(`NAM render pool: ${pool.live} worker(s), ${pool.variant} build, started in ${pool.startupMs} ms`);
+            return pool;
+        }
+    }
+    return null;
+}
+
+async function renderOnMainThread(file, gains, onProgress) {
+    const bytes = new Uint8Array(await file.arrayBuffer());
+    return renderNamBytes(bytes, gains, onProgress);
+}
+
 function validateGains(gains) {
     if (!Array.isArray(gains) || !gains.length) return 'Enter one or more gains (comma-separated).';
     if (gains.some(v => !Number.isFinite(v))) return 'Gain list contains non-finite value(s).';
@@ -196,76 +424,80 @@ processBtn.addEventListener('click', async () => {
         showError('Error: Module not ready. Please wait for page to load completely.');
         return;
     }
-    showStatus(`Processing ${files.length} file(s) × ${gains.length} gain(s)…`);
-
-    // If multiple files, prefer a single zip to avoid browser multi-download blocking.
     const totalOutputs = files.length * gains.length;
-    const shouldZip = totalOutputs > 1 && typeof window.fflate !== 'undefined';
-    const zipEntries = shouldZip ? {} : null;
+
+    // If multiple outputs, prefer a single zip to avoid browser multi-download blocking. The
+    // sink is opened first: the save picker needs this click's user activation.
+    let zip = null;
+    if (totalOutputs > 1 && typeof window.fflate !== 'undefined') {
+        const sink = await openZipSink('nam_volume_knob_db.zip');
+        if (!sink) {
+            showStatus('Cancelled.');
+            return;
+        }
+        zip = new ZipStream(sink, Number(zipLevelInput.value) || 0);
+    }
+
+    const progressLine = document.createElement('div');
+    results.appendChild(progressLine);
+    let renderedCount = 0;
+    const showProgress = () => {
+        const done = Math.min(renderedCount, totalOutputs);  // retried files count twice
+        progressLine.textContent = `Processing ${files.length} file(s) × ${gains.length} gain(s)… ${done}/${totalOutputs}`;
+    };
+    const onProgress = () => {
+        renderedCount++;
+        showProgress();
+    };
+    showProgress();
+
     let successCount = 0;
     let a1Count = 0;
     let a2Count = 0;
     const namVersions = new Set();
 
-    for (const file of files) {
+    // Takes one file's result as soon as it is rendered.
+    const consume = (file, result) => {
         try {
-            const text = await file.text();
-            const json = JSON.parse(text);
             const base = file.name.replace('.nam', '');
+            if (result.error) throw result.error;
+            const rendered = result.rendered;
 
             // Count model versions and collect NAM versions
-            const architecture = typeof json.architecture === 'string' ? json.architecture : 'unknown';
+            const architecture = rendered.architecture;
             if (architecture === 'SlimmableContainer') {
                 a2Count++;
             } else {
                 a1Count++;
             }
 
-            const namVersion = typeof json.version === 'string' ? json.version : 'unknown';
+            const namVersion = rendered.version;
             namVersions.add(namVersion);
 
-            for (const gainValue of gains) {
-                const factor = Math.pow(10, gainValue / 20);
-                const gainDbForMetadata = gainValue;
-
-                const modified = Module.processNam(
-                    JSON.stringify(json),
-                    factor,
-                    gainDbForMetadata
-                );
-
-                if (typeof modified === 'string' && modified.startsWith('Error:')) {
-                    throw new Error(modified.replace(/^Error:\s*/, ''));
-                }
+            for (let g = 0; g < gains.length; g++) {
+                const gainValue = gains[g];
+                const modified = rendered.outputs[g];
 
                 const gainStrForName = formatGain(gainValue, true);
                 const outputName = base + '_' + gainStrForName + 'db.nam';
 
-                if (shouldZip) {
-                    zipEntries[outputName] = window.fflate.strToU8(modified);
+                if (zip) {
+                    zip.add(outputName, modified);
+                    rendered.outputs[g] = null;
                 } else {
-                    const blob = new Blob([modified], { type: 'application/json' });
-                    const url = URL.createObjectURL(blob);
-                    const a = document.createElement('a');
-                    a.href = url;
-                    a.download = outputName;
-                    document.body.appendChild(a);
-                    a.click();
-                    a.remove();
-                    setTimeout(() => URL.revokeObjectURL(url), 1000);
+                    downloadBlob(new Blob([modified], { type: 'application/json' }), outputName, 1000);
                 }
 
                 successCount++;
 
                 // Track each export with gain level and model version
                 if (typeof gtag === 'function') {
-                    const architecture = typeof json.architecture === 'string' ? json.architecture : 'unknown';
                     const modelVersion = architecture === 'SlimmableContainer' ? 'A2' : 'A1';
                     gtag('event', 'nam_export', {
                         'gain_value': gainValue,
                         'gain_type': 'db',
                         'file_name': file.name,
-                        'nam_version': typeof json.version === 'string' ? json.version : 'unknown',
+                        'nam_version': namVersion,
                         'model_version': modelVersion,
                         'architecture': architecture
                     });
@@ -282,19 +514,30 @@ processBtn.addEventListener('click', async () => {
                 });
             }
         }
+    };
+
+    // Every file is queued on the pool at once and added to the zip in the order they finish.
+    const pool = await getRenderPool();
+    const settle = promise => promise.then(rendered => ({ rendered }), error => ({ error }));
+    if (pool) {
+        // A file that crashed its worker is retried with the page's own (exception-catching) module.
+        const render = file => pool.render(file, gains, onProgress)
+            .catch(e => e.crashed ? renderOnMainThread(file, gains, onProgress) : Promise.reject(e));
+        await Promise.all(files.map(file => settle(render(file)).then(result => consume(file, result))));
+    } else {
+        for (const file of files) consume(file, await settle(renderOnMainThread(file, gains, onProgress)));
     }
 
-    if (shouldZip && successCount > 0) {
-        const zipBytes = window.fflate.zipSync(zipEntries, { level: 0 });
-        const zipBlob = new Blob([zipBytes], { type: 'application/zip' });
-        const zipUrl = URL.createObjectURL(zipBlob);
-        const a = document.createElement('a');
-        a.href = zipUrl;
-        a.download = 'nam_volume_knob_db.zip';
-        document.body.appendChild(a);
-        a.click();
-        a.remove();
-        setTimeout(() => URL.revokeObjectURL(zipUrl), 2000);
+    if (zip) {
+        try {
+            if (successCount > 0) {
+                await zip.finish();
+            } else {
+                await zip.abort();
+            }
+        } catch (e) {
+            showError(`Error writing zip: ${e.message}`);
+        }
     }
 
     // Track batch summary
@@ -312,8 +555,6 @@ processBtn.addEventListener('click', async () => {
         });
     }
 
-    // Clear status text if there were no errors appended.
-    if (results.textContent === `Processing ${files.length} file(s) × ${gains.length} gain(s)…`) {
-        results.textContent = '';
-    }
+    // Only error lines, if any, stay.
+    progressLine.remove();
 });
\ No newline at end of file
@@ -0,0 +1,63 @@
+// Rendering with the wasm module, shared by the page (fallback) and worker.js. Expects the
+// Emscripten `Module` global to be initialized.
+
+function throwIfError(message) {
+    if (message) throw new Error(message.replace(/^Error:\s*/, ''));
+}
+
+// Renders every dB gain of one file's bytes (a Uint8Array). Returns its architecture and
+// version and one Uint8Array per gain; onProgress(done) is called after each gain.
+function renderNamBytes(bytes, gains, onProgress) {
+    if (typeof Module.NamBuffer !== 'function') return renderNamText(bytes, gains, onProgress);
+
+    // The bytes are copied into the wasm heap once and parsed in place; the parsed model
+    // keeps only float weights, so the input buffer is freed before rendering.
+    const input = new Module.NamBuffer(bytes.length);
+    let probe;
+    let model;
+    try {
+        input.view().set(bytes);
+        probe = Module.probeNam(input);
+        throwIfError(probe.error);
+        model = new Module.NamInput(input);
+    } finally {
+        input.delete();
+    }
+
+    const output = new Module.NamBuffer(0);
+    try {
+        throwIfError(model.error());
+        const outputs = gains.map((gainValue, g) => {
+            throwIfError(model.render(Math.pow(10, gainValue / 20), gainValue, 'pretty', output));
+            // Copy out of the heap: the view is only valid until the next render.
+            const out = output.view().slice();
+            if (onProgress) onProgress(g + 1);
+            return out;
+        });
+        return {
+            architecture: probe.architecture || 'unknown',
+            version: probe.version || 'unknown',
+            outputs
+        };
+    } finally {
+        output.delete();
+        model.delete();
+    }
+}
+
+// Same through processNam, for a wasm build without the buffer API.
+function renderNamText(bytes, gains, onProgress) {
+    const text = new TextDecoder().decode(bytes);
+    const json = JSON.parse(text);
+    const outputs = gains.map((gainValue, g) => {
+        const modified = Module.processNam(text, Math.pow(10, gainValue / 20), gainValue);
+        if (typeof modified === 'string' && modified.startsWith('Error:')) throwIfError(modified);
+        if (onProgress) onProgress(g + 1);
+        return new TextEncoder().encode(modified);
+    });
+    return {
+        architecture: typeof json.architecture === 'string' ? json.architecture : 'unknown',
+        version: typeof json.version === 'string' ? json.version : 'unknown',
+        outputs
+    };
+}
@@ -0,0 +1,68 @@
+// Dedicated worker with its own wasm instance (see RenderPool in app.js).
+//
+// Loads nam-volume-knob-web-simd.js (SIMD, -O3/LTO, no exception catching) where wasm SIMD
+// is supported and the build is deployed, otherwise nam-volume-knob-web.js. worker.js?variant=compat
+// always loads the latter.
+//
+// In:  {id, file, gains}, where file is a File (cloned as a handle; the bytes are read here).
+// Out: {type: 'ready', variant, startupMs} once the module is loaded, or {type: 'failed'} if
+//      it cannot be;
+//      {type: 'progress', id, done} after each gain;
+//      {type: 'done', id, architecture, version, outputs, renderMs} with outputs as
+//      ArrayBuffers transferred back without copying; or {type: 'error', id, message};
+//      {type: 'crashed', id, message} if the module aborted (the worker is then unusable).
+
+// (module (func (result v128) i32.const 0 i8x16.splat i8x16.popcnt))
+const SIMD_PROBE = new Uint8Array([0, 97, 115, 109, 1, 0, 0, 0, 1, 5, 1, 96, 0, 1, 123, 3, 2, 1, 0, 10, 10, 1, 8, 0,
+    65, 0, 253, 15, 253, 98, 11]);
+
+const startTime = performance.now();
+let variant = 'compat';
+let ready = false;
+let currentId = null;
+
+var Module = {
+    onRuntimeInitialized() {
+        ready = true;
+        postMessage({ type: 'ready', variant, startupMs: Math.round(performance.now() - startTime) });
+    },
+    onAbort(reason) {
+        if (!ready) {
+            postMessage({ type: 'failed' });
+            return;
+        }
+        postMessage({ type: 'crashed', id: currentId, message: String(reason || 'wasm module aborted') });
+    }
+};
+
+importScripts('render.js');
+if (new URLSearchParams(self.location.search).get('variant') !== 'compat' && WebAssembly.validate(SIMD_PROBE)) {
+    try {
+        importScripts('nam-volume-knob-web-simd.js');
+        variant = 'simd';
+    } catch {
+        // Not deployed: use the compatible build.
+    }
+}
+if (variant === 'compat') importScripts('nam-volume-knob-web.js');
+
+onmessage = async (e) => {
+    const { id, file, gains } = e.data;
+    currentId = id;
+    try {
+        const bytes = new Uint8Array(await file.arrayBuffer());
+        const start = performance.now();
+        const rendered = renderNamBytes(bytes, gains, done => postMessage({ type: 'progress', id, done }));
+        const outputs = rendered.outputs.map(out => out.buffer);
+        postMessage({
+            type: 'done',
+            id,
+            architecture: rendered.architecture,
+            version: rendered.version,
+            outputs,
+            renderMs: Math.round(performance.now() - start)
+        }, outputs);
+    } catch (err) {
+        postMessage({ type: 'error', id, message: err && err.message ? err.message : String(err) });
+    }
+};